@@ -0,0 +1,127 @@
+#include "Agents.hpp"
+
+#include "parallel_for.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+constexpr size_t Agents::BatchSize;
+
+void Agents::resize(uint32_t width_, uint32_t height_) {
+	width = width_;
+	height = height_;
+	x.clear();
+	y.clear();
+	dir.clear();
+	target.clear();
+	occupancy.assign(width * height, 0);
+	agent_at.assign(width * height, -1U);
+}
+
+void Agents::set_blocked(uint32_t x_, uint32_t y_, bool blocked) {
+	assert(x_ < width && y_ < height);
+	uint8_t &cell = occupancy[y_ * width + x_];
+	if (blocked) cell |= BlockedBit;
+	else cell &= ~BlockedBit;
+}
+
+bool Agents::add(uint32_t x_, uint32_t y_, uint8_t dir_) {
+	assert(x_ < width && y_ < height);
+	uint8_t &cell = occupancy[y_ * width + x_];
+	if (cell != 0) return false;
+	cell |= AgentBit;
+	agent_at[y_ * width + x_] = uint32_t(x.size());
+	x.emplace_back(x_);
+	y.emplace_back(y_);
+	dir.emplace_back(dir_ & 3);
+	return true;
+}
+
+void Agents::roll_row(uint32_t y_, int32_t shift) {
+	assert(y_ < height);
+	uint32_t s = uint32_t(((int64_t(shift) % width) + width) % width);
+	if (s == 0) return;
+	auto row = occupancy.begin() + y_ * width;
+	std::rotate(row, row + (width - s), row + width);
+	auto at = agent_at.begin() + y_ * width;
+	std::rotate(at, at + (width - s), at + width);
+	for (uint32_t cx = 0; cx < width; ++cx) {
+		if (at[cx] != -1U) x[at[cx]] = cx;
+	}
+}
+
+void Agents::roll_column(uint32_t x_, int32_t shift) {
+	assert(x_ < width);
+	uint32_t s = uint32_t(((int64_t(shift) % height) + height) % height);
+	if (s == 0) return;
+	std::vector< uint8_t > column(height);
+	std::vector< uint32_t > column_agents(height);
+	for (uint32_t cy = 0; cy < height; ++cy) {
+		column[(cy + s) % height] = occupancy[cy * width + x_];
+		column_agents[(cy + s) % height] = agent_at[cy * width + x_];
+	}
+	for (uint32_t cy = 0; cy < height; ++cy) {
+		occupancy[cy * width + x_] = column[cy];
+		agent_at[cy * width + x_] = column_agents[cy];
+		if (column_agents[cy] != -1U) y[column_agents[cy]] = cy;
+	}
+}
+
+//Proposals only read the static (BlockedBit) part of the occupancy grid,
+// so batches can be computed concurrently:
+void Agents::propose(size_t begin, size_t end) {
+	for (size_t i = begin; i < end; ++i) {
+		uint32_t ax = x[i];
+		uint32_t ay = y[i];
+		uint32_t tx = ax;
+		uint32_t ty = ay;
+		if (dir[i] == PosX) tx += 1;
+		else if (dir[i] == PosY) ty += 1;
+		else if (dir[i] == NegX) tx -= 1; //wraps to 0xffffffff at the edge, which fails the bounds check below
+		else ty -= 1;
+
+		if (tx >= width || ty >= height || (occupancy[ty * width + tx] & BlockedBit)) {
+			//bumped into the edge or an obstacle; turn (left or right depending on cell parity) and wait:
+			dir[i] = (dir[i] + (((ax ^ ay) & 1) ? 1 : 3)) & 3;
+			target[i] = ay * width + ax;
+		} else {
+			target[i] = ty * width + tx;
+		}
+	}
+}
+
+void Agents::step(uint32_t avoid_x, uint32_t avoid_y) {
+	target.resize(x.size());
+
+	{ //(1) compute proposed moves, in parallel batches (spread over at most one thread per core):
+		size_t batches = (x.size() + BatchSize - 1) / BatchSize;
+		if (batches <= 1) {
+			propose(0, x.size());
+		} else {
+			parallel_for(uint32_t(batches), [this](uint32_t b){
+				size_t begin = b * BatchSize;
+				propose(begin, std::min(x.size(), begin + BatchSize));
+			});
+		}
+	}
+
+	{ //(2) commit moves in order, resolving agent-agent collisions through the occupancy grid:
+		uint32_t avoid = avoid_y * width + avoid_x;
+		for (size_t i = 0; i < x.size(); ++i) {
+			uint32_t from = y[i] * width + x[i];
+			uint32_t to = target[i];
+			if (to == from) continue;
+			if ((occupancy[to] & AgentBit) || to == avoid) {
+				//cell was claimed by another agent (or holds the player); turn around:
+				dir[i] = (dir[i] + 2) & 3;
+				continue;
+			}
+			occupancy[from] &= ~AgentBit;
+			occupancy[to] |= AgentBit;
+			agent_at[from] = -1U;
+			agent_at[to] = uint32_t(i);
+			x[i] = to % width;
+			y[i] = to / width;
+		}
+	}
+}
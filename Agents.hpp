@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The 'Agents' struct holds the AI-controlled rival pieces that share the board with the player.
+// Agent state is stored structure-of-arrays so that stepping only touches the columns it needs,
+// and collisions are resolved through a per-cell occupancy grid that is updated as agents move.
+
+struct Agents {
+	//set board size; clears all agents and blocked cells:
+	void resize(uint32_t width, uint32_t height);
+
+	//mark (or unmark) a cell as a static obstacle (e.g. a wall):
+	void set_blocked(uint32_t x, uint32_t y, bool blocked);
+
+	//add an agent at (x,y) heading in direction 'dir'; returns false if the cell isn't free:
+	bool add(uint32_t x, uint32_t y, uint8_t dir);
+
+	//is there an agent in cell (x,y)?
+	bool occupied(uint32_t x, uint32_t y) const {
+		return occupancy[y * width + x] & AgentBit;
+	}
+
+	//rotate row y (or column x) by 'shift' cells toward +x (or +y), carrying along agents and blocked cells
+	// (matches Board::roll_row / Board::roll_column; costs one step per cell of the line, however many agents there are):
+	void roll_row(uint32_t y, int32_t shift);
+	void roll_column(uint32_t x, int32_t shift);
+
+	//advance every agent by (at most) one cell; agents never enter the cell at (avoid_x, avoid_y):
+	void step(uint32_t avoid_x, uint32_t avoid_y);
+
+	size_t size() const { return x.size(); }
+
+	//------- state -------
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	//directions agents can head in:
+	enum Dir : uint8_t { PosX = 0, PosY = 1, NegX = 2, NegY = 3 };
+
+	//per-agent columns (all the same length):
+	std::vector< uint32_t > x;
+	std::vector< uint32_t > y;
+	std::vector< uint8_t > dir;
+
+	//per-cell occupancy grid (width * height, row-major):
+	enum : uint8_t { AgentBit = 0x1, BlockedBit = 0x2 };
+	std::vector< uint8_t > occupancy;
+	//...and the index of the agent in each cell, or -1U if there isn't one (so rolls only visit the rolled line):
+	std::vector< uint32_t > agent_at;
+
+	//agents are stepped in batches of this many, handed out to at most one worker thread per core (see parallel_for.hpp):
+	static constexpr size_t BatchSize = 4096;
+
+private:
+	//proposed destination cell for each agent (scratch space for step):
+	std::vector< uint32_t > target;
+
+	//compute proposals for agents [begin,end):
+	void propose(size_t begin, size_t end);
+};
@@ -0,0 +1,180 @@
+#include "AssetPack.hpp"
+
+#include "data_path.hpp"
+#include "read_chunk.hpp"
+#include "crc32c.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+AssetPack::AssetPack(std::string const &pack_path) {
+	#ifdef NDEBUG
+	loose_overrides = false;
+	#endif
+
+	//map the whole file:
+	#if defined(_WIN32)
+	HANDLE file = CreateFileA(pack_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return; //no pack
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of '" + pack_path + "'.");
+	}
+	HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	void *view = (map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL);
+	if (!view) {
+		if (map) CloseHandle(map);
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map '" + pack_path + "'.");
+	}
+	file_handle = file;
+	map_handle = map;
+	mapping = view;
+	mapping_size = size_t(size.QuadPart);
+	#else
+	int fd = open(pack_path.c_str(), O_RDONLY);
+	if (fd < 0) return; //no pack
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get size of '" + pack_path + "'.");
+	}
+	void *addr = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //(mapping stays valid)
+	if (addr == MAP_FAILED) {
+		throw std::runtime_error("Failed to map '" + pack_path + "'.");
+	}
+	mapping = addr;
+	mapping_size = size_t(info.st_size);
+	#endif
+
+	try {
+		//directory is small, so it is copied out (and checksummed) by read_chunk:
+		AssetPack::Span whole;
+		whole.data = reinterpret_cast< uint8_t const * >(mapping);
+		whole.size = mapping_size;
+		SpanStream stream(whole);
+		read_chunk(stream, "dir0", &directory);
+
+		for (size_t i = 0; i < directory.size(); ++i) {
+			directory[i].verified = 0;
+			if (i > 0 && !(directory[i-1].hash < directory[i].hash)) {
+				throw std::runtime_error("Directory in '" + pack_path + "' is not sorted by hash.");
+			}
+		}
+
+		//file contents are left in place; only the header is checked here
+		// (each asset's checksum is verified the first time it is requested):
+		struct ChunkHeader {
+			char magic[4];
+			uint32_t size;
+			uint32_t crc;
+		};
+		static_assert(sizeof(ChunkHeader) == 12, "header is packed");
+		size_t at = sizeof(ChunkHeader) + directory.size() * sizeof(Entry); //(just past dir0)
+		ChunkHeader header;
+		if (at + sizeof(header) > mapping_size) {
+			throw std::runtime_error("Pack '" + pack_path + "' is missing its fil0 chunk.");
+		}
+		std::memcpy(&header, whole.data + at, sizeof(header));
+		if (std::string(header.magic, 4) != "fil0") {
+			throw std::runtime_error("Unexpected magic number in '" + pack_path + "'.");
+		}
+		if (at + sizeof(header) + header.size > mapping_size) {
+			throw std::runtime_error("Pack '" + pack_path + "' is truncated.");
+		}
+		files = whole.data + at + sizeof(header);
+		files_size = header.size;
+
+		for (auto const &e : directory) {
+			if (e.begin > e.end || e.end > files_size) {
+				throw std::runtime_error("Directory entry out of range in '" + pack_path + "'.");
+			}
+		}
+	} catch (...) {
+		unmap();
+		throw;
+	}
+}
+
+AssetPack::~AssetPack() {
+	unmap();
+}
+
+void AssetPack::unmap() {
+	if (!mapping) return;
+	#if defined(_WIN32)
+	UnmapViewOfFile(mapping);
+	CloseHandle(map_handle);
+	CloseHandle(file_handle);
+	#else
+	munmap(mapping, mapping_size);
+	#endif
+	mapping = nullptr;
+	mapping_size = 0;
+}
+
+AssetPack::Span AssetPack::get(AssetPath const &asset) {
+	Span span;
+
+	{ //already loaded from a loose file?
+		auto f = loose.find(asset.hash);
+		if (f != loose.end()) {
+			span.data = f->second.data();
+			span.size = f->second.size();
+			return span;
+		}
+	}
+
+	if (loose_overrides && load_loose(asset, &span)) return span;
+
+	auto f = std::lower_bound(directory.begin(), directory.end(), asset.hash, [](Entry const &e, uint64_t hash) {
+		return e.hash < hash;
+	});
+	if (f != directory.end() && f->hash == asset.hash) {
+		span.data = files + f->begin;
+		span.size = f->end - f->begin;
+		if (!f->verified) {
+			if (crc32c_parallel(span.data, span.size) != f->crc) {
+				throw std::runtime_error("Checksum mismatch for '" + std::string(asset.path) + "' in asset pack.");
+			}
+			f->verified = 1;
+		}
+		return span;
+	}
+
+	if (!loose_overrides && load_loose(asset, &span)) return span;
+
+	throw std::runtime_error("Asset '" + std::string(asset.path) + "' not found.");
+}
+
+bool AssetPack::load_loose(AssetPath const &asset, Span *span) {
+	std::ifstream file(data_path(asset.path), std::ios::binary);
+	if (!file) return false;
+	std::vector< uint8_t > contents(
+		(std::istreambuf_iterator< char >(file)),
+		std::istreambuf_iterator< char >()
+	);
+	std::vector< uint8_t > &stored = loose[asset.hash];
+	stored = std::move(contents);
+	span->data = stored.data();
+	span->size = stored.size();
+	return true;
+}
+
+AssetPack &AssetPack::data() {
+	static AssetPack pack(data_path("assets.pack"));
+	return pack;
+}
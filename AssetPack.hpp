@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <istream>
+#include <cstdint>
+#include <cstddef>
+
+// An 'AssetPack' is a single file holding many assets, memory-mapped once at startup.
+// Assets are looked up by a 64-bit FNV-1a hash of their path (relative to the data directory),
+// which can be computed at compile time, and are returned as spans pointing directly into the mapping.
+//
+// The file is two chunks (see read_chunk.hpp), built by pack-assets.py:
+//   dir0: one entry per asset (path hash, byte range in fil0, CRC32C), sorted by hash
+//   fil0: the contents of every asset, each starting on a 16-byte boundary of the file
+//
+// Loose files (found via data_path) are used for anything not in the pack, and,
+// in builds without NDEBUG, take priority over the pack so assets can be edited without repacking.
+
+//FNV-1a, written as a single expression so that it is constexpr in C++11:
+constexpr uint64_t asset_hash(char const *path, uint64_t hash = 0xcbf29ce484222325ULL) {
+	return (*path == '\0' ? hash : asset_hash(path + 1, (hash ^ uint64_t(uint8_t(*path))) * 0x100000001b3ULL));
+}
+
+//path plus its hash; declare these constexpr to hash at compile time:
+//  constexpr AssetPath MeshesBlob("meshes.blob");
+struct AssetPath {
+	constexpr AssetPath(char const *path_) : path(path_), hash(asset_hash(path_)) { }
+	char const *path;
+	uint64_t hash;
+};
+
+struct AssetPack {
+	struct Span {
+		uint8_t const *data = nullptr;
+		size_t size = 0;
+	};
+
+	//opens (and maps) the pack at 'pack_path'; a missing pack is not an error (all lookups go to loose files):
+	explicit AssetPack(std::string const &pack_path);
+	~AssetPack();
+	AssetPack(AssetPack const &) = delete;
+	AssetPack &operator=(AssetPack const &) = delete;
+
+	//returns the contents of an asset; throws if it is in neither the pack nor the data directory.
+	// the span stays valid for the lifetime of the pack.
+	Span get(AssetPath const &asset);
+
+	//the pack shipped next to the executable (data_path("assets.pack")), opened on first use:
+	static AssetPack &data();
+
+	//------- state -------
+
+	struct Entry {
+		uint64_t hash = 0;
+		uint32_t begin = 0; //byte range within fil0
+		uint32_t end = 0;
+		uint32_t crc = 0; //CRC32C of the contents
+		uint32_t verified = 0; //(zero in the file; set once the crc has been checked)
+	};
+	static_assert(sizeof(Entry) == 24, "Entry should be packed.");
+
+	std::vector< Entry > directory; //sorted by hash
+	uint8_t const *files = nullptr; //start of fil0 contents (inside the mapping)
+	size_t files_size = 0;
+
+	bool loose_overrides = true;
+	std::unordered_map< uint64_t, std::vector< uint8_t > > loose; //loose files read so far
+
+private:
+	void *mapping = nullptr; //platform-specific mapping handle/address
+	size_t mapping_size = 0;
+	#if defined(_WIN32)
+	void *file_handle = nullptr;
+	void *map_handle = nullptr;
+	#endif
+	void unmap();
+
+	//reads data_path(path) into 'loose'; returns false if the file doesn't exist:
+	bool load_loose(AssetPath const &asset, Span *span);
+};
+
+//read-only std::istream over a span, so that (e.g.) read_chunk can parse assets in place:
+struct SpanStream : std::istream {
+	explicit SpanStream(AssetPack::Span const &span) : std::istream(&buffer), buffer(span) { }
+private:
+	struct Buffer : std::streambuf {
+		explicit Buffer(AssetPack::Span const &span) {
+			char *begin = const_cast< char * >(reinterpret_cast< char const * >(span.data));
+			setg(begin, begin, begin + span.size);
+		}
+	} buffer;
+};
@@ -0,0 +1,477 @@
+#include "Board.hpp"
+
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+constexpr uint32_t Board::Unreachable;
+constexpr uint32_t Board::ChunkSize;
+constexpr uint16_t Board::NoOffset;
+
+//a new (or rebased) chunk's base is this far below the distance that prompted it, so later, shorter paths seldom force another rebase:
+static constexpr uint32_t BaseSlack = 256;
+
+void Board::DistanceChunk::set(uint32_t i, uint32_t d) {
+	if (!wide.empty()) {
+		wide[i] = d;
+		return;
+	}
+	if (d == Unreachable) {
+		offsets[i] = NoOffset;
+		return;
+	}
+	if (d < base) {
+		//rebase, if the chunk's current span still fits in 16 bits afterward:
+		uint32_t top = 0;
+		for (uint16_t o : offsets) {
+			if (o != NoOffset) top = std::max< uint32_t >(top, o);
+		}
+		uint32_t new_base = d - std::min(d, BaseSlack);
+		if (base - new_base + top >= NoOffset) new_base = d;
+		if (base - new_base + top < NoOffset) {
+			uint16_t shift = uint16_t(base - new_base);
+			for (uint16_t &o : offsets) {
+				if (o != NoOffset) o += shift;
+			}
+			base = new_base;
+		}
+	}
+	if (d >= base && d - base < NoOffset) {
+		offsets[i] = uint16_t(d - base);
+		return;
+	}
+	//span too large for offsets; switch to full values:
+	std::vector< uint32_t > values(offsets.size());
+	for (uint32_t k = 0; k < values.size(); ++k) {
+		values[k] = get(k);
+	}
+	values[i] = d;
+	wide.swap(values);
+	offsets.clear();
+	offsets.shrink_to_fit();
+}
+
+void Board::reset(uint32_t width_, uint32_t height_, std::vector< Tile > const &tiles_) {
+	if (tiles_.size() != size_t(width_) * size_t(height_)) {
+		throw std::runtime_error("Board tiles don't match board size.");
+	}
+	bool found_goal = false;
+	for (Tile t : tiles_) {
+		if (t >= TileCount) {
+			throw std::runtime_error("Invalid tile type on board.");
+		}
+		if (t == TileGoal) {
+			if (found_goal) throw std::runtime_error("Board has more than one goal.");
+			found_goal = true;
+		}
+	}
+
+	width = width_;
+	height = height_;
+	tiles.reset(width, height, tiles_);
+	rebuild();
+}
+
+void Board::reset(SparseTiles const &tiles_) {
+	bool found_goal = false;
+	std::vector< SparseTiles::Feature > line;
+	for (uint32_t y = 0; y < tiles_.height; ++y) {
+		tiles_.row_features(y, &line);
+		for (SparseTiles::Feature const &f : line) {
+			if (f.type >= TileCount) {
+				throw std::runtime_error("Invalid tile type on board.");
+			}
+			if (f.type == TileGoal) {
+				if (found_goal) throw std::runtime_error("Board has more than one goal.");
+				found_goal = true;
+			}
+		}
+	}
+
+	width = tiles_.width;
+	height = tiles_.height;
+	tiles = tiles_;
+	rebuild();
+}
+
+void Board::rebuild() {
+	for (uint32_t t = 0; t < TileCount; ++t) {
+		instances[t].clear();
+		instance_seeds[t].clear();
+	}
+	goal = -1U;
+	std::vector< SparseTiles::Feature > line;
+	for (uint32_t y = 0; y < height; ++y) {
+		tiles.row_features(y, &line);
+		for (SparseTiles::Feature const &f : line) {
+			add_instance(f.type, y * width + f.at);
+			if (f.type == TileGoal) goal = y * width + f.at;
+		}
+	}
+
+	changed_slots.clear();
+	instances_reset = true;
+	changed_cells.clear();
+	tiles_reset = true;
+
+	chunks_x = (width + ChunkSize - 1) / ChunkSize;
+	compute_distances();
+}
+
+void Board::set(uint32_t x, uint32_t y, Tile t) {
+	assert(x < width && y < height);
+	assert(t < TileCount);
+	uint32_t cell = y * width + x;
+	Tile old = tiles.get(x, y);
+	if (old == t) return;
+
+	if (t == TileGoal && goal != -1U) {
+		//only one goal at a time (the old goal becomes floor; distances are recomputed once, below, for the new goal):
+		remove_instance(TileGoal, goal);
+		tiles.set(goal % width, goal / width, TileFloor);
+		changed_cells.emplace_back(goal);
+		goal = -1U;
+	}
+
+	if (old != TileFloor) remove_instance(old, cell);
+	tiles.set(x, y, t);
+	if (t != TileFloor) add_instance(t, cell);
+	set_wall(cell, t == TileWall);
+	changed_cells.emplace_back(cell);
+
+	if (old == TileGoal) {
+		goal = -1U;
+		compute_distances();
+	} else if (t == TileGoal) {
+		goal = cell;
+		compute_distances();
+	} else if (t == TileWall) {
+		cell_blocked(cell);
+	} else if (old == TileWall) {
+		cell_opened(cell);
+	}
+}
+
+//shift modulo 'length', as a non-negative number of steps:
+static uint32_t wrap_shift(int32_t shift, uint32_t length) {
+	int64_t s = int64_t(shift) % int64_t(length);
+	return uint32_t(s < 0 ? s + length : s);
+}
+
+//features of a line of 'length' cells after rotating it by 's' steps (still in order of 'at'):
+static void rotate_features(std::vector< SparseTiles::Feature > const &before, uint32_t s, uint32_t length, std::vector< SparseTiles::Feature > *after_) {
+	std::vector< SparseTiles::Feature > &after = *after_;
+	after = before;
+	size_t wrapped = after.size(); //first feature pushed off the end
+	for (size_t i = 0; i < after.size(); ++i) {
+		if (after[i].at >= length - s && wrapped == after.size()) wrapped = i;
+		after[i].at = (after[i].at + s) % length;
+	}
+	std::rotate(after.begin(), after.begin() + wrapped, after.end());
+}
+
+void Board::roll_row(uint32_t y, int32_t shift) {
+	assert(y < height);
+	uint32_t s = wrap_shift(shift, width);
+	if (s == 0) return;
+
+	std::vector< SparseTiles::Feature > before, after;
+	tiles.row_features(y, &before);
+	rotate_features(before, s, width, &after);
+	tiles.write_row_features(y, after);
+
+	line_rolled(y * width, 1, before, after);
+}
+
+void Board::roll_column(uint32_t x, int32_t shift) {
+	assert(x < width);
+	uint32_t s = wrap_shift(shift, height);
+	if (s == 0) return;
+
+	std::vector< SparseTiles::Feature > before, after;
+	tiles.column_features(x, &before);
+	rotate_features(before, s, height, &after);
+	//(a column crosses many chunks, so only touch the cells that changed)
+	size_t i = 0, j = 0;
+	while (i < before.size() || j < after.size()) {
+		if (j == after.size() || (i < before.size() && before[i].at < after[j].at)) {
+			tiles.set(x, before[i].at, TileFloor);
+			++i;
+		} else {
+			SparseTiles::Feature const &f = after[j];
+			bool same = (i < before.size() && before[i].at == f.at);
+			if (!same || before[i].type != f.type || before[i].slot != f.slot) tiles.set(x, f.at, f.type, f.slot);
+			if (same) ++i;
+			++j;
+		}
+	}
+
+	line_rolled(x, width, before, after);
+}
+
+void Board::line_rolled(uint32_t first, uint32_t stride, std::vector< SparseTiles::Feature > const &before, std::vector< SparseTiles::Feature > const &after) {
+	//walk both feature lists in order, to find the cells whose tile (and wall-ness) changed:
+	std::vector< uint32_t > opened, blocked; //(cells)
+	size_t i = 0, j = 0;
+	while (i < before.size() || j < after.size()) {
+		uint32_t at = std::min(i < before.size() ? before[i].at : -1U, j < after.size() ? after[j].at : -1U);
+		Tile old = TileFloor, now = TileFloor;
+		if (i < before.size() && before[i].at == at) old = before[i++].type;
+		if (j < after.size() && after[j].at == at) now = after[j++].type;
+		if (old == now) continue;
+		uint32_t cell = first + at * stride;
+		changed_cells.emplace_back(cell);
+		if (old == TileWall) opened.emplace_back(cell);
+		if (now == TileWall) blocked.emplace_back(cell);
+	}
+
+	//slots moved along with their tiles, so their instances now point at the new cell:
+	bool goal_moved = false;
+	for (SparseTiles::Feature const &f : after) {
+		uint32_t cell = first + f.at * stride;
+		instances[f.type][f.slot] = cell;
+		changed_slots.emplace_back(SlotChange{f.type, f.slot});
+		if (f.type == TileGoal && goal != cell) {
+			goal = cell;
+			goal_moved = true;
+		}
+	}
+
+	if (goal_moved) {
+		compute_distances(); //(which also re-reads the walls)
+		return;
+	}
+
+	//patch the distance field as if the line's walls had been edited with set():
+	// first block cells that became walls (leaving cells that stopped being walls as walls for now), then open the others.
+	for (uint32_t cell : opened) set_wall(cell, true);
+	for (uint32_t cell : blocked) set_wall(cell, true);
+	cells_blocked(blocked);
+	for (uint32_t cell : opened) {
+		set_wall(cell, false);
+		cell_opened(cell);
+	}
+}
+
+std::vector< Tile > Board::dense_tiles() const {
+	std::vector< Tile > out(size_t(width) * size_t(height));
+	for (uint32_t y = 0; y < height; ++y) {
+		tiles.read_row(0, y, width, out.data() + size_t(y) * width);
+	}
+	return out;
+}
+
+uint64_t Board::memory_bytes() const {
+	uint64_t bytes = tiles.memory_bytes();
+	for (uint32_t t = 0; t < TileCount; ++t) {
+		bytes += (instances[t].capacity() + instance_seeds[t].capacity()) * sizeof(uint32_t);
+	}
+	bytes += distance_chunk_at.capacity() * sizeof(uint32_t) + distance_chunks.capacity() * sizeof(DistanceChunk);
+	for (DistanceChunk const &c : distance_chunks) {
+		bytes += c.offsets.capacity() * sizeof(uint16_t) + c.wide.capacity() * sizeof(uint32_t);
+	}
+	return bytes;
+}
+
+//(the cell must already hold 't')
+void Board::add_instance(Tile t, uint32_t cell) {
+	uint32_t s = uint32_t(instances[t].size());
+	instances[t].emplace_back(cell);
+	instance_seeds[t].emplace_back(cell * 2654435761u);
+	tiles.set_slot(cell % width, cell / width, s);
+	changed_slots.emplace_back(SlotChange{t, s});
+}
+
+//swap-remove: the last instance moves into the freed slot, so only that one slot changes:
+void Board::remove_instance(Tile t, uint32_t cell) {
+	std::vector< uint32_t > &list = instances[t];
+	uint32_t s = tiles.slot(cell % width, cell / width);
+	assert(s < list.size() && list[s] == cell);
+	uint32_t moved = list.back();
+	list[s] = moved;
+	instance_seeds[t][s] = instance_seeds[t].back();
+	tiles.set_slot(moved % width, moved / width, s);
+	list.pop_back();
+	instance_seeds[t].pop_back();
+	if (s < list.size()) changed_slots.emplace_back(SlotChange{t, s});
+}
+
+uint32_t Board::neighbor(uint32_t cell, uint8_t dir) const {
+	uint32_t x = cell % width;
+	uint32_t y = cell / width;
+	if (dir == PosX) return (x + 1 < width ? cell + 1 : -1U);
+	if (dir == PosY) return (y + 1 < height ? cell + width : -1U);
+	if (dir == NegX) return (x > 0 ? cell - 1 : -1U);
+	if (dir == NegY) return (y > 0 ? cell - width : -1U);
+	return -1U;
+}
+
+uint32_t Board::allocate_distances(uint32_t position) {
+	assert(distance_chunk_at[position] == -1U);
+	uint32_t c = uint32_t(distance_chunks.size());
+	distance_chunk_at[position] = c;
+	distance_chunks.emplace_back();
+	DistanceChunk &chunk = distance_chunks.back();
+	chunk.offsets.assign(ChunkSize * ChunkSize, NoOffset);
+	uint32_t x = (position % chunks_x) * ChunkSize;
+	uint32_t y = (position / chunks_x) * ChunkSize;
+	for (uint32_t cy = 0; cy < ChunkSize; ++cy) {
+		chunk.walls[cy] = (y + cy < height ? tiles.chunk_row_mask(x, y + cy, TileWall) : 0);
+	}
+	return c;
+}
+
+void Board::set_distance(uint32_t x, uint32_t y, uint32_t d) {
+	uint32_t position, index;
+	locate(x, y, &position, &index);
+	uint32_t c = distance_chunk_at[position];
+	if (c == -1U) {
+		if (d == Unreachable) return;
+		c = allocate_distances(position);
+		distance_chunks[c].base = d - std::min(d, BaseSlack);
+	}
+	distance_chunks[c].set(index, d);
+}
+
+void Board::set_wall(uint32_t cell, bool value) {
+	uint32_t position, index;
+	locate(cell % width, cell / width, &position, &index);
+	uint32_t c = distance_chunk_at[position];
+	if (c == -1U) {
+		if (value == (tiles.get(cell % width, cell / width) == TileWall)) return;
+		c = allocate_distances(position);
+	}
+	uint64_t &row = distance_chunks[c].walls[index / ChunkSize];
+	uint64_t bit = uint64_t(1) << (index % ChunkSize);
+	row = (value ? row | bit : row & ~bit);
+}
+
+void Board::compute_distances() {
+	uint32_t chunks_y = (height + ChunkSize - 1) / ChunkSize;
+	distance_chunk_at.assign(size_t(chunks_x) * chunks_y, -1U);
+	distance_chunks.clear();
+	if (goal == -1U) return;
+
+	std::vector< uint32_t > todo;
+	set_distance(goal, 0);
+	todo.emplace_back(goal);
+	//(this is the hot loop of goal moves, so neighbors are found by coordinates rather than with neighbor())
+	for (size_t i = 0; i < todo.size(); ++i) {
+		uint32_t at = todo[i];
+		uint32_t x = at % width, y = at / width;
+		uint32_t next = distance(x, y) + 1;
+		auto visit = [&](uint32_t nx, uint32_t ny) {
+			if (distance(nx, ny) != Unreachable || wall(nx, ny)) return;
+			set_distance(nx, ny, next);
+			todo.emplace_back(ny * width + nx);
+		};
+		if (x + 1 < width) visit(x + 1, y);
+		if (y + 1 < height) visit(x, y + 1);
+		if (x > 0) visit(x - 1, y);
+		if (y > 0) visit(x, y - 1);
+	}
+}
+
+void Board::cell_blocked(uint32_t cell) {
+	cells_blocked(std::vector< uint32_t >(1, cell));
+}
+
+//New walls only invalidate the cells whose every shortest path ran through them. Taking invalidated cells in order
+// of their old distance d, a neighbor at d + 1 is invalidated too unless some other neighbor still has d (which,
+// by then, is final); invalidated cells then get re-solved from their unaffected neighbors.
+// (re-solving costs about 13 times as much per cell as the from-scratch BFS (priority queue vs. plain queue),
+//  so past 1/16 of the reached area it's faster to start over)
+void Board::cells_blocked(std::vector< uint32_t > const &cells) {
+	typedef std::pair< uint32_t, uint32_t > Entry; //(distance, cell)
+	std::priority_queue< Entry, std::vector< Entry >, std::greater< Entry > > invalid;
+	std::vector< uint32_t > affected;
+	for (uint32_t cell : cells) {
+		uint32_t d = distance(cell);
+		if (d == Unreachable) continue; //nothing routed through it (or already affected)
+		affected.emplace_back(cell);
+		set_distance(cell, Unreachable);
+		invalid.emplace(d, cell);
+	}
+	size_t limit = distance_chunks.size() * ChunkSize * ChunkSize / 16;
+	while (!invalid.empty()) {
+		Entry e = invalid.top();
+		invalid.pop();
+		for (uint8_t d = 0; d < 4; ++d) {
+			uint32_t n = neighbor(e.second, d);
+			if (n == -1U || distance(n) != e.first + 1) continue;
+			bool supported = false;
+			for (uint8_t d2 = 0; d2 < 4 && !supported; ++d2) {
+				uint32_t m = neighbor(n, d2);
+				supported = (m != -1U && distance(m) == e.first);
+			}
+			if (supported) continue;
+			set_distance(n, Unreachable);
+			invalid.emplace(e.first + 1, n);
+			affected.emplace_back(n);
+		}
+		if (affected.size() > limit) {
+			compute_distances();
+			return;
+		}
+	}
+
+	//re-solve affected cells (Dijkstra seeded from the edge of the affected region):
+	std::priority_queue< Entry, std::vector< Entry >, std::greater< Entry > > todo;
+	for (uint32_t at : affected) {
+		if (wall(at)) continue;
+		uint32_t best = Unreachable;
+		for (uint8_t d = 0; d < 4; ++d) {
+			uint32_t n = neighbor(at, d);
+			if (n == -1U) continue;
+			uint32_t dn = distance(n);
+			if (dn != Unreachable && dn + 1 < best) best = dn + 1;
+		}
+		if (best != Unreachable) {
+			set_distance(at, best);
+			todo.emplace(best, at);
+		}
+	}
+	while (!todo.empty()) {
+		Entry e = todo.top();
+		todo.pop();
+		if (e.first != distance(e.second)) continue; //stale
+		for (uint8_t d = 0; d < 4; ++d) {
+			uint32_t n = neighbor(e.second, d);
+			if (n == -1U || wall(n)) continue;
+			if (e.first + 1 < distance(n)) {
+				set_distance(n, e.first + 1);
+				todo.emplace(e.first + 1, n);
+			}
+		}
+	}
+}
+
+//An opened cell can only shorten paths, so relax outward from it:
+void Board::cell_opened(uint32_t cell) {
+	uint32_t best = distance(cell);
+	for (uint8_t d = 0; d < 4; ++d) {
+		uint32_t n = neighbor(cell, d);
+		if (n == -1U) continue;
+		uint32_t dn = distance(n);
+		if (dn != Unreachable && dn + 1 < best) best = dn + 1;
+	}
+	if (best == Unreachable) return;
+	set_distance(cell, best);
+
+	std::vector< uint32_t > todo;
+	todo.emplace_back(cell);
+	for (size_t i = 0; i < todo.size(); ++i) {
+		uint32_t at = todo[i];
+		uint32_t next = distance(at) + 1;
+		for (uint8_t d = 0; d < 4; ++d) {
+			uint32_t n = neighbor(at, d);
+			if (n == -1U || wall(n)) continue;
+			if (next < distance(n)) {
+				set_distance(n, next);
+				todo.emplace_back(n);
+			}
+		}
+	}
+}
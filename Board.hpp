@@ -0,0 +1,156 @@
+#pragma once
+
+#include "tiles.hpp"
+#include "SparseTiles.hpp"
+
+#include <vector>
+#include <cstdint>
+
+// The 'Board' struct holds the tile grid along with data derived from it:
+//  - the grid itself, stored sparsely (memory grows with the tiles that aren't floor, not with board area; see SparseTiles.hpp),
+//  - a packed list of cells per tile type (one GPU instance slot per cell),
+//  - a distance field (steps to the goal), stored in the same 64x64 chunks as the grid, but only for chunks a search
+//    from the goal has reached (so it grows with the region the goal can be reached from, at about two bytes per cell).
+// set(), roll_row(), and roll_column() keep all of these up to date, touching only the cells an edit affects.
+
+struct Board {
+	//replace the whole board (tiles is width * height, row-major):
+	void reset(uint32_t width, uint32_t height, std::vector< Tile > const &tiles);
+	//...or with a copy of a sparse grid (e.g. another board's), without going through a dense one:
+	void reset(SparseTiles const &tiles);
+
+	Tile get(uint32_t x, uint32_t y) const {
+		return tiles.get(x, y);
+	}
+
+	//does cell (x,y) hold a tile of type 't'? (coordinates off the board are never anything)
+	bool is(Tile t, uint32_t x, uint32_t y) const {
+		if (x >= width || y >= height) return false;
+		return tiles.get(x, y) == t;
+	}
+
+	//the whole grid as a width * height, row-major array (e.g. for saving a level):
+	std::vector< Tile > dense_tiles() const;
+
+	//change one cell; painting a goal moves the goal (the old goal cell becomes floor):
+	void set(uint32_t x, uint32_t y, Tile t);
+
+	//rotate row y (or column x) by 'shift' cells toward +x (or +y); cells pushed off one end come back on the other.
+	// Both work from the line's features (see SparseTiles::row_features), so they cost a step per chunk (rows) or per
+	// occupied chunk row (columns) plus one per feature, rather than one per cell; only the rolled line's instance slots are patched:
+	void roll_row(uint32_t y, int32_t shift);
+	void roll_column(uint32_t x, int32_t shift);
+
+	//steps from (x,y) to the goal, walking around walls; Unreachable if there's no path:
+	static constexpr uint32_t Unreachable = -1U;
+	uint32_t distance_to_goal(uint32_t x, uint32_t y) const {
+		return distance(y * width + x);
+	}
+
+	//bytes in use by the grid, instance lists, and distance field (to see how well the board compresses):
+	uint64_t memory_bytes() const;
+
+	//------- state -------
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	//each cell's tile, and for tiles that aren't floor, the cell's position in instances[tile] (its slot):
+	SparseTiles tiles;
+	uint32_t goal = -1U; //index of goal cell (-1U if there isn't one)
+
+	//instances[t] lists the cells holding type 't' (in no particular order):
+	// (floor is everywhere, so it doesn't get instances)
+	std::vector< uint32_t > instances[TileCount];
+	//...and for each instance, a hash of the cell it was created in. It moves along with the instance (through rolls
+	// and swap-removal), so it stays the same for as long as the tile does (e.g. to seed an animation phase):
+	std::vector< uint32_t > instance_seeds[TileCount];
+
+	//instance slots whose cell changed since the owner last cleared this list:
+	// (when 'instances_reset' is set, every slot should be considered changed)
+	struct SlotChange {
+		Tile type;
+		uint32_t slot;
+	};
+	std::vector< SlotChange > changed_slots;
+	bool instances_reset = true;
+
+	//cells whose tile changed since the owner last cleared this list (e.g. to patch a copy of the tiles on the GPU):
+	// (when 'tiles_reset' is set, every cell should be considered changed)
+	std::vector< uint32_t > changed_cells;
+	bool tiles_reset = true;
+
+	enum Dir : uint8_t { PosX = 0, PosY = 1, NegX = 2, NegY = 3 };
+
+private:
+	//distance field storage for one chunk. Neighboring open cells' distances differ by at most one,
+	// so a chunk's distances seldom span more than a few hundred steps and are kept as 16-bit offsets from 'base';
+	// a chunk whose distances ever span more than that switches to full 32-bit values ('wide').
+	// The chunk also keeps a copy of its walls, one bit per cell, since wall checks are too hot for sparse lookups:
+	static constexpr uint32_t ChunkSize = SparseTiles::ChunkSize;
+	static constexpr uint16_t NoOffset = 0xffff; //(offset of an unreachable cell)
+	struct DistanceChunk {
+		uint32_t base = 0;
+		std::vector< uint16_t > offsets; //distance - base, or NoOffset (ChunkSize * ChunkSize, unless wide)
+		std::vector< uint32_t > wide; //distance, or Unreachable (ChunkSize * ChunkSize once the offsets overflowed, else empty)
+		uint64_t walls[ChunkSize]; //bit x of walls[y]: that cell of the chunk is a wall
+		uint32_t get(uint32_t i) const {
+			if (!wide.empty()) return wide[i];
+			return (offsets[i] == NoOffset ? Unreachable : base + offsets[i]);
+		}
+		void set(uint32_t i, uint32_t d);
+	};
+	uint32_t chunks_x = 0; //chunks per row of chunks
+	std::vector< uint32_t > distance_chunk_at; //index into distance_chunks for each chunk position (row-major), -1U if not reached
+	std::vector< DistanceChunk > distance_chunks;
+
+	//chunk position of cell (x,y), and the cell's index within its chunk:
+	void locate(uint32_t x, uint32_t y, uint32_t *position, uint32_t *index) const {
+		*position = (y / ChunkSize) * chunks_x + x / ChunkSize;
+		*index = (y % ChunkSize) * ChunkSize + x % ChunkSize;
+	}
+	uint32_t distance(uint32_t x, uint32_t y) const {
+		uint32_t position, index;
+		locate(x, y, &position, &index);
+		uint32_t c = distance_chunk_at[position];
+		return (c == -1U ? Unreachable : distance_chunks[c].get(index));
+	}
+	bool wall(uint32_t x, uint32_t y) const {
+		uint32_t position, index;
+		locate(x, y, &position, &index);
+		uint32_t c = distance_chunk_at[position];
+		if (c == -1U) return tiles.get(x, y) == TileWall;
+		return (distance_chunks[c].walls[index / ChunkSize] >> (index % ChunkSize)) & 1;
+	}
+	//(the same, by cell index)
+	uint32_t distance(uint32_t cell) const {
+		return distance(cell % width, cell / width);
+	}
+	bool wall(uint32_t cell) const {
+		return wall(cell % width, cell / width);
+	}
+	void set_distance(uint32_t x, uint32_t y, uint32_t d); //(allocates the cell's chunk if need be)
+	void set_distance(uint32_t cell, uint32_t d) {
+		set_distance(cell % width, cell / width, d);
+	}
+	//(chunks that haven't been reached read their walls from the tiles, so they only need allocating to disagree with them)
+	void set_wall(uint32_t cell, bool value);
+	uint32_t allocate_distances(uint32_t position); //add a chunk (all unreachable, walls copied from tiles); returns its index
+
+	void add_instance(Tile t, uint32_t cell);
+	void remove_instance(Tile t, uint32_t cell);
+
+	//rebuild everything derived from 'tiles' (which was just replaced):
+	void rebuild();
+
+	//after the features of a line (cells first + at * stride) were rotated, point their instances at their new cells and
+	// patch the distance field; 'before' and 'after' are the line's features (in order of 'at') before and after the rotation:
+	void line_rolled(uint32_t first, uint32_t stride, std::vector< SparseTiles::Feature > const &before, std::vector< SparseTiles::Feature > const &after);
+
+	//neighbor of 'cell' in direction 'dir', or -1U if that's off the board:
+	uint32_t neighbor(uint32_t cell, uint8_t dir) const;
+
+	void compute_distances(); //from scratch
+	void cell_blocked(uint32_t cell); //'cell' just became a wall
+	void cells_blocked(std::vector< uint32_t > const &cells); //several cells just became walls
+	void cell_opened(uint32_t cell); //'cell' just stopped being a wall
+};
@@ -0,0 +1,291 @@
+#include "Capture.hpp"
+
+#include "gl_errors.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CAPTURE_SSE2 1
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+//BT.601 limited-range conversion, in fixed point (chroma from the sum of a 2x2 block, hence the extra >> 2):
+static inline uint8_t luma(int32_t r, int32_t g, int32_t b) {
+	return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+static inline uint8_t chroma_u(int32_t r4, int32_t g4, int32_t b4) {
+	return uint8_t(((-38 * r4 - 74 * g4 + 112 * b4 + 512) >> 10) + 128);
+}
+static inline uint8_t chroma_v(int32_t r4, int32_t g4, int32_t b4) {
+	return uint8_t(((112 * r4 - 94 * g4 - 18 * b4 + 512) >> 10) + 128);
+}
+
+#ifdef CAPTURE_SSE2
+//given four 32-bit [a0, b0, a1, b1] (from _mm_madd_epi16 on two RGBA pixels) in each of 'lo' and 'hi',
+// return [a0+b0, a1+b1] from 'lo' followed by the same from 'hi':
+static inline __m128i pair_sums(__m128i lo, __m128i hi) {
+	lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+	hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+	lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3,1,2,0));
+	hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3,1,2,0));
+	return _mm_unpacklo_epi64(lo, hi);
+}
+#endif
+
+void rgba_to_i420(uint8_t const *rgba, uint32_t w, uint32_t h, uint8_t *out) {
+	uint32_t cw = (w + 1) / 2, ch = (h + 1) / 2;
+	uint8_t *out_y = out;
+	uint8_t *out_u = out_y + size_t(w) * h;
+	uint8_t *out_v = out_u + size_t(cw) * ch;
+
+	//(rows come bottom-first from glReadPixels, so output row 'y' is input row h-1-y)
+	auto row = [&](uint32_t y) {
+		return rgba + size_t(h - 1 - std::min(y, h - 1)) * w * 4;
+	};
+
+	//luma:
+	for (uint32_t y = 0; y < h; ++y) {
+		uint8_t const *src = row(y);
+		uint8_t *dst = out_y + size_t(y) * w;
+		uint32_t x = 0;
+		#ifdef CAPTURE_SSE2
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const coef = _mm_set_epi16(0,25,129,66, 0,25,129,66);
+		__m128i const round = _mm_set1_epi32(128);
+		__m128i const offset = _mm_set1_epi32(16);
+		auto four = [&](uint8_t const *px) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const * >(px));
+			__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), coef);
+			__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), coef);
+			__m128i sum = pair_sums(lo, hi);
+			return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sum, round), 8), offset);
+		};
+		for (; x + 8 <= w; x += 8) {
+			__m128i y16 = _mm_packs_epi32(four(src + x * 4), four(src + x * 4 + 16));
+			_mm_storel_epi64(reinterpret_cast< __m128i * >(dst + x), _mm_packus_epi16(y16, y16));
+		}
+		#endif
+		for (; x < w; ++x) {
+			uint8_t const *px = src + x * 4;
+			dst[x] = luma(px[0], px[1], px[2]);
+		}
+	}
+
+	//chroma, from 2x2 blocks (the last row / column is repeated if the size is odd):
+	for (uint32_t cy = 0; cy < ch; ++cy) {
+		uint8_t const *top = row(2 * cy);
+		uint8_t const *bottom = row(2 * cy + 1);
+		uint8_t *dst_u = out_u + size_t(cy) * cw;
+		uint8_t *dst_v = out_v + size_t(cy) * cw;
+		uint32_t cx = 0;
+		#ifdef CAPTURE_SSE2
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const coef_u = _mm_set_epi16(0,112,-74,-38, 0,112,-74,-38);
+		__m128i const coef_v = _mm_set_epi16(0,-18,-94,112, 0,-18,-94,112);
+		__m128i const round = _mm_set1_epi32(512);
+		__m128i const offset = _mm_set1_epi32(128);
+		//2x2 sums of four pixels in each of two rows, as 16-bit [R G B A] for two blocks:
+		auto blocks = [&](uint8_t const *a, uint8_t const *b) {
+			__m128i va = _mm_loadu_si128(reinterpret_cast< __m128i const * >(a));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast< __m128i const * >(b));
+			__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+			__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+			lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+			hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+			return _mm_unpacklo_epi64(lo, hi);
+		};
+		auto finish = [&](__m128i lo, __m128i hi, __m128i coef) {
+			__m128i sum = pair_sums(_mm_madd_epi16(lo, coef), _mm_madd_epi16(hi, coef));
+			sum = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sum, round), 10), offset);
+			__m128i c16 = _mm_packs_epi32(sum, sum);
+			return uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(c16, c16)));
+		};
+		for (; 2 * cx + 8 <= w; cx += 4) {
+			__m128i b0 = blocks(top + cx * 8, bottom + cx * 8);
+			__m128i b1 = blocks(top + cx * 8 + 16, bottom + cx * 8 + 16);
+			uint32_t u = finish(b0, b1, coef_u);
+			uint32_t v = finish(b0, b1, coef_v);
+			std::memcpy(dst_u + cx, &u, 4);
+			std::memcpy(dst_v + cx, &v, 4);
+		}
+		#endif
+		for (; cx < cw; ++cx) {
+			uint32_t x0 = 2 * cx, x1 = std::min(2 * cx + 1, w - 1);
+			int32_t r4 = top[x0*4+0] + top[x1*4+0] + bottom[x0*4+0] + bottom[x1*4+0];
+			int32_t g4 = top[x0*4+1] + top[x1*4+1] + bottom[x0*4+1] + bottom[x1*4+1];
+			int32_t b4 = top[x0*4+2] + top[x1*4+2] + bottom[x0*4+2] + bottom[x1*4+2];
+			dst_u[cx] = chroma_u(r4, g4, b4);
+			dst_v[cx] = chroma_v(r4, g4, b4);
+		}
+	}
+}
+
+Capture::Capture(std::string const &path_, glm::uvec2 size_, uint32_t fps) : size(size_), path(path_) {
+	if (size.x == 0 || size.y == 0) throw std::runtime_error("Can't capture an empty drawable.");
+
+	if (path.size() >= 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+		//(level 1: compression has to keep up with the game)
+		gz = gzopen(path.c_str(), "wb1");
+		if (!gz) throw std::runtime_error("Failed to open '" + path + "' for capture.");
+	} else {
+		file.open(path, std::ios::binary);
+		if (!file) throw std::runtime_error("Failed to open '" + path + "' for capture.");
+	}
+
+	std::string header = "YUV4MPEG2 W" + std::to_string(size.x) + " H" + std::to_string(size.y)
+		+ " F" + std::to_string(std::max(1U, fps)) + ":1 Ip A1:1 C420jpeg\n";
+	write(header.data(), header.size());
+
+	for (Slot &slot : ring) {
+		glGenBuffers(1, &slot.pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(size.x) * size.y * 4, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	GL_ERRORS();
+
+	worker = std::thread([this](){ write_frames(); });
+}
+
+Capture::~Capture() {
+	harvest(true);
+	for (Slot &slot : ring) {
+		if (slot.fence) glDeleteSync(slot.fence);
+		glDeleteBuffers(1, &slot.pbo);
+	}
+
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		stopping = true;
+	}
+	queue_changed.notify_all();
+	worker.join();
+
+	if (gz) gzclose(gz);
+	else file.close();
+
+	std::cout << "Captured " << frames_written << " frames to '" << path << "'";
+	if (frames_dropped) std::cout << " (" << frames_dropped << " dropped to keep up)";
+	std::cout << "." << std::endl;
+}
+
+void Capture::frame(glm::uvec2 drawable_size) {
+	harvest(false);
+
+	if (drawable_size != size) {
+		if (!warned_size) {
+			std::cerr << "NOTE: not capturing while the drawable (" << drawable_size.x << "x" << drawable_size.y << ") differs from the capture size (" << size.x << "x" << size.y << ")." << std::endl;
+			warned_size = true;
+		}
+		++frames_dropped;
+		return;
+	}
+
+	//every buffer still waiting on the GPU? (rather than stall, skip this frame)
+	if (ring_pending == RingSize) {
+		++frames_dropped;
+		return;
+	}
+
+	Slot &slot = ring[ring_next];
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring_next = (ring_next + 1) % RingSize;
+	++ring_pending;
+	GL_ERRORS();
+}
+
+void Capture::harvest(bool wait) {
+	size_t bytes = size_t(size.x) * size.y * 4;
+	while (ring_pending) {
+		Slot &slot = ring[(ring_next + RingSize - ring_pending) % RingSize];
+		GLenum status = glClientWaitSync(slot.fence, (wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0), (wait ? GLuint64(1000000000) : 0));
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			if (!wait) break;
+			//(a readback that takes over a second while shutting down isn't worth waiting for)
+			++frames_dropped;
+		} else {
+			std::vector< uint8_t > buffer;
+			bool full = false;
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				full = (queue.size() >= MaxQueued);
+				if (!full && !spare.empty()) {
+					buffer = std::move(spare.back());
+					spare.pop_back();
+				}
+			}
+			if (full) {
+				//(the worker is behind; the frame is dropped rather than letting the queue grow)
+				++frames_dropped;
+			} else {
+				buffer.resize(bytes);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+				void const *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(bytes), GL_MAP_READ_BIT);
+				if (mapped) {
+					std::memcpy(buffer.data(), mapped, bytes);
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				}
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+				if (mapped) {
+					{
+						std::unique_lock< std::mutex > lock(mutex);
+						queue.emplace_back(std::move(buffer));
+					}
+					queue_changed.notify_one();
+				} else {
+					++frames_dropped;
+				}
+			}
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		--ring_pending;
+	}
+	GL_ERRORS();
+}
+
+void Capture::write_frames() {
+	std::vector< uint8_t > yuv(size_t(size.x) * size.y + 2 * size_t((size.x + 1) / 2) * ((size.y + 1) / 2));
+	static char const FrameHeader[] = "FRAME\n";
+	while (true) {
+		std::vector< uint8_t > rgba;
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			queue_changed.wait(lock, [this](){ return stopping || !queue.empty(); });
+			if (queue.empty()) break; //(stopping, and everything queued was written)
+			rgba = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		rgba_to_i420(rgba.data(), size.x, size.y, yuv.data());
+		write(FrameHeader, sizeof(FrameHeader) - 1);
+		write(yuv.data(), yuv.size());
+		if (!write_failed) ++frames_written;
+
+		std::unique_lock< std::mutex > lock(mutex);
+		spare.emplace_back(std::move(rgba));
+	}
+}
+
+void Capture::write(void const *data, size_t count) {
+	if (write_failed) return;
+	bool ok;
+	if (gz) {
+		ok = (gzwrite(gz, data, unsigned(count)) == int(count));
+	} else {
+		file.write(reinterpret_cast< char const * >(data), count);
+		ok = bool(file);
+	}
+	if (!ok) {
+		std::cerr << "WARNING: failed writing to capture file '" << path << "'; no more frames will be written." << std::endl;
+		write_failed = true;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+#include <zlib.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 'Capture' records every frame the game draws to a YUV4MPEG2 (.y4m) video, or a gzip'd one (.y4m.gz).
+// The main loop never waits on it:
+//  - frame() starts an asynchronous glReadPixels into the next pixel buffer object of a small ring and fences it;
+//  - buffers whose fences have signaled (a frame or two later) are copied out and queued for a worker thread;
+//  - the worker converts to 4:2:0 YUV (with SSE2 where available) and writes to disk.
+// If the GPU or the worker falls behind, frames are dropped (and counted) rather than stalling the main loop.
+
+struct Capture {
+	//open 'path' (gzip'd if it ends in ".gz") for frames of 'size' at 'fps'; throws on failure:
+	Capture(std::string const &path, glm::uvec2 size, uint32_t fps);
+	//finishes any frames in flight:
+	~Capture();
+	Capture(Capture const &) = delete;
+	Capture &operator=(Capture const &) = delete;
+
+	//call after drawing each frame (before swapping); reads back the backbuffer:
+	void frame(glm::uvec2 drawable_size);
+
+	//------- state -------
+
+	glm::uvec2 size;
+	std::string path;
+
+	//readback ring; slots are filled in order and harvested oldest-first:
+	static constexpr uint32_t RingSize = 3;
+	struct Slot {
+		GLuint pbo = 0;
+		GLsync fence = 0;
+	} ring[RingSize];
+	uint32_t ring_next = 0; //slot the next readback goes into
+	uint32_t ring_pending = 0; //readbacks in flight (the oldest is ring_next - ring_pending)
+
+	//frames waiting for the worker (RGBA, bottom row first, as read), and spare frame buffers:
+	static constexpr size_t MaxQueued = 8;
+	std::deque< std::vector< uint8_t > > queue;
+	std::vector< std::vector< uint8_t > > spare;
+	bool stopping = false;
+	std::mutex mutex; //guards queue, spare, stopping
+	std::condition_variable queue_changed;
+	std::thread worker;
+
+	//output (one of):
+	std::ofstream file;
+	gzFile gz = nullptr;
+	bool write_failed = false; //(only touched by the worker, once it's running)
+
+	//stats:
+	uint64_t frames_written = 0; //(only touched by the worker)
+	uint64_t frames_dropped = 0;
+	bool warned_size = false;
+
+private:
+	void harvest(bool wait); //queue finished readbacks (waiting for all of them if 'wait')
+	void write_frames(); //worker thread
+	void write(void const *data, size_t count);
+};
+
+//convert a bottom-up RGBA image to top-down planar 4:2:0 YUV (BT.601, limited range), as stored in a Y4M frame:
+// (out must hold w*h + 2*((w+1)/2)*((h+1)/2) bytes)
+void rgba_to_i420(uint8_t const *rgba, uint32_t w, uint32_t h, uint8_t *out);
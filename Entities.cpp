@@ -0,0 +1,153 @@
+#include "Entities.hpp"
+
+#include "parallel_for.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+constexpr size_t Entities::BatchSize;
+
+namespace {
+	//call fn(begin, end) over [0,count) in batches of BatchSize, spread over the worker threads of parallel_for:
+	template< typename F >
+	void in_batches(size_t count, F const &fn) {
+		size_t batches = (count + Entities::BatchSize - 1) / Entities::BatchSize;
+		if (batches <= 1) {
+			fn(size_t(0), count);
+			return;
+		}
+		parallel_for(uint32_t(batches), [count,&fn](uint32_t b){
+			size_t begin = b * Entities::BatchSize;
+			fn(begin, std::min(count, begin + Entities::BatchSize));
+		});
+	}
+}
+
+Entities::Handle Entities::create(uint32_t components) {
+	if (components == 0) {
+		throw std::runtime_error("Entities need at least one component.");
+	}
+
+	//find (or add) the archetype:
+	uint32_t a = 0;
+	while (a < archetypes.size() && archetypes[a].components != components) ++a;
+	if (a == archetypes.size()) {
+		archetypes.emplace_back();
+		archetypes.back().components = components;
+	}
+	Archetype &archetype = archetypes[a];
+
+	//find (or add) a slot:
+	uint32_t index;
+	if (!free_slots.empty()) {
+		index = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		index = uint32_t(slots.size());
+		slots.emplace_back();
+	}
+	Slot &slot = slots[index];
+	slot.archetype = a;
+	slot.row = uint32_t(archetype.size());
+
+	Handle handle;
+	handle.index = index;
+	handle.generation = slot.generation;
+
+	archetype.handles.emplace_back(handle);
+	if (components & Position) archetype.position.emplace_back(0.0f);
+	if (components & Velocity) archetype.velocity.emplace_back(0.0f);
+	if (components & Lifetime) archetype.lifetime.emplace_back(0.0f);
+	if (components & Render) {
+		archetype.group.emplace_back(0);
+		archetype.phase.emplace_back(0.0f);
+	}
+	live += 1;
+	return handle;
+}
+
+void Entities::destroy(Handle handle) {
+	if (!alive(handle)) return;
+	Slot const &slot = slots[handle.index];
+	remove_row(slot.archetype, slot.row);
+}
+
+void Entities::remove_row(uint32_t a, uint32_t r) {
+	Archetype &archetype = archetypes[a];
+	assert(r < archetype.size());
+
+	//retire the removed entity's slot (bumping its generation invalidates outstanding handles):
+	Slot &removed = slots[archetype.handles[r].index];
+	removed.archetype = -1U;
+	removed.generation += 1;
+	free_slots.emplace_back(archetype.handles[r].index);
+
+	//move the last row into its place:
+	uint32_t last = uint32_t(archetype.size() - 1);
+	if (r != last) {
+		slots[archetype.handles[last].index].row = r;
+		archetype.handles[r] = archetype.handles[last];
+		if (archetype.components & Position) archetype.position[r] = archetype.position[last];
+		if (archetype.components & Velocity) archetype.velocity[r] = archetype.velocity[last];
+		if (archetype.components & Lifetime) archetype.lifetime[r] = archetype.lifetime[last];
+		if (archetype.components & Render) {
+			archetype.group[r] = archetype.group[last];
+			archetype.phase[r] = archetype.phase[last];
+		}
+	}
+	archetype.handles.pop_back();
+	if (archetype.components & Position) archetype.position.pop_back();
+	if (archetype.components & Velocity) archetype.velocity.pop_back();
+	if (archetype.components & Lifetime) archetype.lifetime.pop_back();
+	if (archetype.components & Render) {
+		archetype.group.pop_back();
+		archetype.phase.pop_back();
+	}
+	live -= 1;
+}
+
+void Entities::integrate(float elapsed) {
+	for (Archetype &archetype : archetypes) {
+		if ((archetype.components & (Position | Velocity)) != (Position | Velocity)) continue;
+		glm::vec3 *position = archetype.position.data();
+		glm::vec3 const *velocity = archetype.velocity.data();
+		in_batches(archetype.size(), [=](size_t begin, size_t end){
+			for (size_t i = begin; i < end; ++i) {
+				position[i] += elapsed * velocity[i];
+			}
+		});
+	}
+}
+
+void Entities::age(float elapsed) {
+	for (uint32_t a = 0; a < archetypes.size(); ++a) {
+		Archetype &archetype = archetypes[a];
+		if (!(archetype.components & Lifetime)) continue;
+		float *lifetime = archetype.lifetime.data();
+		in_batches(archetype.size(), [=](size_t begin, size_t end){
+			for (size_t i = begin; i < end; ++i) {
+				lifetime[i] -= elapsed;
+			}
+		});
+
+		//removals swap rows around, so they happen afterward (last row first, so swapped-in rows were already checked):
+		expired.clear();
+		for (uint32_t i = 0; i < uint32_t(archetype.size()); ++i) {
+			if (lifetime[i] <= 0.0f) expired.emplace_back(i);
+		}
+		for (auto r = expired.rbegin(); r != expired.rend(); ++r) {
+			remove_row(a, *r);
+		}
+	}
+}
+
+void Entities::extract(std::vector< std::vector< glm::vec4 > > *out_) const {
+	std::vector< std::vector< glm::vec4 > > &out = *out_;
+	for (Archetype const &archetype : archetypes) {
+		if ((archetype.components & (Position | Render)) != (Position | Render)) continue;
+		for (size_t i = 0; i < archetype.size(); ++i) {
+			assert(archetype.group[i] < out.size());
+			out[archetype.group[i]].emplace_back(archetype.position[i], archetype.phase[i]);
+		}
+	}
+}
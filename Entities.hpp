@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+// 'Entities' stores the game's non-tile objects (player, pickups, HUD icons, ...) by archetype:
+// every entity with the same set of components shares an Archetype, which keeps one dense column per component,
+// so systems (integrate, age, extract) walk contiguous arrays and skip archetypes that lack what they need.
+// Entities are referred to by Handles, which stay valid while rows move around (destroying an entity swaps the last
+// row of its archetype into its place) and go stale, rather than dangling, once the entity is destroyed.
+
+struct Entities {
+	//components (an archetype is a set of these):
+	enum Component : uint32_t {
+		Position = 0x1, //world position
+		Velocity = 0x2, //world units per second, added to Position by integrate()
+		Lifetime = 0x4, //seconds left; age() destroys the entity when it runs out
+		Render = 0x8, //drawn by the caller: a group (e.g. which mesh) and an animation phase, gathered by extract()
+	};
+
+	struct Handle {
+		uint32_t index = -1U; //slot in 'slots'
+		uint32_t generation = 0; //must match the slot's generation for the handle to be valid
+		bool operator==(Handle const &o) const { return index == o.index && generation == o.generation; }
+		bool operator!=(Handle const &o) const { return !(*this == o); }
+	};
+
+	struct Archetype {
+		uint32_t components = 0;
+		std::vector< Handle > handles; //(which entity each row holds)
+		//columns (empty unless the archetype has the component):
+		std::vector< glm::vec3 > position;
+		std::vector< glm::vec3 > velocity;
+		std::vector< float > lifetime;
+		std::vector< uint32_t > group;
+		std::vector< float > phase;
+		size_t size() const { return handles.size(); }
+	};
+
+	//make an entity with the given components (zero-initialized); throws if 'components' is empty:
+	Handle create(uint32_t components);
+
+	//remove an entity (does nothing if the handle is stale):
+	void destroy(Handle handle);
+
+	//does the handle refer to a live entity?
+	bool alive(Handle handle) const {
+		return handle.index < slots.size() && slots[handle.index].generation == handle.generation && slots[handle.index].archetype != -1U;
+	}
+
+	//component access (the entity must be alive and have the component):
+	glm::vec3 &position(Handle handle) { return row(handle, Position, &Archetype::position); }
+	glm::vec3 &velocity(Handle handle) { return row(handle, Velocity, &Archetype::velocity); }
+	float &lifetime(Handle handle) { return row(handle, Lifetime, &Archetype::lifetime); }
+	uint32_t &group(Handle handle) { return row(handle, Render, &Archetype::group); }
+	float &phase(Handle handle) { return row(handle, Render, &Archetype::phase); }
+
+	size_t size() const { return live; }
+
+	//------- systems -------
+	//(integrate and age split large archetypes into batches of BatchSize rows, spread over a bounded set of threads, as Agents::step does)
+
+	//move everything with a Velocity:
+	void integrate(float elapsed);
+
+	//count down every Lifetime, destroying the entities whose time is up:
+	void age(float elapsed);
+
+	//append (position, phase) of every Render entity to out[group] (out must have an entry for every group in use):
+	void extract(std::vector< std::vector< glm::vec4 > > *out) const;
+
+	static constexpr size_t BatchSize = 4096;
+
+	//------- state -------
+
+	std::vector< Archetype > archetypes;
+
+private:
+	struct Slot {
+		uint32_t archetype = -1U; //-1U if the slot is free
+		uint32_t row = 0;
+		uint32_t generation = 0;
+	};
+	std::vector< Slot > slots;
+	std::vector< uint32_t > free_slots;
+	size_t live = 0;
+
+	//scratch for age (rows whose lifetime ran out):
+	std::vector< uint32_t > expired;
+
+	template< typename T >
+	T &row(Handle handle, uint32_t component, std::vector< T > Archetype::*column);
+
+	void remove_row(uint32_t archetype, uint32_t row);
+};
+
+template< typename T >
+T &Entities::row(Handle handle, uint32_t component, std::vector< T > Archetype::*column) {
+	assert(alive(handle));
+	Slot const &slot = slots[handle.index];
+	Archetype &a = archetypes[slot.archetype];
+	assert(a.components & component);
+	(void)component;
+	return (a.*column)[slot.row];
+}
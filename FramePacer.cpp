@@ -0,0 +1,76 @@
+#include "FramePacer.hpp"
+
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+FramePacer::FramePacer(Mode mode_, float refresh_rate) : mode(mode_) {
+	if (!(refresh_rate > 0.0f)) refresh_rate = 60.0f;
+	refresh = std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(1.0 / refresh_rate));
+	work.assign(32, Clock::duration::zero());
+	stats.since = Clock::now();
+}
+
+FramePacer::Clock::duration FramePacer::work_estimate() const {
+	return *std::max_element(work.begin(), work.end());
+}
+
+void FramePacer::wait() {
+	if (mode != Latency || !have_present) return;
+
+	//aim for the first vblank that can still be met:
+	Clock::duration lead = work_estimate() + margin;
+	Clock::time_point now = Clock::now();
+	target_vblank = last_present + refresh;
+	while (target_vblank - lead < now) target_vblank += refresh;
+	Clock::time_point wake = target_vblank - lead;
+
+	//sleep most of the way (the OS oversleeps a bit), then yield until the deadline:
+	Clock::time_point coarse = wake - std::chrono::milliseconds(1);
+	if (coarse > now) std::this_thread::sleep_until(coarse);
+	while (Clock::now() < wake) std::this_thread::yield();
+}
+
+void FramePacer::sample_input() {
+	input_time = Clock::now();
+}
+
+void FramePacer::rendered() {
+	render_time = Clock::now();
+	work[work_next] = render_time - input_time;
+	work_next = (work_next + 1) % work.size();
+}
+
+void FramePacer::presented() {
+	Clock::time_point now = Clock::now();
+
+	//refine the refresh estimate from consecutive presents that look like single refreshes:
+	if (have_present) {
+		Clock::duration interval = now - last_present;
+		if (interval > refresh / 2 && interval < refresh * 3 / 2) {
+			refresh += (interval - refresh) / 16;
+		}
+		if (mode == Latency && now > target_vblank + refresh / 2) ++stats.missed;
+	}
+	last_present = now;
+	have_present = true;
+
+	double ms = std::chrono::duration< double, std::milli >(now - input_time).count();
+	stats.frames += 1;
+	stats.total_ms += ms;
+	stats.max_ms = std::max(stats.max_ms, ms);
+
+	if (now - stats.since > std::chrono::seconds(5)) {
+		std::cout << (mode == Latency ? "[latency pacing]" : "[vsync pacing]")
+			<< " input-to-present " << (stats.total_ms / stats.frames) << "ms avg, " << stats.max_ms << "ms max;"
+			<< " refresh " << std::chrono::duration< double, std::milli >(refresh).count() << "ms;"
+			<< " work " << std::chrono::duration< double, std::milli >(work_estimate()).count() << "ms";
+		if (mode == Latency) std::cout << "; " << stats.missed << "/" << stats.frames << " frames missed their vblank";
+		std::cout << std::endl;
+		stats.since = now;
+		stats.frames = 0;
+		stats.missed = 0;
+		stats.total_ms = 0.0;
+		stats.max_ms = 0.0;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+// 'FramePacer' decides when the main loop should start each frame.
+//
+// In the default (vsync) mode frames start as soon as the previous swap returns, so input
+// sampled at the start of a frame waits most of a refresh before the frame is even submitted.
+// In latency mode the pacer predicts the next vblank from measured present times and sleeps until
+// just before the last moment a frame could start and still make it, so input is sampled as late as possible.
+//
+// Either way it measures input-to-present latency (from sample_input() to presented()) and reports it periodically.
+
+struct FramePacer {
+	typedef std::chrono::steady_clock Clock;
+
+	enum Mode { VSync, Latency };
+
+	FramePacer(Mode mode, float refresh_rate);
+
+	//latency mode: sleep until it's time to start the next frame (returns immediately in vsync mode):
+	void wait();
+	//call just before polling events:
+	void sample_input();
+	//call once the frame's rendering has finished, just before swapping:
+	void rendered();
+	//call once the swap has completed (i.e., at about the time the frame was shown):
+	void presented();
+
+	Mode mode;
+
+	//------- state -------
+
+	Clock::duration refresh; //estimated time between vblanks
+	Clock::time_point last_present; //estimated time of the most recent vblank
+	bool have_present = false;
+
+	//recent (sample_input() to rendered()) times; the wake-up deadline leaves room for the slowest of these:
+	std::vector< Clock::duration > work;
+	uint32_t work_next = 0;
+	Clock::duration margin = std::chrono::microseconds(1500); //extra slack for scheduling jitter
+
+	Clock::time_point input_time;
+	Clock::time_point render_time;
+
+	//latency statistics since last report:
+	struct {
+		Clock::time_point since;
+		uint32_t frames = 0;
+		uint32_t missed = 0; //frames presented later than the vblank they were aimed at
+		double total_ms = 0.0;
+		double max_ms = 0.0;
+	} stats;
+
+private:
+	Clock::duration work_estimate() const;
+	Clock::time_point target_vblank; //vblank the current frame was aimed at (latency mode)
+};
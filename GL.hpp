@@ -3,7 +3,10 @@
 //"GL.hpp" is a convenience header to include a minimal set of "modern" OpenGL function prototypes.
 // -- this is in contrast to, e.g., SDL_OpenGL which may include a bunch of OpenGL1.2 cruft.
 
-#ifdef _WIN32
+//On Windows and Linux, GL functions are called through a table of pointers (gl_shims.*pp),
+// loaded by init_gl_shims(); this also lets gl_trace.*pp interpose on every call.
+#if defined(_WIN32) || defined(__linux__)
+#define GL_SHIMS 1
 #include "gl_shims.hpp"
 #undef near
 #undef min
@@ -3,6 +3,10 @@
 #include "gl_errors.hpp" //helper for dumpping OpenGL error messages
 #include "read_chunk.hpp" //helper for reading a vector of structures from a file
 #include "data_path.hpp" //helper to get paths relative to executable
+#include "AssetPack.hpp" //packed assets, looked up by path hash
+#include "generate_board.hpp" //constraint-based board layout
+#include "LevelPack.hpp" //levels saved by the editor
+#include "philox.hpp" //counter-based random numbers
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -10,83 +14,154 @@
 #include <fstream>
 #include <map>
 #include <cstddef>
-#include <random>
 #include <algorithm>
 #include <string>
 #include <cstdlib>
+#include <cmath>
+#include <cassert>
 
-//helper defined later; throws if shader compilation fails:
+constexpr float Game::IdleRateStep;
+constexpr float Game::IdlePeriod;
+
+//helpers defined later; throw if shader compilation or program linking fails:
 static GLuint compile_shader(GLenum type, std::string const &source);
+static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader);
+
+//GLSL shared by every program that draws meshes: vertices are pulled from a buffer texture instead of attributes.
+// each is seven 32-bit words: position (3 floats), normal (3 floats), color (rgba8),
+// and each instance adds an offset read from a second buffer texture (non-instanced draws bind a single zero offset).
+//Instanced draws can also animate in place ('idle', see Game::TileIdle), from 'time' and the instance's phase (its w):
+static char const *PullVertexGLSL =
+	"uniform usamplerBuffer vertices;\n"
+	"uniform samplerBuffer instances;\n"
+	"uniform float time;\n"
+	"uniform vec4 idle;\n" //spin (radians/second), bob (height), pulse (fraction of size), bob and pulse rate (radians/second)
+	"void pull_vertex(out vec3 Position, out vec3 Normal, out vec4 Color) {\n"
+	"	int base = gl_VertexID * 7;\n"
+	"	Position = uintBitsToFloat(uvec3(texelFetch(vertices, base+0).r, texelFetch(vertices, base+1).r, texelFetch(vertices, base+2).r));\n"
+	"	Normal = uintBitsToFloat(uvec3(texelFetch(vertices, base+3).r, texelFetch(vertices, base+4).r, texelFetch(vertices, base+5).r));\n"
+	"	uint c = texelFetch(vertices, base+6).r;\n"
+	"	Color = vec4(uvec4(c, c >> 8, c >> 16, c >> 24) & 0xffu) / 255.0;\n"
+	"	vec4 instance = texelFetch(instances, gl_InstanceID);\n"
+	"	if (idle != vec4(0.0)) {\n"
+	"		float angle = idle.x * time + instance.w;\n"
+	"		mat2 spin = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));\n"
+	"		float wave = sin(idle.w * time + instance.w);\n"
+	"		Position *= 1.0 + idle.z * wave;\n"
+	"		Position.xy = spin * Position.xy;\n"
+	"		Position.z += idle.y * (0.5 + 0.5 * wave);\n"
+	"		Normal.xy = spin * Normal.xy;\n"
+	"	}\n"
+	"	Position += instance.xyz;\n"
+	"}\n";
+
+//GLSL shared by every program that shades lit surfaces: sun/sky (well, directional+hemispherical) lighting,
+// with the sun shadowed by both layers of the shadow map (layer 0: static casters, layer 1: dynamic casters):
+static char const *LightingGLSL =
+	"uniform vec3 sun_direction;\n"
+	"uniform vec3 sun_color;\n"
+	"uniform vec3 sky_direction;\n"
+	"uniform vec3 sky_color;\n"
+	"uniform sampler2DArrayShadow shadow_map;\n"
+	"vec3 lighting(vec3 n, vec3 shadow_coord) {\n"
+	"	vec3 total_light = vec3(0.0, 0.0, 0.0);\n"
+	"	{ //sky (hemisphere) light:\n"
+	"		vec3 l = sky_direction;\n"
+	"		float nl = 0.5 + 0.5 * dot(n,l);\n"
+	"		total_light += nl * sky_color;\n"
+	"	}\n"
+	"	{ //sun (directional) light:\n"
+	"		vec3 l = sun_direction;\n"
+	"		float nl = max(0.0, dot(n,l));\n"
+	"		float depth = shadow_coord.z - 0.002;\n"
+	"		float lit = min(\n"
+	"			texture(shadow_map, vec4(shadow_coord.xy, 0.0, depth)),\n"
+	"			texture(shadow_map, vec4(shadow_coord.xy, 1.0, depth))\n"
+	"		);\n"
+	"		total_light += nl * lit * sun_color;\n"
+	"	}\n"
+	"	return total_light;\n"
+	"}\n";
+
+//helper that fills in a move (see Replay.hpp):
+static Replay::Move make_move(Replay::Move::Kind kind, uint8_t arg = 0, int32_t value = 0) {
+	Replay::Move move;
+	move.kind = kind;
+	move.arg = arg;
+	move.value = value;
+	return move;
+}
 
-Game::Game() {
+Game::Game(Options const &options) {
 	{ //create an opengl program to perform sun/sky (well, directional+hemispherical) lighting:
 		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
-			"#version 330\n"
+			std::string("#version 330\n")
+			+ PullVertexGLSL +
 			"uniform mat4 object_to_clip;\n"
 			"uniform mat4x3 object_to_light;\n"
 			"uniform mat3 normal_to_light;\n"
-			"layout(location=0) in vec4 Position;\n" //note: layout keyword used to make sure that the location-0 attribute is always bound to something
-			"in vec3 Normal;\n"
-			"in vec4 Color;\n"
+			"uniform mat4 light_to_shadow;\n"
 			"out vec3 position;\n"
 			"out vec3 normal;\n"
 			"out vec4 color;\n"
+			"out vec3 shadow_coord;\n"
 			"void main() {\n"
-			"	gl_Position = object_to_clip * Position;\n"
-			"	position = object_to_light * Position;\n"
+			"	vec3 Position, Normal;\n"
+			"	vec4 Color;\n"
+			"	pull_vertex(Position, Normal, Color);\n"
+			"	vec4 p = vec4(Position, 1.0);\n"
+			"	gl_Position = object_to_clip * p;\n"
+			"	position = object_to_light * p;\n"
 			"	normal = normal_to_light * Normal;\n"
 			"	color = Color;\n"
+			"	shadow_coord = (light_to_shadow * vec4(position, 1.0)).xyz;\n"
 			"}\n"
 		);
 
 		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
-			"#version 330\n"
-			"uniform vec3 sun_direction;\n"
-			"uniform vec3 sun_color;\n"
-			"uniform vec3 sky_direction;\n"
-			"uniform vec3 sky_color;\n"
+			std::string("#version 330\n")
+			+ LightingGLSL +
 			"in vec3 position;\n"
 			"in vec3 normal;\n"
 			"in vec4 color;\n"
+			"in vec3 shadow_coord;\n"
 			"out vec4 fragColor;\n"
 			"void main() {\n"
-			"	vec3 total_light = vec3(0.0, 0.0, 0.0);\n"
-			"	vec3 n = normalize(normal);\n"
-			"	{ //sky (hemisphere) light:\n"
-			"		vec3 l = sky_direction;\n"
-			"		float nl = 0.5 + 0.5 * dot(n,l);\n"
-			"		total_light += nl * sky_color;\n"
-			"	}\n"
-			"	{ //sun (directional) light:\n"
-			"		vec3 l = sun_direction;\n"
-			"		float nl = max(0.0, dot(n,l));\n"
-			"		total_light += nl * sun_color;\n"
-			"	}\n"
-			"	fragColor = vec4(color.rgb * total_light, color.a);\n"
+			"	fragColor = vec4(color.rgb * lighting(normalize(normal), shadow_coord), color.a);\n"
 			"}\n"
 		);
 
-		simple_shading.program = glCreateProgram();
-		glAttachShader(simple_shading.program, vertex_shader);
-		glAttachShader(simple_shading.program, fragment_shader);
-		//shaders are reference counted so this makes sure they are freed after program is deleted:
-		glDeleteShader(vertex_shader);
-		glDeleteShader(fragment_shader);
-
-		//link the shader program and throw errors if linking fails:
-		glLinkProgram(simple_shading.program);
-		GLint link_status = GL_FALSE;
-		glGetProgramiv(simple_shading.program, GL_LINK_STATUS, &link_status);
-		if (link_status != GL_TRUE) {
-			std::cerr << "Failed to link shader program." << std::endl;
-			GLint info_log_length = 0;
-			glGetProgramiv(simple_shading.program, GL_INFO_LOG_LENGTH, &info_log_length);
-			std::vector< GLchar > info_log(info_log_length, 0);
-			GLsizei length = 0;
-			glGetProgramInfoLog(simple_shading.program, GLsizei(info_log.size()), &length, &info_log[0]);
-			std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-			throw std::runtime_error("failed to link program");
-		}
+		simple_shading.program = link_program(vertex_shader, fragment_shader);
+	}
+
+	{ //depth-only program used to render shadow casters:
+		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
+			std::string("#version 330\n")
+			+ PullVertexGLSL +
+			"uniform mat4 object_to_clip;\n"
+			"void main() {\n"
+			"	vec3 Position, Normal;\n"
+			"	vec4 Color;\n"
+			"	pull_vertex(Position, Normal, Color);\n"
+			"	gl_Position = object_to_clip * vec4(Position, 1.0);\n"
+			"}\n"
+		);
+
+		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
+			"#version 330\n"
+			"void main() {\n"
+			"}\n"
+		);
+
+		shadow.program = link_program(vertex_shader, fragment_shader);
+		shadow.object_to_clip_mat4 = glGetUniformLocation(shadow.program, "object_to_clip");
+		shadow.time_float = glGetUniformLocation(shadow.program, "time");
+		shadow.idle_vec4 = glGetUniformLocation(shadow.program, "idle");
+
+		glUseProgram(shadow.program);
+		glUniform1i(glGetUniformLocation(shadow.program, "vertices"), simple_shading.VerticesUnit);
+		glUniform1i(glGetUniformLocation(shadow.program, "instances"), simple_shading.InstancesUnit);
+		glUseProgram(0);
 	}
 
 	{ //read back uniform and attribute locations from the shader program:
@@ -98,10 +173,16 @@ Game::Game() {
 		simple_shading.sun_color_vec3 = glGetUniformLocation(simple_shading.program, "sun_color");
 		simple_shading.sky_direction_vec3 = glGetUniformLocation(simple_shading.program, "sky_direction");
 		simple_shading.sky_color_vec3 = glGetUniformLocation(simple_shading.program, "sky_color");
-
-		simple_shading.Position_vec4 = glGetAttribLocation(simple_shading.program, "Position");
-		simple_shading.Normal_vec3 = glGetAttribLocation(simple_shading.program, "Normal");
-		simple_shading.Color_vec4 = glGetAttribLocation(simple_shading.program, "Color");
+		simple_shading.light_to_shadow_mat4 = glGetUniformLocation(simple_shading.program, "light_to_shadow");
+		simple_shading.time_float = glGetUniformLocation(simple_shading.program, "time");
+		simple_shading.idle_vec4 = glGetUniformLocation(simple_shading.program, "idle");
+
+		//buffer textures are always read from the same texture units:
+		glUseProgram(simple_shading.program);
+		glUniform1i(glGetUniformLocation(simple_shading.program, "vertices"), simple_shading.VerticesUnit);
+		glUniform1i(glGetUniformLocation(simple_shading.program, "instances"), simple_shading.InstancesUnit);
+		glUniform1i(glGetUniformLocation(simple_shading.program, "shadow_map"), simple_shading.ShadowUnit);
+		glUseProgram(0);
 	}
 
 	struct Vertex {
@@ -113,11 +194,14 @@ Game::Game() {
 
 	{ //load mesh data from a binary blob:
 		std::cout<<" before loading mesh data "<<std::endl;
-		std::ifstream blob(data_path("meshes.blob"), std::ios::binary);
-		//The blob will be made up of three chunks:
+		constexpr AssetPath MeshesBlob("meshes.blob");
+		SpanStream blob(AssetPack::data().get(MeshesBlob));
+		//The blob will be made up of four chunks:
 		// the first chunk will be vertex data (interleaved position/normal/color)
 		// the second chunk will be characters
 		// the third chunk will be an index, mapping a name (range of characters) to a mesh (range of vertex data)
+		//  (the exporter stores identical meshes once, so several names may map to the same range)
+		// the fourth chunk will be bounds (box + sphere) for each index entry
 
 		//read vertex data:
 		std::vector< Vertex > vertices;
@@ -147,6 +231,21 @@ Game::Game() {
 		std::vector< IndexEntry > index_entries;
 		read_chunk(blob, "idx0", &index_entries);
 
+		//read bounds (one entry per index entry):
+		struct BoundsEntry {
+			glm::vec3 box_min;
+			glm::vec3 box_max;
+			glm::vec3 sphere_center;
+			float sphere_radius;
+		};
+		static_assert(sizeof(BoundsEntry) == 40, "BoundsEntry should be packed.");
+
+		std::vector< BoundsEntry > bounds_entries;
+		read_chunk(blob, "bnd0", &bounds_entries);
+		if (bounds_entries.size() != index_entries.size()) {
+			throw std::runtime_error("bounds don't match index.");
+		}
+
 		if (blob.peek() != EOF) {
 			std::cerr << "WARNING: trailing data in meshes file." << std::endl;
 		}
@@ -161,7 +260,8 @@ Game::Game() {
 
 		//create map to store index entries:
 		std::map< std::string, Mesh > index;
-		for (IndexEntry const &e : index_entries) {
+		for (uint32_t i = 0; i < index_entries.size(); ++i) {
+			IndexEntry const &e = index_entries[i];
 			if (e.name_begin > e.name_end || e.name_end > names.size()) {
 				throw std::runtime_error("invalid name indices in index.");
 			}
@@ -171,6 +271,10 @@ Game::Game() {
 			Mesh mesh;
 			mesh.first = e.vertex_begin;
 			mesh.count = e.vertex_end - e.vertex_begin;
+			mesh.box_min = bounds_entries[i].box_min;
+			mesh.box_max = bounds_entries[i].box_max;
+			mesh.sphere_center = bounds_entries[i].sphere_center;
+			mesh.sphere_radius = bounds_entries[i].sphere_radius;
 			auto ret = index.insert(std::make_pair(
 				std::string(names.begin() + e.name_begin, names.begin() + e.name_end),
 				mesh));
@@ -198,6 +302,10 @@ Game::Game() {
 		starpoint_mesh=lookup("Starpoint");
 		wall_mesh=lookup("Wall");
 
+		//the floor is drawn by its own program (see floor_shading), which only needs its color and height:
+		if (floor_mesh.count == 0) throw std::runtime_error("Floor mesh is empty.");
+		floor_color = glm::vec4(vertices[floor_mesh.first].Color) / 255.0f;
+
 		std::cout<<"look up into index map to extract meshes:"<<std::endl;
 
 		// hemisphere_mesh=lookup("Hemisphere");
@@ -207,103 +315,335 @@ Game::Game() {
 		// cube_mesh = lookup("Cube");
 	}
 
-	{ //create vertex array object to hold the map from the mesh vertex buffer to shader program attributes:
-		glGenVertexArrays(1, &meshes_for_simple_shading_vao);
-		glBindVertexArray(meshes_for_simple_shading_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, meshes_vbo);
-		//note that I'm specifying a 3-vector for a 4-vector attribute here, and this is okay to do:
-		glVertexAttribPointer(simple_shading.Position_vec4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Position));
+	//helper that makes a buffer texture to read 'vbo' through (see the vertex shader):
+	auto make_buffer_texture = [](GLuint vbo, GLenum format) -> GLuint {
+		GLuint tex = 0;
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_BUFFER, tex);
+		glTexBuffer(GL_TEXTURE_BUFFER, format, vbo);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		return tex;
+	};
 
-		// It is necessary to specify this
-		glEnableVertexAttribArray(simple_shading.Position_vec4);
-		if (simple_shading.Normal_vec3 != -1U) {
-			glVertexAttribPointer(simple_shading.Normal_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Normal));
-			glEnableVertexAttribArray(simple_shading.Normal_vec3);
-		}
-		if (simple_shading.Color_vec4 != -1U) {
-			glVertexAttribPointer(simple_shading.Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Color));
-			glEnableVertexAttribArray(simple_shading.Color_vec4);
-		}
+	{ //mesh vertices are fetched by gl_VertexID, seven 32-bit words at a time:
+		static_assert(sizeof(Vertex) == 7 * 4, "vertex shader expects seven words per vertex.");
+		meshes_tex = make_buffer_texture(meshes_vbo, GL_R32UI);
+	}
+
+	{ //a single zero offset for non-instanced draws:
+		glm::vec4 zero(0.0f);
+		glGenBuffers(1, &zero_instance_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, zero_instance_vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(zero), &zero, GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		zero_instance_tex = make_buffer_texture(zero_instance_vbo, GL_RGBA32F);
 	}
 
-	GL_ERRORS();
+	{ //instance lists are split into pages small enough for a buffer texture (see InstancePages):
+		GLint max_texels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+		instance_page_size = uint32_t(std::max(max_texels, 1024));
+	}
 
-	//---------------- GAME SETUP-------------
-	//set up game board with meshes and rolls:
-	//board meshes is a vector of type Mesh
-	//matrix.reserve(board_size.x * board_size.y);
-	//board_meshes.get_allocator().allocate(board_size.x * board_size.y);
-	board_meshes.reserve(board_size.x * board_size.y);
-	board_rotations.reserve(board_size.x * board_size.y);
+	{ //entity groups (each gets its own instance pages, created on first upload):
+		entity_groups[GroupPlayer].mesh = &player_mesh;
+		entity_groups[GroupPlayer].shadow = true;
+		entity_groups[GroupPickup].mesh = &starpoint_mesh;
+		entity_groups[GroupPickup].idle.spin = 12.0f;
+		entity_groups[GroupPickup].shadow = true;
+		entity_groups[GroupStarIcon].mesh = &starpoint_mesh;
+		entity_groups[GroupHoleIcon].mesh = &hole_mesh;
+		entity_groups[GroupGoalIcon].mesh = &goal_mesh;
+		entity_instances.resize(GroupCount);
+	}
 
-	// What is this? Random number generator
-	//std::mt19937 mt(0xbead1234);
+	//(tile instance pages, one list per (non-floor) tile type, are allocated by upload_tile_instances and patched as the board changes)
 
-	int rand_idx;
-	// Vector of meshes (Of objects which are going to be place inside the grid)
-	std::vector< Mesh const * > meshes{&wall_mesh,&starpoint_mesh,&floor_mesh,&riflector_mesh,&hole_mesh};
+	{ //program that draws the floor under the whole board as one quad, shading each cell by looking up its tile type:
+		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
+			"#version 330\n"
+			"uniform mat4 world_to_clip;\n"
+			"uniform mat4 light_to_shadow;\n"
+			"uniform vec3 board_size;\n" //(width, height, floor z)
+			"out vec2 board_position;\n"
+			"out vec3 shadow_coord;\n"
+			"void main() {\n"
+			"	vec3 p = vec3(vec2(gl_VertexID & 1, gl_VertexID >> 1) * board_size.xy, board_size.z);\n"
+			"	gl_Position = world_to_clip * vec4(p, 1.0);\n"
+			"	board_position = p.xy;\n"
+			"	shadow_coord = (light_to_shadow * vec4(p, 1.0)).xyz;\n"
+			"}\n"
+		);
 
-	for (uint32_t i = 0; i < board_size.x * board_size.y; ++i) // ??
-	{
-		if(i==0)
-		{
-			// Initialize the player at the top left corner of the board
-			board_meshes.emplace_back(&floor_mesh);
+		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
+			std::string("#version 330\n")
+			+ LightingGLSL +
+			"uniform usampler2D tiles;\n"
+			"uniform vec4 floor_color;\n"
+			"uniform vec4 tile_tints[" + std::to_string(int(TileCount)) + "];\n"
+			"in vec2 board_position;\n"
+			"in vec3 shadow_coord;\n"
+			"out vec4 fragColor;\n"
+			"void main() {\n"
+			"	ivec2 cell = clamp(ivec2(floor(board_position)), ivec2(0), textureSize(tiles, 0) - 1);\n"
+			"	uint tile = texelFetch(tiles, cell, 0).r;\n"
+			"	vec4 color = floor_color * tile_tints[tile];\n"
+			"	fragColor = vec4(color.rgb * lighting(vec3(0.0, 0.0, 1.0), shadow_coord), color.a);\n"
+			"}\n"
+		);
 
+		floor_shading.program = link_program(vertex_shader, fragment_shader);
+
+		floor_shading.world_to_clip_mat4 = glGetUniformLocation(floor_shading.program, "world_to_clip");
+		floor_shading.light_to_shadow_mat4 = glGetUniformLocation(floor_shading.program, "light_to_shadow");
+		floor_shading.sun_direction_vec3 = glGetUniformLocation(floor_shading.program, "sun_direction");
+		floor_shading.sun_color_vec3 = glGetUniformLocation(floor_shading.program, "sun_color");
+		floor_shading.sky_direction_vec3 = glGetUniformLocation(floor_shading.program, "sky_direction");
+		floor_shading.sky_color_vec3 = glGetUniformLocation(floor_shading.program, "sky_color");
+		floor_shading.board_size_vec3 = glGetUniformLocation(floor_shading.program, "board_size");
+
+		//flat "decals" under some tiles (most tiles leave the floor as it is; their meshes are drawn on top):
+		glm::vec4 tints[TileCount];
+		for (auto &tint : tints) tint = glm::vec4(1.0f);
+		tints[TileGoal] = glm::vec4(1.0f, 0.75f, 0.7f, 1.0f); //the goal's cell glows a little
+		tints[TileHole] = glm::vec4(0.55f, 0.55f, 0.5f, 1.0f); //holes are sunk into a darker patch
+
+		glUseProgram(floor_shading.program);
+		glUniform1i(glGetUniformLocation(floor_shading.program, "tiles"), floor_shading.TilesUnit);
+		glUniform1i(glGetUniformLocation(floor_shading.program, "shadow_map"), simple_shading.ShadowUnit);
+		glUniform4fv(glGetUniformLocation(floor_shading.program, "floor_color"), 1, glm::value_ptr(floor_color));
+		glUniform4fv(glGetUniformLocation(floor_shading.program, "tile_tints"), TileCount, glm::value_ptr(tints[0]));
+		glUseProgram(0);
+	}
+
+	//vertex pulling means there are no attributes to set up, but core profile still requires a vertex array object:
+	glGenVertexArrays(1, &empty_vao);
+
+	GL_ERRORS();
+
+	//---------------- GAME SETUP-------------
+	level_pack = options.level_pack;
+	level_index = options.level;
+	render_scale = glm::clamp(options.render_scale, 0.1f, 1.0f);
+	if (!options.replay.empty()) {
+		//view a recorded session (its first keyframe is restored once agents are set up, below):
+		replay.load(options.replay);
+		board_size = glm::uvec2(replay.width, replay.height);
+		board.reset(replay.keyframes[0].tiles);
+		cursor = glm::uvec2(replay.keyframes[0].cursor_x, replay.keyframes[0].cursor_y);
+		playback.active = true;
+	} else if (!level_pack.empty()) {
+		//load a level made with the editor:
+		LevelPack pack;
+		pack.load(level_pack);
+		if (level_index >= pack.levels.size()) {
+			throw std::runtime_error("Level pack '" + level_pack + "' doesn't have a level " + std::to_string(level_index) + ".");
 		}
-		else if(i==39)
-		{
-			board_meshes.emplace_back(&goal_mesh);
+		LevelPack::Level const &level = pack.levels[level_index];
+		board_size = glm::uvec2(level.width, level.height);
+		board.reset(level.width, level.height, level.tiles);
+		cursor = glm::uvec2(level.start_x, level.start_y);
+	} else {
+		//generate the board layout (see generate_board.hpp for the rules):
+		board_size = options.board_size;
+		BoardParams params;
+		params.width = board_size.x;
+		params.height = board_size.y;
+		params.seed = options.seed;
+		params.level = options.level;
+		params.start_x = 0; // Initialize the player at the bottom left corner of the board
+		params.start_y = 0;
+		params.goal_x = board_size.x - 1;
+		params.goal_y = board_size.y / 2;
+		params.min_stars = total_points;
+		board.reset(board_size.x, board_size.y, generate_board(params));
+		cursor = glm::uvec2(params.start_x, params.start_y);
+	}
+	start = cursor;
+	camera.center = 0.5f * glm::vec2(board_size);
+
+	//winning takes total_points stars, so don't ask for more than can be reached:
+	// (generate_board can run out of room for stars, and hand-made levels may have fewer)
+	{
+		uint32_t reachable = 0;
+		for (uint32_t cell : board.instances[TileStar]) {
+			if (board.goal == -1U || board.distance_to_goal(cell % board.width, cell / board.width) != Board::Unreachable) ++reachable;
 		}
-		else if(i==42)
-		{
-			board_meshes.emplace_back(&gummy_mesh);
+		if (uint32_t(total_points) > reachable) {
+			std::cout << "Only " << reachable << " stars are reachable, so winning takes " << reachable << " rather than " << total_points << "." << std::endl;
+			total_points = int(reachable);
 		}
+	}
 
-		else
-		{
-			//rand_idx=mt()%meshes.size();
-			rand_idx=rand()%meshes.size();
-			std::cout<<"randIdx"<<rand_idx<<std::endl;
-			board_meshes.emplace_back(meshes[rand_idx]);
-			// board_rotations.emplace_back(glm::quat());
-
-			 if(rand_idx==0) // It is a wall
-			 {
-			 	wall_indices.push_back(i);  // pushing the index at which the wall is place to the wall indices vector
-
-			 }
-			 if(rand_idx==1) // It is a starpoint
-			 { 
-			 	//starpos=i;
-			 	star_indices.push_back(i);
-			 	//std::cout<<"starpos"<<starpos<<std::endl;
-
-			 }
-			 if(rand_idx==4) // It is a hole
-			 { 
-			 	//starpos=i;
-			 	hole_indices.push_back(i);
-
-			 }
-			 if(rand_idx==3) // It is a riflector
-			 { 
-			 	//starpos=i;
-			 	riflector_indices.push_back(i);
-
-			 }
-			 
+	player = entities.create(Entities::Position | Entities::Render);
+	entities.group(player) = GroupPlayer;
+
+	//ghosts to race (drawn as hovering players), and this session's run:
+	ghost_idle.bob = 0.15f;
+	ghost_idle.rate = 4.0f;
+	if (!options.ghosts.empty() && !playback.active) {
+		GhostJournal journal;
+		journal.load(options.ghosts);
+		ghosts.reset(journal);
+		std::cout << "Ghosts: racing " << ghosts.size() << " runs from '" << options.ghosts << "'." << std::endl;
+	}
+	ghost_record_path = (playback.active ? "" : options.record_ghost);
+	ghost_run.start_x = int32_t(cursor.x);
+	ghost_run.start_y = int32_t(cursor.y);
+	ghost_run_at = cursor;
+
+	{ //shadow map, as seen from the sun (sized and fitted to the view by fit_shadow):
+		sun_direction = glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f));
+
+		glGenTextures(1, &shadow.texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, shadow.texture);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		//anything outside the map (e.g., HUD icons) is lit:
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		GLfloat border[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		//(the shadow passes' framebuffers are made by the render graph)
+		shadow.static_dirty = true;
+	}
+
+	{ //tile types for the floor's fragment shader (see upload_board_tiles):
+		GLint max_size = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+		if (board_size.x > uint32_t(max_size) || board_size.y > uint32_t(max_size)) {
+			throw std::runtime_error("Board is larger than the biggest texture this GL supports (" + std::to_string(max_size) + " texels).");
 		}
-		
+		glGenTextures(1, &board_tiles_tex);
+		glBindTexture(GL_TEXTURE_2D, board_tiles_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, board_size.x, board_size.y, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		board.tiles_reset = true; //(filled in by the first upload_board_tiles)
+	}
+
+	GL_ERRORS();
+
+	//mesh to draw for each tile type:
+	tile_meshes[TileFloor] = &floor_mesh;
+	tile_meshes[TileWall] = &wall_mesh;
+	tile_meshes[TileStar] = &starpoint_mesh;
+	tile_meshes[TileRiflector] = &riflector_mesh;
+	tile_meshes[TileHole] = &hole_mesh;
+	tile_meshes[TileGoal] = &goal_mesh;
+	tile_meshes[TileGummy] = &gummy_mesh;
+
+	//idle animation for each tile type (evaluated in the vertex shader, so it costs nothing per tile on the CPU):
+	tile_idle[TileStar].spin = 1.5f;
+	tile_idle[TileGoal].pulse = 0.08f;
+	tile_idle[TileGoal].rate = 3.0f;
+	tile_idle[TileHole].bob = 0.06f;
+	tile_idle[TileHole].rate = 2.0f;
+	//(idle_time wraps every IdlePeriod seconds, which only loops seamlessly if every spin and rate is a multiple of IdleRateStep)
+	auto check_idle = [](TileIdle const &idle) {
+		assert(std::fmod(idle.spin, IdleRateStep) == 0.0f && std::fmod(idle.rate, IdleRateStep) == 0.0f);
+		(void)idle;
+	};
+	for (TileIdle const &idle : tile_idle) check_idle(idle);
+	for (auto const &group : entity_groups) check_idle(group.idle);
+	check_idle(ghost_idle);
+
+	//---------------- AGENTS -------------
+	//rival pieces wander the board, blocked by walls, the player, and each other:
+	agents.resize(board_size.x, board_size.y);
+	for (uint32_t i : board.instances[TileWall]) {
+		agents.set_blocked(i % board_size.x, i / board_size.x, true);
+	}
+	agents.set_blocked(start.x, start.y, true); //keep the player's start cell clear...
+	Philox random(options.seed, options.level, StreamAgents); //(two values per agent: cell, direction)
+	for (uint32_t n = 0; n < options.agent_count; ++n) {
+		uint32_t i = random[2 * n] % (board_size.x * board_size.y);
+		agents.add(i % board_size.x, i / board_size.x, uint8_t(random[2 * n + 1] % 4));
+	}
+	agents.set_blocked(start.x, start.y, false); //...but don't keep agents out of it afterward
+
+	//---------------- REPLAYS -------------
+	if (playback.active) {
+		restore(replay.keyframes[0]);
+		std::cout << "Replay: " << replay.moves.size() << " moves (space pauses, left/right step, up/down skip a tenth, home/end)." << std::endl;
+	} else if (!options.record.empty()) {
+		//the recording starts with the state as set up above:
+		record_path = options.record;
+		replay.width = board_size.x;
+		replay.height = board_size.y;
+		replay.interval = std::max(1u, options.keyframe_interval);
+		replay.keyframes.emplace_back(snapshot());
 	}
 
 }
 
 
 Game::~Game() {
-	glDeleteVertexArrays(1, &meshes_for_simple_shading_vao);
-	meshes_for_simple_shading_vao = -1U;
+	if (!record_path.empty()) {
+		try {
+			replay.save(record_path);
+			std::cout << "Replay: saved " << replay.moves.size() << " moves to '" << record_path << "'." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << "Replay: failed to save: " << e.what() << std::endl;
+		}
+	}
+
+	if (!ghost_record_path.empty() && ghost_run.step_count > 0) {
+		try {
+			GhostJournal journal;
+			{ //keep the runs already in the journal:
+				std::ifstream existing(ghost_record_path, std::ios::binary);
+				if (existing) {
+					existing.close();
+					journal.load(ghost_record_path);
+				}
+			}
+			journal.runs.emplace_back(ghost_run);
+			journal.save(ghost_record_path);
+			std::cout << "Ghosts: saved a run of " << ghost_run.step_count << " steps to '" << ghost_record_path << "' (" << journal.runs.size() << " runs)." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << "Ghosts: failed to save run: " << e.what() << std::endl;
+		}
+	}
+
+	glDeleteTextures(1, &board_tiles_tex);
+	board_tiles_tex = -1U;
+
+	glDeleteProgram(floor_shading.program);
+	floor_shading.program = -1U;
+
+	glDeleteTextures(1, &shadow.texture);
+	shadow.texture = -1U;
+
+	glDeleteProgram(shadow.program);
+	shadow.program = -1U;
+
+	glDeleteVertexArrays(1, &empty_vao);
+	empty_vao = -1U;
+
+	free_instances(&agents_instance_pages);
+	free_instances(&ghosts_instance_pages);
+	for (auto &group : entity_groups) {
+		free_instances(&group.instances);
+	}
+	for (auto &ti : tile_instances) {
+		free_instances(&ti);
+	}
+
+	glDeleteTextures(1, &zero_instance_tex);
+	zero_instance_tex = -1U;
+
+	glDeleteBuffers(1, &zero_instance_vbo);
+	zero_instance_vbo = -1U;
+
+	glDeleteTextures(1, &meshes_tex);
+	meshes_tex = -1U;
 
 	glDeleteBuffers(1, &meshes_vbo);
 	meshes_vbo = -1U;
@@ -319,7 +659,114 @@ bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
 	if (evt.type == SDL_KEYDOWN && evt.key.repeat) {
 		return false;
 	}
-	
+
+	// Mouse wheel zooms the camera (in any mode)
+	if (evt.type == SDL_MOUSEWHEEL)
+	{
+		float max_zoom = glm::max(1.0f, float(glm::max(board_size.x, board_size.y)) / 4.0f);
+		camera.zoom = glm::clamp(camera.zoom * std::pow(1.25f, float(evt.wheel.y)), 1.0f, max_zoom);
+		if (camera.zoom == 1.0f) camera.center = 0.5f * glm::vec2(board_size);
+		return true;
+	}
+
+	// When viewing a replay, keys control playback (and nothing else)
+	if (playback.active)
+	{
+		if (evt.type != SDL_KEYDOWN) return (evt.type == SDL_KEYUP);
+		uint64_t tenth = std::max< uint64_t >(1, replay.moves.size() / 10);
+		switch (evt.key.keysym.scancode) {
+			case SDL_SCANCODE_SPACE:
+				playback.paused = !playback.paused;
+				playback.timer = 0.0f;
+				break;
+			case SDL_SCANCODE_LEFT:
+				playback.paused = true;
+				if (playback.position > 0) seek(playback.position - 1);
+				break;
+			case SDL_SCANCODE_RIGHT:
+				playback.paused = true;
+				seek(playback.position + 1);
+				break;
+			case SDL_SCANCODE_DOWN:
+				seek(playback.position - std::min(playback.position, tenth));
+				break;
+			case SDL_SCANCODE_UP:
+				seek(playback.position + tenth);
+				break;
+			case SDL_SCANCODE_HOME:
+				seek(0);
+				break;
+			case SDL_SCANCODE_END:
+				seek(replay.moves.size());
+				break;
+			default:
+				break;
+		}
+		return true;
+	}
+
+	// Tab toggles the level editor
+	if (evt.type == SDL_KEYDOWN && evt.key.keysym.scancode == SDL_SCANCODE_TAB)
+	{
+		editor.active = !editor.active;
+		editor.painting = false;
+		editor.panning = false;
+		std::cout << (editor.active ? "Editor: on (1-7 pick tile, left click paints, right drag pans, F2 saves)" : "Editor: off") << std::endl;
+		return true;
+	}
+
+	if (editor.active)
+	{
+		if (evt.type == SDL_KEYDOWN)
+		{
+			// 1-7 pick the tile type to paint (same order as the Tile enum)
+			if (evt.key.keysym.scancode >= SDL_SCANCODE_1 && evt.key.keysym.scancode < SDL_SCANCODE_1 + TileCount)
+			{
+				editor.brush = Tile(evt.key.keysym.scancode - SDL_SCANCODE_1);
+				return true;
+			}
+			if (evt.key.keysym.scancode == SDL_SCANCODE_F2)
+			{
+				save_level();
+				return true;
+			}
+		}
+		if (evt.type == SDL_MOUSEMOTION)
+		{
+			if (editor.panning)
+			{
+				float aspect = float(window_size.x) / float(window_size.y);
+				float world_per_pixel = 2.0f / (camera_scale(aspect) * float(window_size.y));
+				camera.center += world_per_pixel * glm::vec2(-float(evt.motion.xrel), float(evt.motion.yrel));
+			}
+			glm::uvec2 cell;
+			editor.hover_valid = window_to_cell(glm::ivec2(evt.motion.x, evt.motion.y), window_size, &cell);
+			if (editor.hover_valid)
+			{
+				editor.hover = cell;
+				if (editor.painting) play(make_move(Replay::Move::Paint, editor.brush, int32_t(cell.y * board_size.x + cell.x)));
+			}
+			return true;
+		}
+		if (evt.type == SDL_MOUSEBUTTONDOWN || evt.type == SDL_MOUSEBUTTONUP)
+		{
+			bool down = (evt.type == SDL_MOUSEBUTTONDOWN);
+			if (evt.button.button == SDL_BUTTON_LEFT)
+			{
+				editor.painting = down;
+				glm::uvec2 cell;
+				if (down && window_to_cell(glm::ivec2(evt.button.x, evt.button.y), window_size, &cell))
+				{
+					play(make_move(Replay::Move::Paint, editor.brush, int32_t(cell.y * board_size.x + cell.x)));
+				}
+			}
+			else if (evt.button.button == SDL_BUTTON_RIGHT)
+			{
+				editor.panning = down;
+			}
+			return true;
+		}
+	}
 
 	// If Reset Button 'R' is pressed
 	if (evt.type == SDL_KEYDOWN || evt.type == SDL_KEYUP) 
@@ -330,6 +777,23 @@ bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
 		}
 	}
 
+	//shift + L/R/U/D rolls the player's row or column:
+	if (evt.type == SDL_KEYDOWN && (evt.key.keysym.mod & KMOD_SHIFT)) {
+		if (evt.key.keysym.scancode == SDL_SCANCODE_LEFT) {
+			controls.roll_row -= 1;
+			return true;
+		} else if (evt.key.keysym.scancode == SDL_SCANCODE_RIGHT) {
+			controls.roll_row += 1;
+			return true;
+		} else if (evt.key.keysym.scancode == SDL_SCANCODE_UP) {
+			controls.roll_column += 1;
+			return true;
+		} else if (evt.key.keysym.scancode == SDL_SCANCODE_DOWN) {
+			controls.roll_column -= 1;
+			return true;
+		}
+	}
+
 	//move player on L/R/U/D press:
 	if (evt.type == SDL_KEYDOWN ) {
 	//if (evt.type == SDL_KEYDOWN && evt.key.repeat == 0) {
@@ -355,32 +819,39 @@ bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
 }
 
 
-bool Game::check_collision(int x, int y, int board_width,int board_height,std::vector<int>&wall_indices)
+bool Game::check_collision(int x, int y)
 {
 	//std::cout<<"check collision"<<std::endl;
-	int key;
-	// Convert cursor x, y to 1 D using column major
-	key=y*board_width+x;
-	if(std::find(wall_indices.begin(),wall_indices.end(),key)!=wall_indices.end())
+	// Walls are looked up in the board's sparse 64x64 tile chunks (two popcount ranks; see SparseTiles.hpp)
+	if(board.is(TileWall,x,y))
 	{
 		std::cout<<"collision detected--->"<<std::endl;
 		return true;
 	}
+	// Rival agents block the player just like walls
+	if(uint32_t(x)<board_size.x && uint32_t(y)<board_size.y && agents.occupied(x,y))
+	{
+		return true;
+	}
 		
 	return false;
 }
 
-bool Game::check_objects_hit(int x,int y,int board_width,int board_height,std::vector<int>&star_indices)
+void Game::deflect(int dx, int dy)
 {
-	//std::cout<<"update starpoints"<<std::endl;
-	int key;
-	// Convert cursor x, y to 1 D using column major
-	key=y*board_width+x;
+	//(like an ordinary step: stay put rather than leave the board or walk into a wall or an agent)
+	uint32_t x = cursor.x + dx, y = cursor.y + dy;
+	if(x>=board_size.x || y>=board_size.y) return;
+	if(check_collision(x,y)) return;
+	cursor = glm::uvec2(x, y);
+}
 
-	//std::cout<<"key"<<key;
-	if(std::find(star_indices.begin(),star_indices.end(),key)!=star_indices.end())
+bool Game::check_objects_hit(int x,int y,Tile type)
+{
+	//std::cout<<"update starpoints"<<std::endl;
+	if(board.is(type,x,y))
 	{
-		std::cout<<"Starpoint collected-->";
+		if(type==TileStar) std::cout<<"Starpoint collected-->";
 		return true;
 		
 	}
@@ -391,38 +862,147 @@ bool Game::check_objects_hit(int x,int y,int board_width,int board_height,std::v
 
 
 void Game::update(float elapsed) {
-	//if the roll keys are pressed, rotate everything on the same row or column as the cursor:
+	int stars_before = star_points;
+
+	if (playback.active) {
+		//viewing a replay: moves come from the replay (at a fixed rate, unless paused) instead of the controls:
+		if (!playback.paused) {
+			playback.timer += elapsed;
+			while (playback.timer >= playback.move_interval) {
+				playback.timer -= playback.move_interval;
+				if (playback.position >= replay.moves.size()) {
+					std::cout << "Replay: end (move " << playback.position << ")." << std::endl;
+					playback.paused = true;
+					playback.timer = 0.0f;
+					break;
+				}
+				apply(replay.moves[playback.position]);
+				++playback.position;
+			}
+		}
+	} else {
+		//if the roll keys are pressed, rotate everything on the same row or column as the cursor:
+		if (controls.roll_row != 0) {
+			play(make_move(Replay::Move::Roll, 0, controls.roll_row));
+			controls.roll_row = 0;
+		}
+		if (controls.roll_column != 0) {
+			play(make_move(Replay::Move::Roll, 1, controls.roll_column));
+			controls.roll_column = 0;
+		}
+
+		if (controls.slide_up) {
+			play(make_move(Replay::Move::Slide, Agents::PosY));
+			controls.slide_up=false;
+		}
+		if (controls.slide_down) {
+			play(make_move(Replay::Move::Slide, Agents::NegY));
+			controls.slide_down=false;
+		}
+		if (controls.slide_left) {
+			play(make_move(Replay::Move::Slide, Agents::NegX));
+			controls.slide_left=false;
+		}
+		if (controls.slide_right) {
+			play(make_move(Replay::Move::Slide, Agents::PosX));
+			controls.slide_right=false;
+		}
+
+		// Step the rival agents at a fixed rate
+		agent_step_timer += elapsed;
+		while (agent_step_timer >= agent_step_interval)
+		{
+			agent_step_timer -= agent_step_interval;
+			play(make_move(Replay::Move::AgentStep));
+		}
+
+		//race clock: ghosts take the steps that have come due, and any move the player made goes in this session's run:
+		ghosts.advance(ghosts.time + elapsed);
+		if (!ghost_record_path.empty() && cursor != ghost_run_at) {
+			GhostJournal::Step step;
+			step.ticks = ghosts.tick - ghost_run_tick;
+			step.dx = int32_t(cursor.x) - int32_t(ghost_run_at.x);
+			step.dy = int32_t(cursor.y) - int32_t(ghost_run_at.y);
+			ghost_run.step(step);
+			ghost_run_at = cursor;
+			ghost_run_tick = ghosts.tick;
+		}
+	}
+
+	//collecting a star sends a pickup spinning up out of its cell:
+	if (star_points > stars_before) {
+		Entities::Handle pickup = entities.create(Entities::Position | Entities::Velocity | Entities::Lifetime | Entities::Render);
+		entities.position(pickup) = glm::vec3(cursor.x + 0.5f, cursor.y + 0.5f, 0.0f);
+		entities.velocity(pickup) = glm::vec3(0.0f, 0.0f, 3.0f);
+		entities.lifetime(pickup) = 0.5f;
+		entities.group(pickup) = GroupPickup;
+	}
+	entities.integrate(elapsed);
+	entities.age(elapsed);
 
-	if (controls.slide_up) 
+	// When zoomed in (and not editing), the camera follows the player
+	if (!editor.active && camera.zoom > 1.0f)
 	{
+		camera.center = glm::vec2(cursor) + glm::vec2(0.5f);
+	}
+
+	//(wrapped, since a float that only grows loses the precision the animation needs after a few hours)
+	idle_time = std::fmod(idle_time + elapsed, IdlePeriod);
+
+	// Function for Reset
+	if (controls.reset){
+		std::cout<<"Reset function"<<std::endl;
+		//Game::reset();
+	}
+
+
+	goal_key=cursor.y*board_size.x+cursor.x;
+
+
+	std::cout<<" total points"<<star_points<<std::endl;
+	std::cout<<"--------------"<<std::endl;
+	std::cout<<" hole points"<<hole_points<<std::endl;
+
+
+}
+
+void Game::apply(Replay::Move const &move) {
+	if (move.kind == Replay::Move::Roll) {
+		roll(move.arg != 0, move.value);
+	} else if (move.kind == Replay::Move::AgentStep) {
+		agents.step(cursor.x, cursor.y);
+	} else if (move.kind == Replay::Move::Paint) {
+		uint32_t cell = uint32_t(move.value);
+		paint(glm::uvec2(cell % board_size.x, cell / board_size.x), Tile(move.arg));
+	} else if (move.kind == Replay::Move::Slide && move.arg == Agents::PosY) {
 		//std::cout<<"UP"<<std::endl;
 		if (cursor.y + 1 < board_size.y) 
 			{
 				//Collision Detection
-				if((Game::check_collision(cursor.x,cursor.y+1,board_size.x,board_size.y,wall_indices)))
+				if((Game::check_collision(cursor.x,cursor.y+1)))
 				{
 					cursor.y=cursor.y;
 				}
 				// Starpoint detection
-				else if((Game::check_objects_hit(cursor.x,cursor.y+1,board_size.x,board_size.y,star_indices))) 
+				else if((Game::check_objects_hit(cursor.x,cursor.y+1,TileStar))) 
 				{
 					cursor.y += 1;
 					star_points+=1;
 					star_flag=true;
+					board.set(cursor.x, cursor.y, TileFloor); //(collected)
 
 				}
-				else if((Game::check_objects_hit(cursor.x,cursor.y-1,board_size.x,board_size.y,hole_indices))) 
+				else if((Game::check_objects_hit(cursor.x,cursor.y+1,TileHole))) 
 				{
-					cursor.y -= 1;
+					cursor.y += 1;
 					star_points-=1;
 					hole_points+=1;
 					hole_flag=true;
+					board.set(cursor.x, cursor.y, TileFloor); //(filled)
 				}
-				else if((Game::check_objects_hit(cursor.x,cursor.y+1,board_size.x,board_size.y,riflector_indices))) 
+				else if((Game::check_objects_hit(cursor.x,cursor.y+1,TileRiflector))) 
 				{
-					cursor.y += 1;
-					cursor.x+=1;
-				
+					deflect(+1, +1);
 				}
 				else
 				{
@@ -430,75 +1010,67 @@ void Game::update(float elapsed) {
 				}
 
 			}
-		controls.slide_up=false;
-	}
-	if (controls.slide_down) 
-	{
+	} else if (move.kind == Replay::Move::Slide && move.arg == Agents::NegY) {
 		//std::cout<<"DOWN"<<std::endl;
 		if (cursor.y > 0) 
 			{
-				if((Game::check_collision(cursor.x,cursor.y-1,board_size.x,board_size.y,wall_indices)))
+				if((Game::check_collision(cursor.x,cursor.y-1)))
 				{
 					cursor.y=cursor.y;
 				}
-				else if((Game::check_objects_hit(cursor.x,cursor.y-1,board_size.x,board_size.y,star_indices))) 
+				else if((Game::check_objects_hit(cursor.x,cursor.y-1,TileStar))) 
 				{
 					cursor.y -= 1;
 					star_points+=1;
 					star_flag=true;
+					board.set(cursor.x, cursor.y, TileFloor); //(collected)
 
 				}
-				else if((Game::check_objects_hit(cursor.x,cursor.y-1,board_size.x,board_size.y,hole_indices))) 
+				else if((Game::check_objects_hit(cursor.x,cursor.y-1,TileHole))) 
 				{
 					cursor.y -= 1;
 					star_points-=1;
 					hole_points+=1;
 					hole_flag=true;
+					board.set(cursor.x, cursor.y, TileFloor); //(filled)
 				}
-				else if((Game::check_objects_hit(cursor.x,cursor.y-1,board_size.x,board_size.y,riflector_indices))) 
+				else if((Game::check_objects_hit(cursor.x,cursor.y-1,TileRiflector))) 
 				{
-					cursor.y -= 1;
-					cursor.x+=1;
-
-				
+					deflect(+1, -1);
 				}
 				else
 				{
 					cursor.y -= 1;
 				}
-				
+			
 			}
-		controls.slide_down=false;
-	}
-	if (controls.slide_left) 
-	{
+	} else if (move.kind == Replay::Move::Slide && move.arg == Agents::NegX) {
 		//std::cout<<"LEFT"<<std::endl;
 		if (cursor.x > 0) 
 			{
-				if((Game::check_collision(cursor.x-1,cursor.y,board_size.x,board_size.y,wall_indices)))
+				if((Game::check_collision(cursor.x-1,cursor.y)))
 				{
 					cursor.y=cursor.y;
 				}
-				else if((Game::check_objects_hit(cursor.x-1,cursor.y,board_size.x,board_size.y,star_indices))) 
+				else if((Game::check_objects_hit(cursor.x-1,cursor.y,TileStar))) 
 				{
 					cursor.x -= 1;
 					star_points+=1;
 					star_flag=true;
+					board.set(cursor.x, cursor.y, TileFloor); //(collected)
 
 				}
-				else if((Game::check_objects_hit(cursor.x-1,cursor.y,board_size.x,board_size.y,hole_indices))) 
+				else if((Game::check_objects_hit(cursor.x-1,cursor.y,TileHole))) 
 				{
 					cursor.x -= 1;
 					star_points-=1;
 					hole_points+=1;
 					hole_flag=true;
+					board.set(cursor.x, cursor.y, TileFloor); //(filled)
 				}
-				else if((Game::check_objects_hit(cursor.x-1,cursor.y,board_size.x,board_size.y,riflector_indices))) 
+				else if((Game::check_objects_hit(cursor.x-1,cursor.y,TileRiflector))) 
 				{
-					cursor.y += 1;
-					cursor.x-=1;
-
-				
+					deflect(-1, +1);
 				}
 				else
 				{
@@ -507,38 +1079,34 @@ void Game::update(float elapsed) {
 
 			}
 
-		controls.slide_left=false;
-
-	}
-	if (controls.slide_right) 
-	{
+	} else if (move.kind == Replay::Move::Slide && move.arg == Agents::PosX) {
 		//std::cout<<"RIGHT"<<std::endl;
 		if (cursor.x + 1 < board_size.x) 
 			{
-				if((Game::check_collision(cursor.x+1,cursor.y,board_size.x,board_size.y,wall_indices)))
+				if((Game::check_collision(cursor.x+1,cursor.y)))
 				{
 					cursor.y=cursor.y;
 				}
-				else if((Game::check_objects_hit(cursor.x+1,cursor.y,board_size.x,board_size.y,star_indices))) 
+				else if((Game::check_objects_hit(cursor.x+1,cursor.y,TileStar))) 
 				{
 					cursor.x += 1;
 					star_points+=1;
 					star_flag=true;
+					board.set(cursor.x, cursor.y, TileFloor); //(collected)
 
 				}
-				else if((Game::check_objects_hit(cursor.x+1,cursor.y,board_size.x,board_size.y,hole_indices))) 
+				else if((Game::check_objects_hit(cursor.x+1,cursor.y,TileHole))) 
 				{
 					cursor.x += 1;
 					star_points-=1;
 					hole_points+=1;
 					hole_flag=true;
-					
+					board.set(cursor.x, cursor.y, TileFloor); //(filled)
+				
 				}
-				else if((Game::check_objects_hit(cursor.x+1,cursor.y,board_size.x,board_size.y,riflector_indices))) 
+				else if((Game::check_objects_hit(cursor.x+1,cursor.y,TileRiflector))) 
 				{
-					cursor.y -= 1;
-					cursor.x+=1;
-				
+					deflect(+1, -1);
 				}
 				else
 				{
@@ -546,174 +1114,750 @@ void Game::update(float elapsed) {
 				}
 
 
-				
+			
 			}
-		controls.slide_right=false;
 	}
+}
 
-	// Function for Reset
-	if (controls.reset){
-		std::cout<<"Reset function"<<std::endl;
-		//Game::reset();
+void Game::play(Replay::Move const &move) {
+	apply(move);
+	if (!record_path.empty()) {
+		replay.moves.emplace_back(move);
+		if (replay.keyframe_due()) replay.keyframes.emplace_back(snapshot());
 	}
+}
+
+Replay::Keyframe Game::snapshot() const {
+	Replay::Keyframe k;
+	k.move = replay.moves.size();
+	k.cursor_x = cursor.x;
+	k.cursor_y = cursor.y;
+	k.star_points = star_points;
+	k.hole_points = hole_points;
+	k.star_flag = star_flag;
+	k.hole_flag = hole_flag;
+	k.tiles = board.tiles;
+	k.agent_x = agents.x;
+	k.agent_y = agents.y;
+	k.agent_dir = agents.dir;
+	return k;
+}
 
+void Game::restore(Replay::Keyframe const &k) {
+	board.reset(k.tiles);
+	//(agents are blocked by exactly the walls; see paint and roll)
+	agents.resize(replay.width, replay.height);
+	for (uint32_t i : board.instances[TileWall]) {
+		agents.set_blocked(i % replay.width, i / replay.width, true);
+	}
+	for (size_t a = 0; a < k.agent_x.size(); ++a) {
+		agents.add(k.agent_x[a], k.agent_y[a], k.agent_dir[a]);
+	}
+	cursor = glm::uvec2(k.cursor_x, k.cursor_y);
+	star_points = k.star_points;
+	hole_points = k.hole_points;
+	star_flag = k.star_flag;
+	hole_flag = k.hole_flag;
+}
 
-	goal_key=cursor.y*board_size.y+cursor.x;
+void Game::seek(uint64_t move) {
+	move = std::min< uint64_t >(move, replay.moves.size());
+	Replay::Keyframe const &k = replay.keyframes[replay.keyframe_before(move)];
+	//(going forward without passing a keyframe, it's quicker to carry on from the current move)
+	if (move < playback.position || k.move > playback.position) {
+		restore(k);
+		playback.position = k.move;
+	}
+	while (playback.position < move) {
+		apply(replay.moves[playback.position]);
+		++playback.position;
+	}
+	std::cout << "Replay: move " << playback.position << " of " << replay.moves.size() << "." << std::endl;
+}
 
+void Game::sync_entities() {
+	entities.position(player) = glm::vec3(cursor.x + 0.5f, cursor.y + 0.5f, 0.0f);
 
-	std::cout<<" total points"<<star_points<<std::endl;
-	std::cout<<"--------------"<<std::endl;
-	std::cout<<" hole points"<<hole_points<<std::endl;
+	// HUD icons are stacked bottom-up using their bounding boxes, squeezed together if they would overflow the board height
+	auto hud_y = [&](Mesh const &mesh, int i, int count) {
+		float spacing = 1.1f * (mesh.box_max.y - mesh.box_min.y);
+		if (count > 0 && spacing * count > float(board_size.y)) spacing = float(board_size.y) / count;
+		return i * spacing - mesh.box_min.y;
+	};
+	//keep one icon per point:
+	auto sync_icons = [&](std::vector< Entities::Handle > &icons, int count, EntityGroup group, float x) {
+		count = std::max(count, 0);
+		while (int(icons.size()) > count) {
+			entities.destroy(icons.back());
+			icons.pop_back();
+		}
+		while (int(icons.size()) < count) {
+			icons.emplace_back(entities.create(Entities::Position | Entities::Render));
+			entities.group(icons.back()) = group;
+		}
+		for (int i = 0; i < count; ++i) {
+			entities.position(icons[i]) = glm::vec3(x, hud_y(*entity_groups[group].mesh, i, count), 0.0f);
+		}
+	};
 
+	// For points decrement
+	sync_icons(hole_icons, hole_flag ? hole_points : 0, GroupHoleIcon, board_size.x+1.5f);
+	if(hole_flag && hole_points>total_points)
+	{
+		std::cout<<"**************** YOU LOOSE********************"<<std::endl;
+	}
 
+	// for points increment
+	sync_icons(star_icons, star_flag ? star_points : 0, GroupStarIcon, board_size.x+0.5f);
+	bool won = ((star_flag || total_points == 0) && star_points>=total_points && goal_key==int(board.goal));
+	if (won && !entities.alive(goal_icon))
+	{
+		goal_icon = entities.create(Entities::Position | Entities::Render);
+		entities.group(goal_icon) = GroupGoalIcon;
+		entities.position(goal_icon) = glm::vec3(board_size.x+1.5f, board_size.y-3.0f, 0.0f);
+	}
+	else if (!won)
+	{
+		entities.destroy(goal_icon);
+	}
+	if (won)
+	{
+		std::cout<<"**************** YOU WIN********************"<<std::endl;
+	}
 }
 
 void Game::draw(glm::uvec2 drawable_size) {
-	//Set up a transformation matrix to fit the board in the window:
-	glm::mat4 world_to_clip;
+	//the scene is drawn at render_scale times the drawable size (and scaled up to fill it if that's smaller):
+	glm::uvec2 scene_size = drawable_size;
+	if (render_scale != 1.0f) {
+		scene_size.x = std::max(1u, uint32_t(drawable_size.x * render_scale + 0.5f));
+		scene_size.y = std::max(1u, uint32_t(drawable_size.y * render_scale + 0.5f));
+	}
+
+	//Set up a transformation matrix to show the camera's view of the board:
+	glm::mat4 world_to_clip = camera_world_to_clip(float(drawable_size.x) / float(drawable_size.y));
+
+	//visible part of the world (the camera is orthographic, looking down -z):
+	glm::vec2 view_radius;
 	{
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
+		float scale = camera_scale(aspect);
+		view_radius = glm::vec2(aspect / scale, 1.0f / scale);
+	}
+	glm::vec2 view_min = camera.center - view_radius;
+	glm::vec2 view_max = camera.center + view_radius;
+	//meshes whose bounding sphere is smaller than this many world units would cover less than half a pixel:
+	float lod_min_radius = 0.5f * (2.0f * view_radius.y) / float(scene_size.y);
 
-		//want scale such that board * scale fits in [-aspect,aspect]x[-1.0,1.0] screen box:
-		float scale = glm::min(
-			2.0f * aspect / float(board_size.x),
-			2.0f / float(board_size.y)
-		);
+	fit_shadow(drawable_size, view_min, view_max);
 
-		//center of board will be placed at center of screen:
-		glm::vec2 center = 0.5f * glm::vec2(board_size);
+	//bring tile instance buffers up to date with any board changes (every tile casts into the static shadow layer):
+	if (board.instances_reset || !board.changed_slots.empty()) shadow.static_dirty = true;
+	upload_tile_instances();
+	upload_board_tiles();
 
-		//NOTE: glm matrices are specified in column-major order
-		world_to_clip = glm::mat4(
-			scale / aspect, 0.0f, 0.0f, 0.0f,
-			0.0f, scale, 0.0f, 0.0f,
-			0.0f, 0.0f,-1.0f, 0.0f,
-			-(scale / aspect) * center.x, -scale * center.y, 0.0f, 1.0f
-		);
+	//agent offsets, used by both the shadow and main passes:
+	agent_instances.clear();
+	for (size_t i = 0; i < agents.size(); ++i)
+	{
+		agent_instances.emplace_back(agents.x[i]+0.5f, agents.y[i]+0.5f, 0.0f, 0.0f);
+	}
+	stream_instances(&agents_instance_pages, agent_instances);
+
+	//entity offsets, one list per group (used by both the shadow and main passes):
+	sync_entities();
+	for (auto &instances : entity_instances) instances.clear();
+	entities.extract(&entity_instances);
+	for (uint32_t g = 0; g < GroupCount; ++g)
+	{
+		stream_instances(&entity_groups[g].instances, entity_instances[g]);
 	}
 
-	//set up graphics pipeline to use data from the meshes and the simple shading program:
-	glBindVertexArray(meshes_for_simple_shading_vao);
+	//ghost offsets (main pass only):
+	ghosts.instances(&ghost_instances);
+	stream_instances(&ghosts_instance_pages, ghost_instances);
+
+	//------- passes (see RenderGraph.hpp) -------
+	render_graph.begin_frame();
+	RenderGraph::Resource backbuffer = render_graph.backbuffer(drawable_size);
+	RenderGraph::Resource shadow_map = render_graph.import_texture("shadow map", shadow.texture, GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT24, glm::uvec2(shadow.size, shadow.size));
+
+	//shadow map layer 0 (static casters) only when the board changed; layer 1 (dynamic casters) every frame:
+	if (shadow.static_dirty) {
+		render_graph.add_pass("shadow (static)", [this](){ render_shadow_casters(true); })
+			.write(shadow_map, 0).clear(GL_DEPTH_BUFFER_BIT);
+		shadow.static_dirty = false;
+	}
+	render_graph.add_pass("shadow (dynamic)", [this](){ render_shadow_casters(false); })
+		.write(shadow_map, 1).clear(GL_DEPTH_BUFFER_BIT);
+
+	//the scene goes straight to the backbuffer, or (when scaled) to transient textures that are then stretched over it:
+	auto scene = [&](){ draw_scene(world_to_clip, view_min, view_max, lod_min_radius); };
+	glm::vec4 background = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+	if (scene_size == drawable_size) {
+		render_graph.add_pass("scene", scene)
+			.read(shadow_map).write(backbuffer).clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, background);
+	} else {
+		RenderGraph::Resource color = render_graph.create_texture("scene color", GL_RGBA8, scene_size);
+		RenderGraph::Resource depth = render_graph.create_texture("scene depth", GL_DEPTH_COMPONENT24, scene_size);
+		render_graph.add_pass("scene", scene)
+			.read(shadow_map).write(color).write(depth).clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, background);
+		render_graph.add_pass("upscale", [&](){
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, render_graph.framebuffer(color));
+			glBlitFramebuffer(0, 0, scene_size.x, scene_size.y, 0, 0, drawable_size.x, drawable_size.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		}).read(color).write(backbuffer);
+	}
+
+	render_graph.execute();
+}
+
+void Game::draw_scene(glm::mat4 const &world_to_clip, glm::vec2 view_min, glm::vec2 view_max, float lod_min_radius) {
+	//set up graphics pipeline to pull vertices from the meshes buffer texture in the simple shading program:
+	glBindVertexArray(empty_vao);
 	glUseProgram(simple_shading.program);
 
-	glUniform3fv(simple_shading.sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-	glUniform3fv(simple_shading.sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f))));
-	glUniform3fv(simple_shading.sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.2f, 0.2f, 0.3f)));
-	glUniform3fv(simple_shading.sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
+	glActiveTexture(GL_TEXTURE0 + simple_shading.VerticesUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, meshes_tex);
 
-	//helper function to draw a given mesh with a given transformation:
+	//helper function to switch the instance offsets used by subsequent draws:
+	auto bind_instances = [&](GLuint tex) {
+		glActiveTexture(GL_TEXTURE0 + simple_shading.InstancesUnit);
+		glBindTexture(GL_TEXTURE_BUFFER, tex);
+	};
+	bind_instances(zero_instance_tex);
+
+	glActiveTexture(GL_TEXTURE0 + simple_shading.ShadowUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, shadow.texture);
+	//shadow map lookups go from clip space [-1,1] to texture space [0,1]:
+	glm::mat4 clip_to_texture = glm::mat4(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.5f, 0.0f,
+		0.5f, 0.5f, 0.5f, 1.0f
+	);
+	glm::mat4 light_to_shadow = clip_to_texture * shadow.world_to_clip;
+	glUniformMatrix4fv(simple_shading.light_to_shadow_mat4, 1, GL_FALSE, glm::value_ptr(light_to_shadow));
+
+	glm::vec3 sun_color = glm::vec3(0.81f, 0.81f, 0.76f);
+	glm::vec3 sky_color = glm::vec3(0.2f, 0.2f, 0.3f);
+	glm::vec3 sky_direction = glm::vec3(0.0f, 1.0f, 0.0f);
+	glUniform3fv(simple_shading.sun_color_vec3, 1, glm::value_ptr(sun_color));
+	glUniform3fv(simple_shading.sun_direction_vec3, 1, glm::value_ptr(sun_direction));
+	glUniform3fv(simple_shading.sky_color_vec3, 1, glm::value_ptr(sky_color));
+	glUniform3fv(simple_shading.sky_direction_vec3, 1, glm::value_ptr(sky_direction));
+	glUniform1f(simple_shading.time_float, idle_time);
+	glUniform4fv(simple_shading.idle_vec4, 1, glm::value_ptr(glm::vec4(0.0f)));
+
+	//Non-instanced draws are queued (after culling) and issued together once all their matrices have been
+	// computed in one batch (see transforms.hpp):
+	draw_meshes.clear();
+	draw_transforms.clear();
+
+	//helper function to queue a given mesh with a given transformation:
+	// (skips meshes whose bounding sphere is off screen or too small to see)
 	auto draw_mesh = [&](Mesh const &mesh, glm::mat4 const &object_to_world) {
-		//set up the matrix uniforms:
+		glm::vec3 center = glm::vec3(object_to_world * glm::vec4(mesh.sphere_center, 1.0f));
+		float radius = mesh.sphere_radius * glm::max(
+			glm::length(glm::vec3(object_to_world[0])), glm::max(
+			glm::length(glm::vec3(object_to_world[1])),
+			glm::length(glm::vec3(object_to_world[2])))
+		);
+		if (radius < lod_min_radius) return;
+		if (center.x + radius < view_min.x || center.x - radius > view_max.x) return;
+		if (center.y + radius < view_min.y || center.y - radius > view_max.y) return;
+
+		draw_meshes.emplace_back(&mesh);
+		draw_transforms.push(object_to_world);
+	};
+
+	//helper function to set the matrix uniforms:
+	auto set_matrices = [&](glm::mat4 const &object_to_clip, glm::mat4x3 const &object_to_light, glm::mat3 const &normal_to_light) {
 		if (simple_shading.object_to_clip_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * object_to_world;
 			glUniformMatrix4fv(simple_shading.object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
 		}
 		if (simple_shading.object_to_light_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(simple_shading.object_to_light_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_world));
+			glUniformMatrix4x3fv(simple_shading.object_to_light_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
 		}
 		if (simple_shading.normal_to_light_mat3 != -1U) {
-			//NOTE: if there isn't any non-uniform scaling in the object_to_world matrix, then the inverse transpose is the matrix itself, and computing it wastes some CPU time:
-			glm::mat3 normal_to_world = glm::inverse(glm::transpose(glm::mat3(object_to_world)));
-			glUniformMatrix3fv(simple_shading.normal_to_light_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_world));
+			glUniformMatrix3fv(simple_shading.normal_to_light_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
 		}
-
-		//draw the mesh:
-		glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
 	};
 
-	for (uint32_t y = 0; y < board_size.y; ++y) 
+	// The floor: one quad under the whole board, shaded per cell from the board_tiles texture
+	// (so its cost doesn't depend on the board's size; see upload_board_tiles):
 	{
-		for (uint32_t x = 0; x < board_size.x; ++x) {
-			draw_mesh(floor_mesh,
-				glm::mat4(
-					1.0f, 0.0f, 0.0f, 0.0f,
-					0.0f, 1.0f, 0.0f, 0.0f,
-					0.0f, 0.0f, 1.0f, 0.0f,
-					x+0.5f, y+0.5f,-0.5f, 1.0f
-				)
-			);
-			draw_mesh(*board_meshes[y*board_size.x+x],
-				glm::mat4(
-					1.0f, 0.0f, 0.0f, 0.0f,
-					0.0f, 1.0f, 0.0f, 0.0f,
-					0.0f, 0.0f, 1.0f, 0.0f,
-					x+0.5f, y+0.5f, 0.0f, 1.0f
-				)
-				* glm::mat4_cast(board_rotations[y*board_size.x+x])
-			);
-		}
-	}
-	draw_mesh(player_mesh,
-		glm::mat4(
-			1.0f, 0.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f,
-			cursor.x+0.5f, cursor.y+0.5f, 0.0f, 1.0f
-		)
-	);
-
-	
+		glUseProgram(floor_shading.program);
+		glActiveTexture(GL_TEXTURE0 + floor_shading.TilesUnit);
+		glBindTexture(GL_TEXTURE_2D, board_tiles_tex);
+
+		glUniformMatrix4fv(floor_shading.world_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+		glUniformMatrix4fv(floor_shading.light_to_shadow_mat4, 1, GL_FALSE, glm::value_ptr(light_to_shadow));
+		glUniform3fv(floor_shading.sun_color_vec3, 1, glm::value_ptr(sun_color));
+		glUniform3fv(floor_shading.sun_direction_vec3, 1, glm::value_ptr(sun_direction));
+		glUniform3fv(floor_shading.sky_color_vec3, 1, glm::value_ptr(sky_color));
+		glUniform3fv(floor_shading.sky_direction_vec3, 1, glm::value_ptr(sky_direction));
+		//(the floor mesh was placed at z = -0.5 under each cell, so its top is at -0.5 + box_max.z)
+		glUniform3f(floor_shading.board_size_vec3, float(board_size.x), float(board_size.y), -0.5f + floor_mesh.box_max.z);
+
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glUseProgram(simple_shading.program);
+	}
 
-   // For points decrement
-	if(hole_flag)
+	// Everything on top of the floor: one instanced draw per tile type
 	{
-		for(int i=0;i<hole_points;i++)
+		set_matrices(world_to_clip, glm::mat4x3(1.0f), glm::mat3(1.0f));
+		for (uint32_t t = 0; t < TileCount; ++t)
 		{
-				draw_mesh(hole_mesh,
+			if (t == TileFloor || board.instances[t].empty()) continue;
+			if (tile_meshes[t]->sphere_radius < lod_min_radius) continue; //too small to see at this zoom
+			glUniform4fv(simple_shading.idle_vec4, 1, glm::value_ptr(tile_idle[t].uniform()));
+			draw_instance_pages(tile_instances[t], uint32_t(board.instances[t].size()), [&](GLuint tex, GLsizei count){
+				bind_instances(tex);
+				glDrawArraysInstanced(GL_TRIANGLES, tile_meshes[t]->first, tile_meshes[t]->count, count);
+			});
+		}
+		glUniform4fv(simple_shading.idle_vec4, 1, glm::value_ptr(glm::vec4(0.0f)));
+		bind_instances(zero_instance_tex);
+	}
+
+	// Editor: preview the brush under the mouse
+	if (editor.active && editor.hover_valid)
+	{
+		draw_mesh(*tile_meshes[editor.brush],
 			glm::mat4(
 				1.0f, 0.0f, 0.0f, 0.0f,
 				0.0f, 1.0f, 0.0f, 0.0f,
 				0.0f, 0.0f, 1.0f, 0.0f,
-				board_size.x+1.5f,i, 0.0f, 1.0f
-			)	
-			);
+				editor.hover.x+0.5f, editor.hover.y+0.5f, 0.25f, 1.0f
+			)
+		);
+	}
+
+	// Rival agents: one instanced draw of player_mesh, offset per agent
+	if (!agent_instances.empty() && player_mesh.sphere_radius >= lod_min_radius)
+	{
+		set_matrices(world_to_clip, glm::mat4x3(1.0f), glm::mat3(1.0f));
+		draw_instance_pages(agents_instance_pages, uint32_t(agent_instances.size()), [&](GLuint tex, GLsizei count){
+			bind_instances(tex);
+			glDrawArraysInstanced(GL_TRIANGLES, player_mesh.first, player_mesh.count, count);
+		});
+		bind_instances(zero_instance_tex);
+	}
+
+	// Ghosts: one instanced draw of player_mesh for every recorded run being raced, hovering so they read as ghosts
+	if (!ghost_instances.empty() && player_mesh.sphere_radius >= lod_min_radius)
+	{
+		set_matrices(world_to_clip, glm::mat4x3(1.0f), glm::mat3(1.0f));
+		glUniform4fv(simple_shading.idle_vec4, 1, glm::value_ptr(ghost_idle.uniform()));
+		draw_instance_pages(ghosts_instance_pages, uint32_t(ghost_instances.size()), [&](GLuint tex, GLsizei count){
+			bind_instances(tex);
+			glDrawArraysInstanced(GL_TRIANGLES, player_mesh.first, player_mesh.count, count);
+		});
+		glUniform4fv(simple_shading.idle_vec4, 1, glm::value_ptr(glm::vec4(0.0f)));
+		bind_instances(zero_instance_tex);
+	}
 
+	// Entities (player, pickups, and HUD icons): one instanced draw per group
+	for (uint32_t g = 0; g < GroupCount; ++g)
+	{
+		Mesh const &mesh = *entity_groups[g].mesh;
+		if (entity_instances[g].empty() || mesh.sphere_radius < lod_min_radius) continue;
+		set_matrices(world_to_clip, glm::mat4x3(1.0f), glm::mat3(1.0f));
+		glUniform4fv(simple_shading.idle_vec4, 1, glm::value_ptr(entity_groups[g].idle.uniform()));
+		draw_instance_pages(entity_groups[g].instances, uint32_t(entity_instances[g].size()), [&](GLuint tex, GLsizei count){
+			bind_instances(tex);
+			glDrawArraysInstanced(GL_TRIANGLES, mesh.first, mesh.count, count);
+		});
+	}
+	glUniform4fv(simple_shading.idle_vec4, 1, glm::value_ptr(glm::vec4(0.0f)));
+	bind_instances(zero_instance_tex);
+
+	// Issue the queued (editor) draws:
+	draw_transforms.compute(world_to_clip);
+	for (size_t i = 0; i < draw_meshes.size(); ++i)
+	{
+		set_matrices(draw_transforms.object_to_clip[i], draw_transforms.object_to_light[i], draw_transforms.normal_to_light[i]);
+		glDrawArrays(GL_TRIANGLES, draw_meshes[i]->first, draw_meshes[i]->count);
+	}
+
+	bind_instances(0);
+	glActiveTexture(GL_TEXTURE0 + simple_shading.ShadowUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glActiveTexture(GL_TEXTURE0 + simple_shading.VerticesUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	glUseProgram(0);
+	glBindVertexArray(0);
+
+	GL_ERRORS();
+}
+
+
+
+float Game::camera_scale(float aspect) const {
+	//at zoom 1.0, want scale such that board * scale fits in [-aspect,aspect]x[-1.0,1.0] screen box:
+	return camera.zoom * glm::min(
+		2.0f * aspect / float(board_size.x),
+		2.0f / float(board_size.y)
+	);
+}
+
+glm::mat4 Game::camera_world_to_clip(float aspect) const {
+	float scale = camera_scale(aspect);
+
+	//NOTE: glm matrices are specified in column-major order
+	return glm::mat4(
+		scale / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, scale, 0.0f, 0.0f,
+		0.0f, 0.0f,-1.0f, 0.0f,
+		-(scale / aspect) * camera.center.x, -scale * camera.center.y, 0.0f, 1.0f
+	);
+}
+
+bool Game::window_to_cell(glm::ivec2 window_pos, glm::uvec2 window_size, glm::uvec2 *cell) const {
+	float aspect = float(window_size.x) / float(window_size.y);
+	glm::mat4 clip_to_world = glm::inverse(camera_world_to_clip(aspect));
+	glm::vec4 clip = glm::vec4(
+		2.0f * (window_pos.x + 0.5f) / float(window_size.x) - 1.0f,
+		1.0f - 2.0f * (window_pos.y + 0.5f) / float(window_size.y),
+		0.0f, 1.0f
+	);
+	glm::vec4 world = clip_to_world * clip;
+	if (world.x < 0.0f || world.y < 0.0f) return false;
+	glm::uvec2 c = glm::uvec2(uint32_t(world.x), uint32_t(world.y));
+	if (c.x >= board_size.x || c.y >= board_size.y) return false;
+	*cell = c;
+	return true;
+}
+
+bool Game::roll(bool column, int32_t shift) {
+	if (cursor.x >= board.width || cursor.y >= board.height) return false; //(no line to roll)
+
+	//the cell that would end up under the player:
+	glm::uvec2 from = cursor;
+	if (column) from.y = uint32_t(((int64_t(cursor.y) - shift) % board.height + board.height) % board.height);
+	else from.x = uint32_t(((int64_t(cursor.x) - shift) % board.width + board.width) % board.width);
+	if (from != cursor && (board.get(from.x, from.y) == TileWall || agents.occupied(from.x, from.y))) return false;
+
+	if (column) {
+		board.roll_column(cursor.x, shift);
+		agents.roll_column(cursor.x, shift);
+	} else {
+		board.roll_row(cursor.y, shift);
+		agents.roll_row(cursor.y, shift);
+	}
+	return true;
+}
+
+void Game::paint(glm::uvec2 cell, Tile tile) {
+	Tile old = board.get(cell.x, cell.y);
+	if (old == tile) return;
+	if (old == TileGoal) return; //the goal can be moved (by painting it elsewhere) but not removed
+	if (tile == TileWall) {
+		//walls can't go where the player is, where the player starts, or on top of an agent:
+		// (the same rule roll() follows)
+		if (cell == cursor || cell == start || agents.occupied(cell.x, cell.y)) {
+			std::cout << "Editor: can't put a wall under the player, the start, or an agent." << std::endl;
+			return;
 		}
+	}
 
-		if(hole_points>total_points)
-		{
-			std::cout<<"**************** YOU LOOSE********************"<<std::endl;
+	board.set(cell.x, cell.y, tile);
+	if (old == TileWall || tile == TileWall) {
+		agents.set_blocked(cell.x, cell.y, tile == TileWall);
+	}
+
+	uint32_t steps = board.distance_to_goal(start.x, start.y);
+	if (steps == Board::Unreachable) {
+		std::cout << "Editor: goal is unreachable from the start." << std::endl;
+	} else {
+		std::cout << "Editor: goal is " << steps << " steps from the start." << std::endl;
+	}
+}
+
+void Game::save_level() {
+	std::string path = (level_pack.empty() ? user_path("levels.pack") : level_pack);
+	try {
+		LevelPack pack;
+		{ //keep any other levels already in the pack:
+			std::ifstream existing(path, std::ios::binary);
+			if (existing) {
+				existing.close();
+				pack.load(path);
+			}
 		}
-	 }
+		if (level_index > pack.levels.size()) level_index = uint32_t(pack.levels.size());
+		if (level_index == pack.levels.size()) pack.levels.emplace_back();
+		LevelPack::Level &level = pack.levels[level_index];
+		level.width = board.width;
+		level.height = board.height;
+		level.start_x = start.x;
+		level.start_y = start.y;
+		level.tiles = board.dense_tiles();
+		pack.save(path);
+		level_pack = path;
+		std::cout << "Editor: saved level " << level_index << " to '" << path << "'." << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << "Editor: failed to save level: " << e.what() << std::endl;
+	}
+}
 
-	// for points increment
-	if(star_flag)
-	{
-		for(int i=0;i<star_points;i++)
-		{
-				draw_mesh(starpoint_mesh,
-			glm::mat4(
-				1.0f, 0.0f, 0.0f, 0.0f,
-				0.0f, 1.0f, 0.0f, 0.0f,
-				0.0f, 0.0f, 1.0f, 0.0f,
-				board_size.x+0.5f,i, 0.0f, 1.0f
-			)	
-			);
+void Game::allocate_instances(InstancePages *pages_, uint32_t count) {
+	InstancePages &pages = *pages_;
+	uint32_t page_count = std::max< uint32_t >(1, (count + instance_page_size - 1) / instance_page_size);
+	while (pages.pages.size() < page_count) {
+		pages.pages.emplace_back();
+		InstancePages::Page &page = pages.pages.back();
+		glGenBuffers(1, &page.vbo);
+		glGenTextures(1, &page.tex);
+		glBindTexture(GL_TEXTURE_BUFFER, page.tex);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, page.vbo);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	while (pages.pages.size() > page_count) {
+		glDeleteTextures(1, &pages.pages.back().tex);
+		glDeleteBuffers(1, &pages.pages.back().vbo);
+		pages.pages.pop_back();
+	}
+	for (uint32_t p = 0; p < page_count; ++p) {
+		InstancePages::Page &page = pages.pages[p];
+		page.capacity = std::min(instance_page_size, count - p * instance_page_size);
+		glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * page.capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Game::stream_instances(InstancePages *pages_, std::vector< glm::vec4 > const &instances) {
+	InstancePages &pages = *pages_;
+	if (instances.empty()) return;
+	uint32_t page_count = uint32_t((instances.size() + instance_page_size - 1) / instance_page_size);
+	if (pages.pages.size() < page_count) allocate_instances(&pages, uint32_t(instances.size()));
+	for (uint32_t p = 0; p < page_count; ++p) {
+		InstancePages::Page &page = pages.pages[p];
+		size_t begin = size_t(p) * instance_page_size;
+		page.capacity = uint32_t(std::min(instances.size() - begin, size_t(instance_page_size)));
+		glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * page.capacity, instances.data() + begin, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Game::draw_instance_pages(InstancePages const &pages, uint32_t count, std::function< void(GLuint, GLsizei) > const &draw) const {
+	for (uint32_t p = 0; p < pages.pages.size() && p * instance_page_size < count; ++p) {
+		draw(pages.pages[p].tex, GLsizei(std::min(instance_page_size, count - p * instance_page_size)));
+	}
+}
+
+void Game::free_instances(InstancePages *pages) {
+	for (InstancePages::Page &page : pages->pages) {
+		glDeleteTextures(1, &page.tex);
+		glDeleteBuffers(1, &page.vbo);
+	}
+	pages->pages.clear();
+}
+
+void Game::upload_tile_instances() {
+	//cell center, and a phase for idle animation from the instance's seed (so neighbors don't move in lockstep,
+	// and a tile keeps its phase when a roll carries it along or a swap-removal moves it to another slot):
+	auto instance = [this](Tile t, uint32_t slot) {
+		uint32_t cell = board.instances[t][slot];
+		float phase = float(board.instance_seeds[t][slot] >> 16) * (6.2831853f / 65536.0f);
+		return glm::vec4(cell % board.width + 0.5f, cell / board.width + 0.5f, 0.0f, phase);
+	};
+
+	bool uploaded[TileCount] = { false }; //type was fully uploaded, so doesn't need patching
+	for (uint32_t t = 0; t < TileCount; ++t) {
+		if (t == TileFloor) continue;
+		InstancePages &ti = tile_instances[t];
+		std::vector< uint32_t > const &cells = board.instances[t];
+		if (board.instances_reset || cells.size() > ti.capacity()) {
+			//(re)allocate with room to grow, and upload every instance, a page at a time:
+			allocate_instances(&ti, std::max< uint32_t >(64, uint32_t(cells.size() + cells.size() / 2)));
+			std::vector< glm::vec4 > data;
+			for (size_t p = 0; p * instance_page_size < cells.size(); ++p) {
+				size_t begin = p * instance_page_size;
+				size_t end = std::min(cells.size(), begin + instance_page_size);
+				data.clear();
+				for (size_t i = begin; i < end; ++i) {
+					data.emplace_back(instance(Tile(t), uint32_t(i)));
+				}
+				glBindBuffer(GL_ARRAY_BUFFER, ti.pages[p].vbo);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * data.size(), data.data());
+			}
+			uploaded[t] = true;
 		}
-		if(star_points>=total_points&&goal_key==39)
-		{
-				draw_mesh(goal_mesh,
-			glm::mat4(
-				1.0f, 0.0f, 0.0f, 0.0f,
-				0.0f, 1.0f, 0.0f, 0.0f,
-				0.0f, 0.0f, 1.0f, 0.0f,
-				board_size.x+1.5f,board_size.y-3, 0.0f, 1.0f
-				)
-			);
-	 
-			std::cout<<"**************** YOU WIN********************"<<std::endl;
+	}
+
+	//patch only the slots that changed:
+	for (Board::SlotChange const &change : board.changed_slots) {
+		if (uploaded[change.type]) continue;
+		InstancePages &ti = tile_instances[change.type];
+		std::vector< uint32_t > const &cells = board.instances[change.type];
+		if (change.slot >= cells.size()) continue; //slot was removed again later
+		glm::vec4 data = instance(change.type, change.slot);
+		glBindBuffer(GL_ARRAY_BUFFER, ti.pages[change.slot / instance_page_size].vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * (change.slot % instance_page_size), sizeof(glm::vec4), &data);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	board.changed_slots.clear();
+	board.instances_reset = false;
+}
+
+void Game::upload_board_tiles() {
+	static_assert(sizeof(Tile) == 1, "board_tiles texels are copied straight from board tiles.");
+	if (!board.tiles_reset && board.changed_cells.empty()) return;
+
+	glBindTexture(GL_TEXTURE_2D, board_tiles_tex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	//upload the cells in [lo, hi] (read out of the board's sparse storage a row at a time):
+	std::vector< Tile > texels;
+	auto upload = [this, &texels](glm::uvec2 lo, glm::uvec2 hi) {
+		glm::uvec2 size = hi - lo + glm::uvec2(1);
+		texels.resize(size_t(size.x) * size_t(size.y));
+		for (uint32_t y = 0; y < size.y; ++y) {
+			board.tiles.read_row(lo.x, lo.y + y, size.x, texels.data() + size_t(y) * size.x);
 		}
-		
-	 }
+		glTexSubImage2D(GL_TEXTURE_2D, 0, lo.x, lo.y, size.x, size.y, GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels.data());
+	};
 
-	
+	if (board.tiles_reset) {
+		upload(glm::uvec2(0), glm::uvec2(board.width - 1, board.height - 1));
+	} else if (board.changed_cells.size() <= 16) {
+		//a few edits (e.g. painting): one texel each:
+		for (uint32_t cell : board.changed_cells) {
+			glm::uvec2 at = glm::uvec2(cell % board.width, cell / board.width);
+			upload(at, at);
+		}
+	} else {
+		//many (e.g. a roll, which changes one row or column): their bounding rectangle:
+		glm::uvec2 lo = glm::uvec2(-1U), hi = glm::uvec2(0);
+		for (uint32_t cell : board.changed_cells) {
+			glm::uvec2 at = glm::uvec2(cell % board.width, cell / board.width);
+			lo = glm::min(lo, at);
+			hi = glm::max(hi, at);
+		}
+		upload(lo, hi);
+	}
 
-	glUseProgram(0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	board.changed_cells.clear();
+	board.tiles_reset = false;
 
 	GL_ERRORS();
 }
 
+void Game::fit_shadow(glm::uvec2 drawable_size, glm::vec2 view_min, glm::vec2 view_max) {
+	//size: about a texel per pixel of the (largest) drawable dimension, as a power of two in [512, 4096]:
+	// (two layers of 4096^2 are already 128MB of depth; past that, a bigger map isn't worth the memory)
+	GLint max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	uint32_t size = 512;
+	while (size < glm::max(drawable_size.x, drawable_size.y) && size < uint32_t(std::min(max_size, 4096))) size *= 2;
+	if (GLsizei(size) != shadow.size) {
+		shadow.size = GLsizei(size);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, shadow.texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, shadow.size, shadow.size, 2, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		shadow.static_dirty = true;
+	}
+
+	//region: the view (clipped to the board), plus a margin so that small camera moves don't re-render the static layer;
+	// it's refit (snapped to whole cells) when the view leaves it, or when the view has shrunk to well under half of it:
+	glm::vec2 board_max = glm::vec2(board_size);
+	glm::vec2 need_min = glm::clamp(view_min, glm::vec2(0.0f), board_max);
+	glm::vec2 need_max = glm::clamp(view_max, glm::vec2(0.0f), board_max);
+	glm::vec2 need = glm::max(need_max - need_min, glm::vec2(1.0f));
+	glm::vec2 have = shadow.region_max - shadow.region_min;
+	bool inside = need_min.x >= shadow.region_min.x && need_min.y >= shadow.region_min.y
+		&& need_max.x <= shadow.region_max.x && need_max.y <= shadow.region_max.y;
+	bool too_big = (have.x > 3.0f * need.x && have.y > 3.0f * need.y);
+	if (inside && !too_big) return;
+
+	glm::vec2 margin = 0.25f * need;
+	shadow.region_min = glm::max(glm::floor(need_min - margin), glm::vec2(0.0f));
+	shadow.region_max = glm::min(glm::ceil(need_max + margin), board_max);
+
+	//The sun is directional, so its view is a projection along sun_direction onto the z = 0 plane
+	// (x and y are sheared by height) with depth decreasing toward the sun.
+	// It needs to cover the region for everything between the floor and the tops of the tallest tiles:
+	float z_lo = -1.0f, z_hi = 2.0f;
+	glm::vec2 shear = -glm::vec2(sun_direction) / sun_direction.z;
+	glm::vec2 lo = shadow.region_min + glm::min(shear * z_lo, shear * z_hi);
+	glm::vec2 hi = shadow.region_max + glm::max(shear * z_lo, shear * z_hi);
+	glm::vec2 scale = glm::vec2(2.0f) / (hi - lo);
+	float z_scale = -2.0f / (z_hi - z_lo);
+
+	//NOTE: glm matrices are specified in column-major order
+	shadow.world_to_clip = glm::mat4(
+		scale.x, 0.0f, 0.0f, 0.0f,
+		0.0f, scale.y, 0.0f, 0.0f,
+		scale.x * shear.x, scale.y * shear.y, z_scale, 0.0f,
+		-1.0f - scale.x * lo.x, -1.0f - scale.y * lo.y, 1.0f - z_scale * z_lo, 1.0f
+	);
+	shadow.static_dirty = true;
+}
+
+void Game::render_shadow_casters(bool static_layer) {
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	//push depths away from the sun a bit to avoid self-shadowing ("acne"):
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	glBindVertexArray(empty_vao);
+	glUseProgram(shadow.program);
+	glActiveTexture(GL_TEXTURE0 + simple_shading.VerticesUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, meshes_tex);
+	glActiveTexture(GL_TEXTURE0 + simple_shading.InstancesUnit);
+
+	glUniform1f(shadow.time_float, idle_time);
+	auto draw_instanced = [&](Mesh const &mesh, InstancePages const &instances, size_t count, glm::mat4 const &object_to_world, TileIdle const &idle = TileIdle()) {
+		if (count == 0) return;
+		glm::mat4 object_to_clip = shadow.world_to_clip * object_to_world;
+		glUniformMatrix4fv(shadow.object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+		glUniform4fv(shadow.idle_vec4, 1, glm::value_ptr(idle.uniform()));
+		draw_instance_pages(instances, uint32_t(count), [&](GLuint tex, GLsizei page_count){
+			glBindTexture(GL_TEXTURE_BUFFER, tex);
+			glDrawArraysInstanced(GL_TRIANGLES, mesh.first, mesh.count, page_count);
+		});
+	};
+
+	//every tile goes in the static layer, at rest: idle animation is too small to see in a shadow,
+	// and redrawing every animated tile on the board each frame (e.g. thousands of stars) isn't worth it:
+	if (static_layer) {
+		for (uint32_t t = 0; t < TileCount; ++t) {
+			if (t == TileFloor) continue; //(floor is the lowest thing on the board, so never shadows anything)
+			draw_instanced(*tile_meshes[t], tile_instances[t], board.instances[t].size(), glm::mat4(1.0f));
+		}
+	} else {
+		//dynamic layer: also agents and entities (except HUD icons):
+		draw_instanced(player_mesh, agents_instance_pages, agent_instances.size(), glm::mat4(1.0f));
+		for (uint32_t g = 0; g < GroupCount; ++g) {
+			if (!entity_groups[g].shadow) continue;
+			draw_instanced(*entity_groups[g].mesh, entity_groups[g].instances, entity_instances[g].size(), glm::mat4(1.0f), entity_groups[g].idle);
+		}
+	}
 
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0 + simple_shading.VerticesUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glUseProgram(0);
+	glBindVertexArray(0);
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	GL_ERRORS();
+}
 
 //create and return an OpenGL vertex shader from source:
 static GLuint compile_shader(GLenum type, std::string const &source) {
@@ -737,3 +1881,30 @@ static GLuint compile_shader(GLenum type, std::string const &source) {
 	}
 	return shader;
 }
+
+//link a program from two shaders (the shaders are released, so they are freed along with the program):
+static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	//shaders are reference counted so this makes sure they are freed after program is deleted:
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+
+	//link the shader program and throw errors if linking fails:
+	glLinkProgram(program);
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		std::cerr << "Failed to link shader program." << std::endl;
+		GLint info_log_length = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(info_log_length, 0);
+		GLsizei length = 0;
+		glGetProgramInfoLog(program, GLsizei(info_log.size()), &length, &info_log[0]);
+		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+		glDeleteProgram(program);
+		throw std::runtime_error("failed to link program");
+	}
+	return program;
+}
@@ -1,20 +1,45 @@
 #pragma once
 
 #include "GL.hpp"
+#include "Agents.hpp"
+#include "Board.hpp"
+#include "tiles.hpp"
+#include "transforms.hpp"
+#include "RenderGraph.hpp"
+#include "Replay.hpp"
+#include "Ghosts.hpp"
+#include "Entities.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include<list>
+#include <functional>
 #include <vector>
+#include <string>
 
 // The 'Game' struct holds all of the game-relevant state,
 // and is called by the main loop.
 
 struct Game {
+	//Options control how the game is set up (main fills these in from the command line):
+	struct Options {
+		glm::uvec2 board_size = glm::uvec2(8,8);
+		uint32_t seed = 0; //board layout seed
+		uint32_t agent_count = 4; //rival agents spawned at startup (before removing any that landed on walls or each other)
+		std::string level_pack; //if not empty, load the board from this level pack instead of generating it
+		uint32_t level = 0; //which level of level_pack to load (and where the editor saves)
+		float render_scale = 1.0f; //draw the scene at this fraction of the window's resolution
+		std::string record; //if not empty, record a replay of the session to this file
+		uint32_t keyframe_interval = 1024; //(when recording) moves between replay keyframes
+		std::string replay; //if not empty, view this replay instead of playing
+		std::string ghosts; //if not empty, race the runs recorded in this ghost journal
+		std::string record_ghost; //if not empty, add this session's run to this ghost journal
+	};
+
 	//Game creates OpenGL resources (i.e. vertex buffer objects) in its
 	//constructor and frees them in its destructor.
-	Game();
+	Game(Options const &options);
 	~Game();
 
 	int star_points=0;
@@ -23,10 +48,6 @@ struct Game {
 	bool hole_flag=false;
 	bool star_flag=false;
 	int goal_key=0;
-	std::vector<int> wall_indices;
-	std::vector<int> star_indices;
-	std::vector<int> riflector_indices;
-	std::vector<int> hole_indices;
 
 
 	//handle_event is called when new mouse or keyboard events are received:
@@ -43,11 +64,58 @@ struct Game {
 	// Reset the game
 	//void reset();
 
-	//check collision
-	bool check_collision(int x,int y,int board_width,int board_height,std::vector<int> &wall_indices);
+	//check collision (walls and agents)
+	bool check_collision(int x,int y);
+
+	//check whether the cell at x,y holds a tile of the given type (stars, holes, riflectors)
+	bool check_objects_hit(int x,int y,Tile type);
+
+	//move the cursor diagonally off a riflector, if the cell it lands on is on the board and free (walls and agents):
+	void deflect(int dx, int dy);
+
+	//camera helpers: clip units per world unit, and the full world-to-clip transform:
+	float camera_scale(float aspect) const;
+	glm::mat4 camera_world_to_clip(float aspect) const;
+
+	//find the board cell under a window position (returns false if there isn't one):
+	bool window_to_cell(glm::ivec2 window_pos, glm::uvec2 window_size, glm::uvec2 *cell) const;
+
+	//rotate the cursor's row (or column) by 'shift' cells, carrying tiles and agents along (the player stays put);
+	// returns false (and does nothing) if the player is off the board or that would bring a wall or an agent onto the player:
+	bool roll(bool column, int32_t shift);
+
+	//every change to the game goes through a move (see Replay.hpp):
+	void apply(Replay::Move const &move); //the game's rules
+	void play(Replay::Move const &move); //apply, and add to the replay being recorded (if any)
+
+	//replay keyframes: capture the current state, or go back to a captured one:
+	Replay::Keyframe snapshot() const;
+	void restore(Replay::Keyframe const &keyframe);
+
+	//(when viewing a replay) go to the state just before replay.moves[move]:
+	void seek(uint64_t move);
+
+	//editor: change one cell (keeping agents and derived data in sync), and save to the level pack:
+	void paint(glm::uvec2 cell, Tile tile);
+	void save_level();
+
+	//copy changed board instances into the tile instance buffers:
+	void upload_tile_instances();
 
-	//update Star points
-	bool check_objects_hit(int x,int y,int board_width,int board_height,std::vector<int> &star_indices);
+	//copy changed cells into the board_tiles texture:
+	void upload_board_tiles();
+
+	//bring the player's and HUD icons' entities up to date with the game state (called by draw):
+	void sync_entities();
+
+	//size the shadow map for the drawable and fit it to the view (marking the static layer dirty if either changed):
+	void fit_shadow(glm::uvec2 drawable_size, glm::vec2 view_min, glm::vec2 view_max);
+
+	//draw shadow casters (static: board tiles, at rest, for layer 0; dynamic: player, agents, and pickups, for layer 1):
+	void render_shadow_casters(bool static_layer);
+
+	//draw the board, pieces, and HUD (called by the render graph's scene pass):
+	void draw_scene(glm::mat4 const &world_to_clip, glm::vec2 view_min, glm::vec2 view_max, float lod_min_radius);
 
 	
 
@@ -67,20 +135,72 @@ struct Game {
 		GLuint sun_color_vec3 = -1U;
 		GLuint sky_direction_vec3 = -1U;
 		GLuint sky_color_vec3 = -1U;
+		GLuint light_to_shadow_mat4 = -1U;
+		GLuint time_float = -1U;
+		GLuint idle_vec4 = -1U;
 
-		//attribute locations:
-		GLuint Position_vec4 = -1U;
-		GLuint Normal_vec3 = -1U;
-		GLuint Color_vec4 = -1U;
+		//texture units for the buffer textures vertices are pulled from, and for the shadow map:
+		enum : GLint { VerticesUnit = 0, InstancesUnit = 1, ShadowUnit = 2 };
 	} simple_shading;
 
+	//program that draws the floor under every cell as a single quad, shaded from the board_tiles texture:
+	struct {
+		GLuint program = -1U;
+
+		//uniform locations:
+		GLuint world_to_clip_mat4 = -1U;
+		GLuint light_to_shadow_mat4 = -1U;
+		GLuint sun_direction_vec3 = -1U;
+		GLuint sun_color_vec3 = -1U;
+		GLuint sky_direction_vec3 = -1U;
+		GLuint sky_color_vec3 = -1U;
+		GLuint board_size_vec3 = -1U; //(width, height, z of the floor's top)
+
+		//(the shadow map is bound to simple_shading.ShadowUnit)
+		enum : GLint { TilesUnit = 3 };
+	} floor_shading;
+	glm::vec4 floor_color = glm::vec4(1.0f); //(from the floor mesh)
+
+	//the board's tiles, one GL_R8UI texel per cell, patched as the board changes:
+	GLuint board_tiles_tex = -1U;
+
+	//sun shadows: a two-layer depth map seen from the sun.
+	// layer 0 holds static casters (board tiles) and is only re-rendered when the board changes (or the map is refit to the view);
+	// layer 1 holds dynamic casters (player, agents, pickups) and is cleared and redrawn every frame.
+	struct {
+		GLuint program = -1U; //depth-only program (same vertex pulling as simple_shading)
+		GLuint object_to_clip_mat4 = -1U;
+		GLuint time_float = -1U;
+		GLuint idle_vec4 = -1U;
+
+		GLuint texture = -1U; //GL_TEXTURE_2D_ARRAY, two layers of GL_DEPTH_COMPONENT24
+		GLsizei size = 0; //width and height of each layer (picked from the drawable size by fit_shadow)
+
+		//part of the board (world xy) the map covers: the view plus a margin, refit by fit_shadow as the camera moves:
+		glm::vec2 region_min = glm::vec2(0.0f);
+		glm::vec2 region_max = glm::vec2(0.0f);
+		glm::mat4 world_to_clip = glm::mat4(1.0f); //sun's view, covering the region
+		bool static_dirty = true; //layer 0 needs to be re-rendered
+	} shadow;
+	glm::vec3 sun_direction = glm::vec3(0.0f, 0.0f, 1.0f); //(toward the sun; set in constructor)
+
+	//passes and transient render targets for each frame:
+	RenderGraph render_graph;
+	float render_scale = 1.0f; //(from Options)
+
 	//mesh data, stored in a vertex buffer:
 	GLuint meshes_vbo = -1U; //vertex buffer holding mesh data
+	GLuint meshes_tex = -1U; //buffer texture the vertex shader reads meshes_vbo through
 
 	//The location of each mesh in the meshes vertex buffer:
 	struct Mesh {
 		GLint first = 0;
 		GLsizei count = 0;
+		//object-space bounds (from the blob, so no need to look at vertex data):
+		glm::vec3 box_min = glm::vec3(0.0f);
+		glm::vec3 box_max = glm::vec3(0.0f);
+		glm::vec3 sphere_center = glm::vec3(0.0f);
+		float sphere_radius = 0.0f;
 	};
 
 
@@ -102,25 +222,145 @@ struct Game {
 
 	//std::vector< Mesh const * > meshes{&wall_mesh,&starpoint_mesh,&gummy_mesh,&floor_mesh};
 
-	GLuint meshes_for_simple_shading_vao = -1U; //vertex array object that describes how to connect the meshes_vbo to the simple_shading_program
+	//vertices are pulled from buffer textures, so every draw uses the same (empty) vertex array object:
+	GLuint empty_vao = -1U;
+
+	//per-instance offsets are also read from buffer textures; non-instanced draws read a single zero offset:
+	GLuint zero_instance_vbo = -1U;
+	GLuint zero_instance_tex = -1U;
+
+	//a buffer texture can only address GL_MAX_TEXTURE_BUFFER_SIZE texels (as few as 65536), so instance lists are
+	// split into pages of at most instance_page_size instances, each with its own buffer, and drawn one page at a time:
+	struct InstancePages {
+		struct Page {
+			GLuint vbo = -1U;
+			GLuint tex = -1U; //buffer texture over vbo
+			uint32_t capacity = 0; //instances allocated in vbo
+		};
+		std::vector< Page > pages;
+		uint32_t capacity() const {
+			uint32_t total = 0;
+			for (Page const &page : pages) total += page.capacity;
+			return total;
+		}
+	};
+	uint32_t instance_page_size = 65536; //(set from GL_MAX_TEXTURE_BUFFER_SIZE)
+
+	//(re)allocate pages with room for at least 'count' instances (contents are lost):
+	void allocate_instances(InstancePages *pages, uint32_t count);
+	//replace the contents of 'pages' with 'instances' (e.g. every frame), adding pages as needed:
+	void stream_instances(InstancePages *pages, std::vector< glm::vec4 > const &instances);
+	//call draw(buffer texture, count) for each page covering the first 'count' instances:
+	void draw_instance_pages(InstancePages const &pages, uint32_t count, std::function< void(GLuint, GLsizei) > const &draw) const;
+	void free_instances(InstancePages *pages);
+
+	//per-agent offsets, re-uploaded every frame and drawn instanced:
+	InstancePages agents_instance_pages;
+	std::vector< glm::vec4 > agent_instances; //staging for agents_instance_pages
+
+	//per-ghost offsets, re-uploaded every frame and drawn instanced (ghosts don't cast shadows):
+	InstancePages ghosts_instance_pages;
+	std::vector< glm::vec4 > ghost_instances; //staging for ghosts_instance_pages
+
+	//non-instanced draws queued during draw(), and their per-draw matrices:
+	std::vector< Mesh const * > draw_meshes;
+	DrawTransforms draw_transforms;
+
+	//per-tile-type instance buffers; slot i holds the cell board.instances[type][i]
+	// (in page i / instance_page_size, at i % instance_page_size):
+	InstancePages tile_instances[TileCount];
 
 	//------- game state -------
 
-	glm::uvec2 board_size = glm::uvec2(8,8);  // Board size 4*4
+	glm::uvec2 board_size = glm::uvec2(8,8);  // Board size 8*8 (set from Options)
 	//std::vector<std::vector<Mesh const *> > matrix;
-	std::vector< Mesh const * > board_meshes;
-	//std::vector< Mesh const * > meshes;
-	std::vector< glm::quat > board_rotations;
+	Board board; //tile grid + derived data
+	Mesh const *tile_meshes[TileCount]; //mesh drawn for each tile type
+
+	//idle animation for a tile type, applied by the vertex shader to every instance (each with its own phase):
+	struct TileIdle {
+		float spin = 0.0f; //radians per second around the tile's z axis
+		float bob = 0.0f; //height (world units) the tile rises and falls
+		float pulse = 0.0f; //fraction of its size the tile grows and shrinks
+		float rate = 0.0f; //radians per second of the bob and pulse cycle
+		glm::vec4 uniform() const { return glm::vec4(spin, bob, pulse, rate); } //(as the 'idle' uniform)
+	};
+	TileIdle tile_idle[TileCount];
+	float idle_time = 0.0f; //seconds of idle animation so far, modulo IdlePeriod (the 'time' uniform)
+	//every idle spin and rate is a multiple of IdleRateStep radians per second, so all of them repeat every IdlePeriod seconds:
+	static constexpr float IdleRateStep = 0.5f;
+	static constexpr float IdlePeriod = 6.2831853f / IdleRateStep;
+
+	glm::uvec2 start = glm::uvec2(0,0); //where the player starts
+
+	//where the board came from (and where the editor saves it):
+	std::string level_pack;
+	uint32_t level_index = 0;
+
+	struct {
+		glm::vec2 center = glm::vec2(4.0f, 4.0f); //world position at center of screen
+		float zoom = 1.0f; //1.0 == whole board fits in window
+	} camera;
+
+	struct {
+		bool active = false;
+		Tile brush = TileWall; //tile type to paint
+		bool painting = false; //left button held
+		bool panning = false; //right button held
+		bool hover_valid = false;
+		glm::uvec2 hover = glm::uvec2(0,0); //cell under mouse
+	} editor;
 
 	
 
 	glm::uvec2 cursor = glm::vec2(0,0);
 
+	//the replay being recorded (if record_path is set) or viewed (if playback.active):
+	Replay replay;
+	std::string record_path;
+	struct {
+		bool active = false;
+		bool paused = false;
+		uint64_t position = 0; //moves of the replay applied so far
+		float move_interval = 0.1f; //seconds per move when playing
+		float timer = 0.0f;
+	} playback;
+
+	//recorded runs raced as ghosts (ghosts.time is the race clock, which also times this session's run):
+	Ghosts ghosts;
+	TileIdle ghost_idle; //(ghosts hover; set in constructor)
+	std::string ghost_record_path;
+	GhostJournal::Run ghost_run; //this session's run (recorded if ghost_record_path is set)
+	glm::uvec2 ghost_run_at = glm::uvec2(0); //player's cell as of ghost_run's last step
+	uint32_t ghost_run_tick = 0; //tick of ghost_run's last step
+
+	//non-tile objects (the player, collected-star pickups, and HUD icons) live in an entity store, and are drawn with
+	// one instanced draw per group, from offsets gathered by entities.extract and re-uploaded every frame:
+	Entities entities;
+	enum EntityGroup : uint32_t { GroupPlayer = 0, GroupPickup, GroupStarIcon, GroupHoleIcon, GroupGoalIcon, GroupCount };
+	struct {
+		Mesh const *mesh = nullptr;
+		TileIdle idle;
+		bool shadow = false; //drawn into the dynamic shadow layer
+		InstancePages instances;
+	} entity_groups[GroupCount];
+	std::vector< std::vector< glm::vec4 > > entity_instances; //staging for each group's instances
+	Entities::Handle player; //(placed at the cursor by sync_entities)
+	std::vector< Entities::Handle > star_icons, hole_icons; //HUD: one icon per point
+	Entities::Handle goal_icon; //HUD: shown once the player has won
+
+	//rival pieces (kept in their own structure-of-arrays store, which also tracks which cells they occupy):
+	Agents agents;
+	float agent_step_interval = 0.5f; //seconds per agent move
+	float agent_step_timer = 0.0f;
+
 	struct {
 		bool slide_left=false;
 		bool slide_right=false;
 		bool slide_up=false;
 		bool slide_down=false;
+		int32_t roll_row=0; //shift+left/right: roll the cursor's row this many cells
+		int32_t roll_column=0; //shift+up/down: roll the cursor's column this many cells
 		bool reset=false;
 	} controls;
 
@@ -0,0 +1,117 @@
+#include "GhostJournal.hpp"
+
+#include "read_chunk.hpp"
+#include "write_chunk.hpp"
+#include "save_atomically.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+
+constexpr float GhostJournal::TickRate;
+
+namespace {
+	struct RunEntry {
+		int32_t start_x;
+		int32_t start_y;
+		uint32_t step_count;
+		uint32_t ticks;
+		uint32_t steps_begin;
+		uint32_t steps_end;
+	};
+	static_assert(sizeof(RunEntry) == 24, "RunEntry should be packed.");
+
+	void put_varint(std::vector< uint8_t > &to, uint32_t value) {
+		while (value >= 0x80) {
+			to.emplace_back(uint8_t(value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		to.emplace_back(uint8_t(value));
+	}
+}
+
+void GhostJournal::Run::step(Step const &s) {
+	bool small = (s.dx >= -1 && s.dx <= 1 && s.dy >= -1 && s.dy <= 1);
+	uint32_t move = (small ? uint32_t(s.dx + 1) + 3 * uint32_t(s.dy + 1) : 15);
+	uint32_t ticks_nibble = (s.ticks < 15 ? s.ticks : 15);
+	steps.emplace_back(uint8_t(move | (ticks_nibble << 4)));
+	if (!small) {
+		put_varint(steps, (uint32_t(s.dx) << 1) ^ uint32_t(s.dx >> 31)); //(zigzag: small magnitudes stay small)
+		put_varint(steps, (uint32_t(s.dy) << 1) ^ uint32_t(s.dy >> 31));
+	}
+	if (ticks_nibble == 15) put_varint(steps, s.ticks);
+	step_count += 1;
+	ticks += s.ticks;
+}
+
+void GhostJournal::load(std::string const &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open ghost journal '" + path + "'.");
+	}
+
+	std::vector< RunEntry > entries;
+	read_chunk(file, "gho0", &entries);
+	std::vector< uint8_t > steps;
+	read_chunk(file, "ghs0", &steps);
+
+	if (file.peek() != EOF) {
+		std::cerr << "WARNING: trailing data in ghost journal '" << path << "'." << std::endl;
+	}
+
+	std::vector< Run > runs_;
+	runs_.reserve(entries.size());
+	for (RunEntry const &e : entries) {
+		if (e.steps_begin > e.steps_end || e.steps_end > steps.size()) {
+			throw std::runtime_error("invalid step indices in ghost journal.");
+		}
+		//decode the whole run once here, so playback can trust it:
+		uint8_t const *at = steps.data() + e.steps_begin;
+		uint8_t const *end = steps.data() + e.steps_end;
+		uint32_t count = 0;
+		uint64_t ticks = 0;
+		while (at != end) {
+			Step s;
+			at = decode(at, end, &s);
+			if (!at) throw std::runtime_error("malformed steps in ghost journal.");
+			count += 1;
+			ticks += s.ticks;
+		}
+		if (count != e.step_count || ticks != e.ticks) {
+			throw std::runtime_error("ghost journal run doesn't match its step count or length.");
+		}
+		runs_.emplace_back();
+		Run &run = runs_.back();
+		run.start_x = e.start_x;
+		run.start_y = e.start_y;
+		run.step_count = e.step_count;
+		run.ticks = e.ticks;
+		run.steps.assign(steps.begin() + e.steps_begin, steps.begin() + e.steps_end);
+	}
+	runs = std::move(runs_);
+}
+
+void GhostJournal::save(std::string const &path) const {
+	std::vector< RunEntry > entries;
+	std::vector< uint8_t > steps;
+	entries.reserve(runs.size());
+	for (Run const &run : runs) {
+		if (steps.size() + run.steps.size() > 0xffffffffu) {
+			throw std::runtime_error("ghost journal too large to save.");
+		}
+		RunEntry e;
+		e.start_x = run.start_x;
+		e.start_y = run.start_y;
+		e.step_count = run.step_count;
+		e.ticks = run.ticks;
+		e.steps_begin = uint32_t(steps.size());
+		steps.insert(steps.end(), run.steps.begin(), run.steps.end());
+		e.steps_end = uint32_t(steps.size());
+		entries.emplace_back(e);
+	}
+
+	save_atomically(path, [&](std::ostream &file) {
+		write_chunk(file, "gho0", entries);
+		write_chunk(file, "ghs0", steps);
+	});
+}
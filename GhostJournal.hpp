@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A 'GhostJournal' holds recorded runs (where the player went, and when) for racing against as ghosts (see Ghosts.hpp).
+// Each run is a start cell plus a delta-encoded stream of steps. A step is a header byte, then (maybe) some varints:
+//   low nibble: the move; 0-8 is (dx, dy) = (m % 3 - 1, m / 3 - 1), 15 means dx and dy follow as zigzag varints
+//   high nibble: ticks since the previous step; 0-14 as is, 15 means the ticks follow as a varint (after any dx, dy)
+// So ordinary steps (one cell, within half a second of the last) take one byte.
+// The file is two chunks (see read_chunk.hpp / write_chunk.hpp):
+//   gho0: one entry per run (start, step count, length in ticks, range of step bytes)
+//   ghs0: the step bytes of every run
+
+struct GhostJournal {
+	static constexpr float TickRate = 30.0f; //ticks per second
+
+	struct Step {
+		uint32_t ticks = 0; //since the previous step (or the start of the run)
+		int32_t dx = 0;
+		int32_t dy = 0;
+	};
+
+	struct Run {
+		int32_t start_x = 0;
+		int32_t start_y = 0;
+		uint32_t step_count = 0;
+		uint32_t ticks = 0; //sum of every step's ticks
+		std::vector< uint8_t > steps; //encoded, as above
+
+		//add a step to the end of the run:
+		void step(Step const &step);
+	};
+	std::vector< Run > runs;
+
+	//decode the step at 'at' (reading no further than 'end'); returns just past it, or nullptr if the bytes are malformed:
+	static uint8_t const *decode(uint8_t const *at, uint8_t const *end, Step *step) {
+		if (at >= end) return nullptr;
+		uint8_t header = *(at++);
+		uint32_t move = header & 0xf;
+		uint32_t ticks = header >> 4;
+		if (move < 9) {
+			step->dx = int32_t(move % 3) - 1;
+			step->dy = int32_t(move / 3) - 1;
+		} else if (move == 15) {
+			uint32_t zx, zy;
+			if (!(at = varint(at, end, &zx)) || !(at = varint(at, end, &zy))) return nullptr;
+			step->dx = int32_t(zx >> 1) ^ -int32_t(zx & 1);
+			step->dy = int32_t(zy >> 1) ^ -int32_t(zy & 1);
+		} else {
+			return nullptr;
+		}
+		if (ticks == 15 && !(at = varint(at, end, &ticks))) return nullptr;
+		step->ticks = ticks;
+		return at;
+	}
+
+	//both throw on failure (load checks every run decodes to its step count and length, so playback needn't):
+	void load(std::string const &path);
+	void save(std::string const &path) const;
+
+private:
+	static uint8_t const *varint(uint8_t const *at, uint8_t const *end, uint32_t *value) {
+		uint32_t v = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7) {
+			if (at >= end) return nullptr;
+			uint8_t b = *(at++);
+			v |= uint32_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) {
+				*value = v;
+				return at;
+			}
+		}
+		return nullptr; //(longer than any 32-bit value)
+	}
+};
@@ -0,0 +1,102 @@
+#include "Ghosts.hpp"
+
+#include <algorithm>
+
+constexpr float Ghosts::SlideTime;
+
+void Ghosts::reset(GhostJournal const &journal) {
+	time = 0.0f;
+	tick = 0;
+
+	steps.clear();
+	size_t count = journal.runs.size();
+	next.assign(count, 0);
+	end.assign(count, 0);
+	due.assign(count, -1U);
+	pending_dx.assign(count, 0);
+	pending_dy.assign(count, 0);
+	x.assign(count, 0);
+	y.assign(count, 0);
+	last_dx.assign(count, 0);
+	last_dy.assign(count, 0);
+	last_time.assign(count, -SlideTime);
+	phase.assign(count, 0.0f);
+	stepping.assign(count, 0);
+
+	for (size_t i = 0; i < count; ++i) {
+		GhostJournal::Run const &run = journal.runs[i];
+		x[i] = run.start_x;
+		y[i] = run.start_y;
+		phase[i] = float((uint32_t(i) * 2654435761u) >> 16) * (6.2831853f / 65536.0f);
+		next[i] = uint32_t(steps.size());
+		steps.insert(steps.end(), run.steps.begin(), run.steps.end());
+		end[i] = uint32_t(steps.size());
+	}
+
+	//decode each ghost's first step:
+	uint8_t const *data = steps.data();
+	for (size_t i = 0; i < count; ++i) {
+		GhostJournal::Step s;
+		uint8_t const *at = (next[i] < end[i] ? GhostJournal::decode(data + next[i], data + end[i], &s) : nullptr);
+		if (!at) continue; //(no steps)
+		next[i] = uint32_t(at - data);
+		due[i] = std::min< uint32_t >(s.ticks, -2U);
+		pending_dx[i] = s.dx;
+		pending_dy[i] = s.dy;
+	}
+}
+
+void Ghosts::advance(float time_) {
+	time = time_;
+	tick = uint32_t(time * GhostJournal::TickRate);
+
+	//gather the ghosts with a step due:
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < uint32_t(due.size()); ++i) {
+		stepping[count] = i;
+		count += (due[i] <= tick ? 1 : 0);
+	}
+
+	uint8_t const *data = steps.data();
+	for (uint32_t s = 0; s < count; ++s) {
+		uint32_t i = stepping[s];
+		while (due[i] <= tick) {
+			x[i] += pending_dx[i];
+			y[i] += pending_dy[i];
+			last_dx[i] = pending_dx[i];
+			last_dy[i] = pending_dy[i];
+			last_time[i] = float(due[i]) / GhostJournal::TickRate;
+
+			//decode the step after it (runs were checked when the journal was loaded, so this only fails at the end):
+			GhostJournal::Step s;
+			uint8_t const *at = GhostJournal::decode(data + next[i], data + end[i], &s);
+			if (!at) {
+				due[i] = -1U;
+				break;
+			}
+			next[i] = uint32_t(at - data);
+			due[i] = uint32_t(std::min< uint64_t >(uint64_t(due[i]) + s.ticks, -2U)); //(-1U means "over")
+			pending_dx[i] = s.dx;
+			pending_dy[i] = s.dy;
+		}
+	}
+}
+
+void Ghosts::instances(std::vector< glm::vec4 > *out_) const {
+	out_->resize(size());
+	//(plain pointers, so the compiler needn't reload the vectors' data after every store through 'out'):
+	glm::vec4 *out = out_->data();
+	int32_t const *x_ = x.data(), *y_ = y.data(), *last_dx_ = last_dx.data(), *last_dy_ = last_dy.data();
+	float const *last_time_ = last_time.data(), *phase_ = phase.data();
+	float now = time;
+	for (size_t i = 0, n = size(); i < n; ++i) {
+		//how far the ghost still has to slide, from 1 (just stepped) to 0 (arrived):
+		float behind = std::max(0.0f, 1.0f - (now - last_time_[i]) * (1.0f / SlideTime));
+		out[i] = glm::vec4(
+			float(x_[i]) + 0.5f - behind * float(last_dx_[i]),
+			float(y_[i]) + 0.5f - behind * float(last_dy_[i]),
+			0.0f,
+			phase_[i]
+		);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "GhostJournal.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// 'Ghosts' races every run of a GhostJournal at once. Runs stay encoded (all their steps in one byte array), and each
+// ghost decodes its next step only when the race reaches it, so memory is the journal's size plus a few words per ghost.
+// State is kept as parallel arrays, one entry per ghost, so advance() and instances() are passes over contiguous data:
+// advance() first gathers the ghosts with a step due (without branching, since on any one frame most ghosts don't step)
+// and then only touches those; instances() is straight-line arithmetic per ghost.
+
+struct Ghosts {
+	//put every run of 'journal' at its start, at race time 0:
+	void reset(GhostJournal const &journal);
+
+	//advance the race clock to 'time' seconds, applying every step that has come due:
+	void advance(float time);
+
+	//one instance offset per ghost: its cell's center (sliding over from the previous cell just after a step), with a phase in w:
+	void instances(std::vector< glm::vec4 > *out) const;
+	static constexpr float SlideTime = 0.12f; //seconds a ghost takes to slide into a new cell
+
+	size_t size() const { return x.size(); }
+
+	//------- state -------
+
+	float time = 0.0f; //seconds since the race started
+	uint32_t tick = 0; //'time' in GhostJournal ticks
+
+	std::vector< uint8_t > steps; //every run's encoded steps, back to back
+
+	//per ghost:
+	std::vector< uint32_t > next; //offset in 'steps' of the step after the pending one
+	std::vector< uint32_t > end; //offset in 'steps' just past the ghost's last step
+	std::vector< uint32_t > due; //tick when the pending step happens (-1U once the run is over)
+	std::vector< int32_t > pending_dx, pending_dy; //the pending step (already decoded)
+	std::vector< int32_t > x, y; //current cell
+	std::vector< int32_t > last_dx, last_dy; //the most recent step (to slide along)
+	std::vector< float > last_time; //when the most recent step happened (seconds)
+	std::vector< float > phase; //for the hover animation (hashed from the index, so ghosts don't bob in lockstep)
+
+	std::vector< uint32_t > stepping; //(scratch for advance: ghosts with a step due)
+};
@@ -0,0 +1,86 @@
+#include "LevelPack.hpp"
+
+#include "read_chunk.hpp"
+#include "write_chunk.hpp"
+#include "save_atomically.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+	struct LevelEntry {
+		uint32_t width;
+		uint32_t height;
+		uint32_t start_x;
+		uint32_t start_y;
+		uint32_t tiles_begin;
+		uint32_t tiles_end;
+	};
+	static_assert(sizeof(LevelEntry) == 24, "LevelEntry should be packed.");
+}
+
+void LevelPack::load(std::string const &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open level pack '" + path + "'.");
+	}
+
+	std::vector< LevelEntry > entries;
+	read_chunk(file, "lvl0", &entries);
+	std::vector< uint8_t > tiles;
+	read_chunk(file, "til0", &tiles);
+
+	if (file.peek() != EOF) {
+		std::cerr << "WARNING: trailing data in level pack '" << path << "'." << std::endl;
+	}
+
+	levels.clear();
+	levels.reserve(entries.size());
+	for (LevelEntry const &e : entries) {
+		if (e.tiles_begin > e.tiles_end || e.tiles_end > tiles.size()
+		 || uint64_t(e.tiles_end - e.tiles_begin) != uint64_t(e.width) * uint64_t(e.height)) {
+			throw std::runtime_error("invalid tile indices in level pack.");
+		}
+		if (e.start_x >= e.width || e.start_y >= e.height) {
+			throw std::runtime_error("invalid start position in level pack.");
+		}
+		levels.emplace_back();
+		Level &level = levels.back();
+		level.width = e.width;
+		level.height = e.height;
+		level.start_x = e.start_x;
+		level.start_y = e.start_y;
+		level.tiles.reserve(e.tiles_end - e.tiles_begin);
+		for (uint32_t i = e.tiles_begin; i < e.tiles_end; ++i) {
+			if (tiles[i] >= TileCount) {
+				throw std::runtime_error("invalid tile type in level pack.");
+			}
+			level.tiles.emplace_back(Tile(tiles[i]));
+		}
+	}
+}
+
+void LevelPack::save(std::string const &path) const {
+	std::vector< LevelEntry > entries;
+	std::vector< uint8_t > tiles;
+	for (Level const &level : levels) {
+		if (level.tiles.size() != size_t(level.width) * size_t(level.height)) {
+			throw std::runtime_error("level tiles don't match level size.");
+		}
+		LevelEntry e;
+		e.width = level.width;
+		e.height = level.height;
+		e.start_x = level.start_x;
+		e.start_y = level.start_y;
+		e.tiles_begin = uint32_t(tiles.size());
+		tiles.insert(tiles.end(), level.tiles.begin(), level.tiles.end());
+		e.tiles_end = uint32_t(tiles.size());
+		entries.emplace_back(e);
+	}
+
+	save_atomically(path, [&](std::ostream &file) {
+		write_chunk(file, "lvl0", entries);
+		write_chunk(file, "til0", tiles);
+	});
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "tiles.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A 'LevelPack' is a list of hand-made (or hand-edited) boards stored in one binary file.
+// The file is two chunks (see read_chunk.hpp / write_chunk.hpp):
+//   lvl0: one entry per level (size, start cell, range of tiles)
+//   til0: the tiles of every level, one byte per cell, row-major
+// The goal is stored as a TileGoal tile.
+
+struct LevelPack {
+	struct Level {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t start_x = 0;
+		uint32_t start_y = 0;
+		std::vector< Tile > tiles; //width * height, row-major
+	};
+	std::vector< Level > levels;
+
+	//both throw on failure:
+	void load(std::string const &path);
+	void save(std::string const &path) const;
+};
@@ -0,0 +1,321 @@
+#include "RenderGraph.hpp"
+
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+static bool is_depth_format(GLenum internal_format) {
+	return internal_format == GL_DEPTH_COMPONENT16
+	    || internal_format == GL_DEPTH_COMPONENT24
+	    || internal_format == GL_DEPTH_COMPONENT32F
+	    || internal_format == GL_DEPTH24_STENCIL8
+	    || internal_format == GL_DEPTH32F_STENCIL8;
+}
+
+static bool is_depth_stencil_format(GLenum internal_format) {
+	return internal_format == GL_DEPTH24_STENCIL8 || internal_format == GL_DEPTH32F_STENCIL8;
+}
+
+//pixel format and type to pass along with 'internal_format' when allocating storage
+// (no data is uploaded, but the GL still checks that the combination is legal); 'integer' formats can't be filtered:
+struct PixelTransfer {
+	GLenum format;
+	GLenum type;
+	bool integer;
+};
+static PixelTransfer pixel_transfer(GLenum internal_format) {
+	switch (internal_format) {
+		case GL_DEPTH_COMPONENT16:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F: return PixelTransfer{GL_DEPTH_COMPONENT, GL_FLOAT, false};
+		case GL_DEPTH24_STENCIL8: return PixelTransfer{GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, false};
+		case GL_DEPTH32F_STENCIL8: return PixelTransfer{GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, false};
+
+		case GL_R8UI: case GL_R16UI: case GL_R32UI: return PixelTransfer{GL_RED_INTEGER, GL_UNSIGNED_INT, true};
+		case GL_R8I: case GL_R16I: case GL_R32I: return PixelTransfer{GL_RED_INTEGER, GL_INT, true};
+		case GL_RG8UI: case GL_RG16UI: case GL_RG32UI: return PixelTransfer{GL_RG_INTEGER, GL_UNSIGNED_INT, true};
+		case GL_RG8I: case GL_RG16I: case GL_RG32I: return PixelTransfer{GL_RG_INTEGER, GL_INT, true};
+		case GL_RGB8UI: case GL_RGB16UI: case GL_RGB32UI: return PixelTransfer{GL_RGB_INTEGER, GL_UNSIGNED_INT, true};
+		case GL_RGB8I: case GL_RGB16I: case GL_RGB32I: return PixelTransfer{GL_RGB_INTEGER, GL_INT, true};
+		case GL_RGBA8UI: case GL_RGBA16UI: case GL_RGBA32UI: case GL_RGB10_A2UI: return PixelTransfer{GL_RGBA_INTEGER, GL_UNSIGNED_INT, true};
+		case GL_RGBA8I: case GL_RGBA16I: case GL_RGBA32I: return PixelTransfer{GL_RGBA_INTEGER, GL_INT, true};
+
+		case GL_R8: case GL_R16F: case GL_R32F: return PixelTransfer{GL_RED, GL_FLOAT, false};
+		case GL_RG8: case GL_RG16F: case GL_RG32F: return PixelTransfer{GL_RG, GL_FLOAT, false};
+		case GL_RGB8: case GL_SRGB8: case GL_RGB16F: case GL_RGB32F: case GL_R11F_G11F_B10F: return PixelTransfer{GL_RGB, GL_FLOAT, false};
+		default: return PixelTransfer{GL_RGBA, GL_UNSIGNED_BYTE, false}; //(normalized and float color formats accept any of these)
+	}
+}
+
+RenderGraph::~RenderGraph() {
+	for (auto const &f : framebuffers) {
+		glDeleteFramebuffers(1, &f.second);
+	}
+	framebuffers.clear();
+	for (auto const &p : pool) {
+		glDeleteTextures(1, &p.texture);
+	}
+	pool.clear();
+}
+
+void RenderGraph::begin_frame() {
+	resources.clear();
+	passes.clear();
+}
+
+RenderGraph::Resource RenderGraph::backbuffer(glm::uvec2 size) {
+	ResourceInfo info;
+	info.name = "backbuffer";
+	info.kind = ResourceInfo::Backbuffer;
+	info.size = size;
+	resources.emplace_back(info);
+	return Resource(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::import_texture(std::string const &name, GLuint texture_, GLenum target, GLenum internal_format, glm::uvec2 size) {
+	ResourceInfo info;
+	info.name = name;
+	info.kind = ResourceInfo::Imported;
+	info.target = target;
+	info.internal_format = internal_format;
+	info.size = size;
+	info.texture = texture_;
+	resources.emplace_back(info);
+	return Resource(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::create_texture(std::string const &name, GLenum internal_format, glm::uvec2 size) {
+	ResourceInfo info;
+	info.name = name;
+	info.kind = ResourceInfo::Transient;
+	info.internal_format = internal_format;
+	info.size = size;
+	resources.emplace_back(info);
+	return Resource(resources.size() - 1);
+}
+
+RenderGraph::Pass &RenderGraph::Pass::read(Resource r) {
+	reads.emplace_back(r);
+	return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::write(Resource r, GLint layer) {
+	writes.emplace_back(r, layer);
+	return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::clear(GLbitfield mask, glm::vec4 const &color, float depth) {
+	clear_mask = mask;
+	clear_color = color;
+	clear_depth = depth;
+	return *this;
+}
+
+RenderGraph::Pass &RenderGraph::add_pass(std::string const &name, std::function< void() > const &run) {
+	passes.emplace_back();
+	passes.back().name = name;
+	passes.back().run = run;
+	return passes.back();
+}
+
+GLuint RenderGraph::texture(Resource r) const {
+	assert(r < resources.size());
+	return resources[r].texture;
+}
+
+GLuint RenderGraph::framebuffer(Resource r) {
+	assert(r < resources.size());
+	if (resources[r].kind == ResourceInfo::Backbuffer) return 0;
+	return framebuffer_for({ std::make_pair(r, 0) });
+}
+
+void RenderGraph::execute() {
+	//(1) cull: walking backward, a pass is needed if it writes something permanent or something a needed pass reads:
+	std::vector< bool > wanted(resources.size(), false);
+	for (uint32_t i = uint32_t(passes.size()) - 1; i < passes.size(); --i) {
+		Pass &pass = passes[i];
+		bool needed = false;
+		for (auto const &w : pass.writes) {
+			if (resources[w.first].kind != ResourceInfo::Transient || wanted[w.first]) needed = true;
+		}
+		pass.culled = !needed;
+		if (!needed) continue;
+		for (Resource r : pass.reads) wanted[r] = true;
+	}
+
+	//(2) lifetimes, as ranges of passes:
+	for (uint32_t i = 0; i < passes.size(); ++i) {
+		Pass const &pass = passes[i];
+		if (pass.culled) continue;
+		auto use = [&](Resource r) {
+			resources[r].first_use = std::min(resources[r].first_use, i);
+			resources[r].last_use = std::max(resources[r].last_use, i);
+		};
+		for (Resource r : pass.reads) use(r);
+		for (auto const &w : pass.writes) use(w.first);
+	}
+
+	//(3) assign pool textures to transients; a texture goes back to the pool after its resource's last use,
+	// so a later resource of the same size and format can alias it:
+	for (auto &p : pool) p.used = false;
+	std::vector< bool > busy(pool.size(), false);
+	for (uint32_t i = 0; i < passes.size(); ++i) {
+		for (Resource r = 0; r < resources.size(); ++r) {
+			ResourceInfo &info = resources[r];
+			if (info.kind != ResourceInfo::Transient || info.first_use != i) continue;
+			uint32_t found = -1U;
+			for (uint32_t p = 0; p < pool.size(); ++p) {
+				if (!busy[p] && pool[p].internal_format == info.internal_format && pool[p].size == info.size) {
+					found = p;
+					break;
+				}
+			}
+			if (found == -1U) {
+				PoolTexture p;
+				p.internal_format = info.internal_format;
+				p.size = info.size;
+				glGenTextures(1, &p.texture);
+				glBindTexture(GL_TEXTURE_2D, p.texture);
+				PixelTransfer transfer = pixel_transfer(p.internal_format);
+				glTexImage2D(GL_TEXTURE_2D, 0, p.internal_format, p.size.x, p.size.y, 0, transfer.format, transfer.type, nullptr);
+				GLint filter = (transfer.integer ? GL_NEAREST : GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				found = uint32_t(pool.size());
+				pool.emplace_back(p);
+				busy.emplace_back(false);
+			}
+			busy[found] = true;
+			pool[found].used = true;
+			info.texture = pool[found].texture;
+		}
+		for (Resource r = 0; r < resources.size(); ++r) {
+			ResourceInfo const &info = resources[r];
+			if (info.kind != ResourceInfo::Transient || info.first_use == -1U || info.last_use != i) continue;
+			for (uint32_t p = 0; p < pool.size(); ++p) {
+				if (pool[p].texture == info.texture) busy[p] = false;
+			}
+		}
+	}
+
+	//pool textures this frame didn't need (e.g. the old size, after a resize) are freed:
+	for (uint32_t p = 0; p < pool.size(); /* later */) {
+		if (pool[p].used) {
+			++p;
+		} else {
+			free_texture(pool[p].texture);
+			pool.erase(pool.begin() + p);
+		}
+	}
+
+	//(4) run:
+	passes_run = 0;
+	passes_culled = 0;
+	for (Pass const &pass : passes) {
+		if (pass.culled) {
+			++passes_culled;
+			continue;
+		}
+		++passes_run;
+		glm::uvec2 size = glm::uvec2(0);
+		if (!pass.writes.empty()) {
+			ResourceInfo const &first = resources[pass.writes[0].first];
+			size = first.size;
+			if (first.kind == ResourceInfo::Backbuffer) {
+				if (pass.writes.size() != 1) {
+					throw std::runtime_error("Pass '" + pass.name + "' writes the backbuffer along with other textures.");
+				}
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			} else {
+				glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_for(pass.writes));
+			}
+			glViewport(0, 0, size.x, size.y);
+		}
+		if (pass.clear_mask) {
+			glClearColor(pass.clear_color.x, pass.clear_color.y, pass.clear_color.z, pass.clear_color.w);
+			glClearDepth(pass.clear_depth);
+			glClear(pass.clear_mask);
+		}
+		pass.run();
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	GL_ERRORS();
+}
+
+GLuint RenderGraph::framebuffer_for(std::vector< std::pair< Resource, GLint > > const &attachments) {
+	//key: colors (in order), then depth:
+	std::vector< std::pair< GLuint, GLint > > key;
+	std::vector< std::pair< Resource, GLint > > colors, depths;
+	for (auto const &a : attachments) {
+		(is_depth_format(resources[a.first].internal_format) ? depths : colors).emplace_back(a);
+	}
+	if (depths.size() > 1) throw std::runtime_error("Can't attach more than one depth texture to a framebuffer.");
+	for (auto const &a : colors) key.emplace_back(resources[a.first].texture, a.second);
+	for (auto const &a : depths) key.emplace_back(resources[a.first].texture, a.second);
+
+	auto f = framebuffers.find(key);
+	if (f != framebuffers.end()) return f->second;
+
+	GLint old_binding = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_binding);
+
+	GLuint fb = 0;
+	glGenFramebuffers(1, &fb);
+	glBindFramebuffer(GL_FRAMEBUFFER, fb);
+	auto attach = [&](GLenum point, std::pair< Resource, GLint > const &a) {
+		ResourceInfo const &info = resources[a.first];
+		if (info.target == GL_TEXTURE_2D_ARRAY) {
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, point, info.texture, 0, a.second);
+		} else {
+			glFramebufferTexture2D(GL_FRAMEBUFFER, point, GL_TEXTURE_2D, info.texture, 0);
+		}
+	};
+	std::vector< GLenum > draw_buffers;
+	for (auto const &a : colors) {
+		draw_buffers.emplace_back(GLenum(GL_COLOR_ATTACHMENT0 + draw_buffers.size()));
+		attach(draw_buffers.back(), a);
+	}
+	for (auto const &a : depths) {
+		attach(is_depth_stencil_format(resources[a.first].internal_format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, a);
+	}
+	if (draw_buffers.empty()) {
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	} else {
+		glDrawBuffers(GLsizei(draw_buffers.size()), draw_buffers.data());
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::string names;
+		for (auto const &a : attachments) names += (names.empty() ? "" : ", ") + resources[a.first].name;
+		glBindFramebuffer(GL_FRAMEBUFFER, GLuint(old_binding));
+		glDeleteFramebuffers(1, &fb);
+		throw std::runtime_error("Render graph framebuffer for " + names + " is incomplete.");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, GLuint(old_binding));
+
+	framebuffers.insert(std::make_pair(key, fb));
+	return fb;
+}
+
+void RenderGraph::free_texture(GLuint texture_) {
+	for (auto f = framebuffers.begin(); f != framebuffers.end(); /* later */) {
+		bool uses = false;
+		for (auto const &a : f->first) {
+			if (a.first == texture_) uses = true;
+		}
+		if (uses) {
+			glDeleteFramebuffers(1, &f->second);
+			f = framebuffers.erase(f);
+		} else {
+			++f;
+		}
+	}
+	glDeleteTextures(1, &texture_);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+
+// 'RenderGraph' runs a frame as a list of passes, each declaring the textures it reads and writes.
+// Every frame, the owner declares resources and passes (in the order they should run) and calls execute(), which:
+//  - culls passes whose outputs are never used (writing the backbuffer or an imported texture counts as a use),
+//  - assigns transient textures from a pool, so textures whose lifetimes don't overlap share one GL texture,
+//  - binds a (cached) framebuffer for each pass's outputs, sets the viewport, and clears only what the pass asks for.
+// Pool textures and framebuffers persist between frames; a pool texture is only freed (and a new one made)
+// when a frame no longer needs a texture of its size and format, e.g. after the window is resized.
+
+struct RenderGraph {
+	RenderGraph() = default;
+	~RenderGraph();
+	RenderGraph(RenderGraph const &) = delete;
+	RenderGraph &operator=(RenderGraph const &) = delete;
+
+	typedef uint32_t Resource;
+
+	//------- per-frame declarations -------
+
+	//forget the previous frame's resources and passes:
+	void begin_frame();
+
+	//the default framebuffer (color + depth):
+	Resource backbuffer(glm::uvec2 size);
+
+	//a texture owned by someone else (kept up to date across frames, so writing it always counts as a use);
+	// 'target' is GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY:
+	Resource import_texture(std::string const &name, GLuint texture, GLenum target, GLenum internal_format, glm::uvec2 size);
+
+	//a texture that only lives for part of this frame:
+	Resource create_texture(std::string const &name, GLenum internal_format, glm::uvec2 size);
+
+	struct Pass {
+		//declare an input (only used for culling and lifetimes; the pass binds what it reads itself):
+		Pass &read(Resource r);
+		//declare an output, attached as color, depth, or depth-stencil based on its format ('layer' selects a layer of an array texture):
+		Pass &write(Resource r, GLint layer = 0);
+		//clear these buffers of the outputs before running:
+		Pass &clear(GLbitfield mask, glm::vec4 const &color = glm::vec4(0.0f), float depth = 1.0f);
+
+		std::string name;
+		std::function< void() > run;
+		std::vector< Resource > reads;
+		std::vector< std::pair< Resource, GLint > > writes;
+		GLbitfield clear_mask = 0;
+		glm::vec4 clear_color = glm::vec4(0.0f);
+		float clear_depth = 1.0f;
+		bool culled = false;
+	};
+	//add a pass (returns a reference for declaring its inputs and outputs, valid until the next add_pass):
+	Pass &add_pass(std::string const &name, std::function< void() > const &run);
+
+	//cull, allocate, and run the passes:
+	void execute();
+
+	//------- used by passes -------
+
+	//the GL texture behind a resource (valid while passes run):
+	GLuint texture(Resource r) const;
+	//a framebuffer with just 'r' attached (e.g. to read from with glBlitFramebuffer); 0 for the backbuffer:
+	GLuint framebuffer(Resource r);
+
+	//------- state -------
+
+	struct ResourceInfo {
+		std::string name;
+		enum Kind { Backbuffer, Imported, Transient } kind = Transient;
+		GLenum target = GL_TEXTURE_2D;
+		GLenum internal_format = GL_RGBA8;
+		glm::uvec2 size = glm::uvec2(0);
+		GLuint texture = 0; //(for transients: assigned by execute)
+		uint32_t first_use = -1U, last_use = 0; //range of (unculled) passes using the resource
+	};
+	std::vector< ResourceInfo > resources;
+	std::vector< Pass > passes;
+
+	//transient texture pool:
+	struct PoolTexture {
+		GLuint texture = 0;
+		GLenum internal_format = GL_RGBA8;
+		glm::uvec2 size = glm::uvec2(0);
+		bool used = false; //assigned to some resource this frame
+	};
+	std::vector< PoolTexture > pool;
+
+	//framebuffers, by attachments ((texture, layer) pairs, colors first, depth last):
+	std::map< std::vector< std::pair< GLuint, GLint > >, GLuint > framebuffers;
+
+	//what execute() did last frame (for stats and debugging):
+	uint32_t passes_run = 0;
+	uint32_t passes_culled = 0;
+
+private:
+	GLuint framebuffer_for(std::vector< std::pair< Resource, GLint > > const &attachments);
+	void free_texture(GLuint texture); //(and any framebuffers using it)
+};
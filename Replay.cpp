@@ -0,0 +1,225 @@
+#include "Replay.hpp"
+
+#include "read_chunk.hpp"
+#include "write_chunk.hpp"
+#include "save_atomically.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+#include <cassert>
+
+namespace {
+	struct ReplayHeader {
+		uint32_t width;
+		uint32_t height;
+		uint32_t interval;
+		uint32_t keyframe_count;
+	};
+	static_assert(sizeof(ReplayHeader) == 16, "ReplayHeader should be packed.");
+
+	struct KeyframeEntry {
+		uint64_t move;
+		uint32_t cursor_x;
+		uint32_t cursor_y;
+		int32_t star_points;
+		int32_t hole_points;
+		uint32_t flags; //bit 0: star_flag, bit 1: hole_flag
+		uint32_t tiles_begin;
+		uint32_t tiles_end;
+		uint32_t agents_begin;
+		uint32_t agents_end;
+		uint32_t padding;
+	};
+	static_assert(sizeof(KeyframeEntry) == 48, "KeyframeEntry should be packed.");
+
+	struct TileEntry {
+		uint32_t x;
+		uint32_t y;
+		uint8_t tile; //(never TileFloor)
+		uint8_t padding[3];
+	};
+	static_assert(sizeof(TileEntry) == 12, "TileEntry should be packed.");
+
+	struct AgentEntry {
+		uint32_t x;
+		uint32_t y;
+		uint8_t dir;
+		uint8_t padding[3];
+	};
+	static_assert(sizeof(AgentEntry) == 12, "AgentEntry should be packed.");
+}
+
+uint32_t Replay::keyframe_before(uint64_t move) const {
+	assert(!keyframes.empty());
+	auto after = std::upper_bound(keyframes.begin(), keyframes.end(), move, [](uint64_t m, Keyframe const &k) {
+		return m < k.move;
+	});
+	return uint32_t(after - keyframes.begin()) - 1;
+}
+
+void Replay::load(std::string const &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open replay '" + path + "'.");
+	}
+
+	std::vector< ReplayHeader > header;
+	read_chunk(file, "rpl0", &header);
+	std::vector< Move > moves_;
+	read_chunk(file, "mov0", &moves_);
+	std::vector< KeyframeEntry > entries;
+	read_chunk(file, "key1", &entries);
+	std::vector< TileEntry > tiles;
+	read_chunk(file, "til1", &tiles);
+	std::vector< AgentEntry > agents;
+	read_chunk(file, "agt0", &agents);
+
+	if (file.peek() != EOF) {
+		std::cerr << "WARNING: trailing data in replay '" << path << "'." << std::endl;
+	}
+
+	if (header.size() != 1 || header[0].width == 0 || header[0].height == 0 || header[0].keyframe_count != entries.size()) {
+		throw std::runtime_error("invalid header in replay.");
+	}
+	uint32_t w = header[0].width, h = header[0].height;
+	uint64_t cells = uint64_t(w) * uint64_t(h);
+	for (Move const &m : moves_) {
+		if (m.kind >= Move::KindCount) throw std::runtime_error("invalid move in replay.");
+		if (m.kind == Move::Paint && (m.arg >= TileCount || uint64_t(uint32_t(m.value)) >= cells)) {
+			throw std::runtime_error("invalid paint move in replay.");
+		}
+	}
+	if (entries.empty() || entries[0].move != 0) {
+		throw std::runtime_error("replay doesn't start with a keyframe.");
+	}
+
+	std::vector< Keyframe > keyframes_;
+	keyframes_.reserve(entries.size());
+	std::vector< SparseTiles::Feature > line;
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		KeyframeEntry const &e = entries[i];
+		if ((i > 0 && e.move <= entries[i-1].move) || e.move > moves_.size()) {
+			throw std::runtime_error("keyframes out of order in replay.");
+		}
+		if (e.tiles_begin > e.tiles_end || e.tiles_end > tiles.size()) {
+			throw std::runtime_error("invalid tile indices in replay.");
+		}
+		if (e.agents_begin > e.agents_end || e.agents_end > agents.size()) {
+			throw std::runtime_error("invalid agent indices in replay.");
+		}
+		if (e.cursor_x >= w || e.cursor_y >= h) {
+			throw std::runtime_error("invalid cursor in replay.");
+		}
+		keyframes_.emplace_back();
+		Keyframe &k = keyframes_.back();
+		k.move = e.move;
+		k.cursor_x = e.cursor_x;
+		k.cursor_y = e.cursor_y;
+		k.star_points = e.star_points;
+		k.hole_points = e.hole_points;
+		k.star_flag = (e.flags & 1) != 0;
+		k.hole_flag = (e.flags & 2) != 0;
+		//features come a row at a time (strictly row-major, which also rules out repeated cells):
+		k.tiles.clear(w, h);
+		for (uint32_t t = e.tiles_begin; t < e.tiles_end; ) {
+			uint32_t y = tiles[t].y;
+			line.clear();
+			for (; t < e.tiles_end && tiles[t].y == y; ++t) {
+				TileEntry const &f = tiles[t];
+				if (f.x >= w || f.y >= h || f.tile == TileFloor || f.tile >= TileCount) {
+					throw std::runtime_error("invalid tile in replay.");
+				}
+				if (!line.empty() && f.x <= line.back().at) {
+					throw std::runtime_error("keyframe tiles out of order in replay.");
+				}
+				line.emplace_back(SparseTiles::Feature{f.x, Tile(f.tile), -1U});
+			}
+			if (t < e.tiles_end && tiles[t].y < y) {
+				throw std::runtime_error("keyframe tiles out of order in replay.");
+			}
+			k.tiles.write_row_features(y, line);
+		}
+		for (uint32_t a = e.agents_begin; a < e.agents_end; ++a) {
+			if (agents[a].x >= w || agents[a].y >= h || agents[a].dir >= 4) {
+				throw std::runtime_error("invalid agent in replay.");
+			}
+			k.agent_x.emplace_back(agents[a].x);
+			k.agent_y.emplace_back(agents[a].y);
+			k.agent_dir.emplace_back(agents[a].dir);
+		}
+	}
+
+	width = w;
+	height = h;
+	interval = std::max(1u, header[0].interval);
+	moves = std::move(moves_);
+	keyframes = std::move(keyframes_);
+}
+
+void Replay::save(std::string const &path) const {
+	std::vector< ReplayHeader > header(1);
+	header[0].width = width;
+	header[0].height = height;
+	header[0].interval = interval;
+	header[0].keyframe_count = uint32_t(keyframes.size());
+
+	std::vector< KeyframeEntry > entries;
+	std::vector< TileEntry > tiles;
+	std::vector< AgentEntry > agents;
+	std::vector< SparseTiles::Feature > line;
+	entries.reserve(keyframes.size());
+	for (Keyframe const &k : keyframes) {
+		if (k.tiles.width != width || k.tiles.height != height) {
+			throw std::runtime_error("keyframe tiles don't match replay size.");
+		}
+		if (k.agent_y.size() != k.agent_x.size() || k.agent_dir.size() != k.agent_x.size()) {
+			throw std::runtime_error("keyframe agent columns don't match.");
+		}
+		//(a chunk's size is 32 bits)
+		if ((tiles.size() + k.tiles.features) * sizeof(TileEntry) > 0xffffffffu) {
+			throw std::runtime_error("replay keyframes too large to save (try a longer keyframe interval).");
+		}
+		KeyframeEntry e;
+		e.move = k.move;
+		e.cursor_x = k.cursor_x;
+		e.cursor_y = k.cursor_y;
+		e.star_points = k.star_points;
+		e.hole_points = k.hole_points;
+		e.flags = (k.star_flag ? 1 : 0) | (k.hole_flag ? 2 : 0);
+		e.tiles_begin = uint32_t(tiles.size());
+		for (uint32_t y = 0; y < height; ++y) {
+			k.tiles.row_features(y, &line);
+			for (SparseTiles::Feature const &f : line) {
+				TileEntry tile;
+				tile.x = f.at;
+				tile.y = y;
+				tile.tile = f.type;
+				tile.padding[0] = tile.padding[1] = tile.padding[2] = 0;
+				tiles.emplace_back(tile);
+			}
+		}
+		e.tiles_end = uint32_t(tiles.size());
+		e.agents_begin = uint32_t(agents.size());
+		for (size_t a = 0; a < k.agent_x.size(); ++a) {
+			AgentEntry agent;
+			agent.x = k.agent_x[a];
+			agent.y = k.agent_y[a];
+			agent.dir = k.agent_dir[a];
+			agent.padding[0] = agent.padding[1] = agent.padding[2] = 0;
+			agents.emplace_back(agent);
+		}
+		e.agents_end = uint32_t(agents.size());
+		e.padding = 0;
+		entries.emplace_back(e);
+	}
+
+	save_atomically(path, [&](std::ostream &file) {
+		write_chunk(file, "rpl0", header);
+		write_chunk(file, "mov0", moves);
+		write_chunk(file, "key1", entries);
+		write_chunk(file, "til1", tiles);
+		write_chunk(file, "agt0", agents);
+	});
+}
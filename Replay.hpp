@@ -0,0 +1,70 @@
+#pragma once
+
+#include "SparseTiles.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A 'Replay' is a recorded session: every move that changed the game, in order, plus a keyframe
+// (the full game state) every 'interval' moves. Any move can be reached by restoring the last keyframe
+// before it (found by binary search) and re-applying at most 'interval' moves (see Game::seek).
+// The file is five chunks (see read_chunk.hpp / write_chunk.hpp):
+//   rpl0: board size and keyframe interval (one entry)
+//   mov0: the moves
+//   key1: one entry per keyframe (move index, cursor, scores, ranges of tiles and agents)
+//   til1: the features (cells that aren't floor) of every keyframe, as (x, y, tile), row-major within a keyframe
+// so keyframes, in memory and on disk, grow with the board's features rather than its area.
+//   agt0: the agents of every keyframe
+// There is no random number state to store: board generation uses counter-based random numbers (see philox.hpp)
+// only during setup, and everything after that is deterministic given the moves.
+
+struct Replay {
+	struct Move {
+		enum Kind : uint8_t {
+			Slide = 0, //player moves in direction 'arg' (an Agents::Dir)
+			Roll = 1, //player's row ('arg' == 0) or column ('arg' == 1) rolls by 'value' cells
+			AgentStep = 2, //every agent steps
+			Paint = 3, //editor paints tile 'arg' into cell 'value'
+			KindCount //(not a move; number of kinds)
+		};
+		Kind kind = AgentStep;
+		uint8_t arg = 0;
+		uint16_t padding = 0;
+		int32_t value = 0;
+	};
+	static_assert(sizeof(Move) == 8, "Move should be packed.");
+
+	//game state before moves[move] (i.e. after moves [0, move) have been applied):
+	struct Keyframe {
+		uint64_t move = 0;
+		uint32_t cursor_x = 0;
+		uint32_t cursor_y = 0;
+		int32_t star_points = 0;
+		int32_t hole_points = 0;
+		bool star_flag = false;
+		bool hole_flag = false;
+		SparseTiles tiles; //width by height (slots are left over from the board; Board::reset assigns new ones)
+		std::vector< uint32_t > agent_x;
+		std::vector< uint32_t > agent_y;
+		std::vector< uint8_t > agent_dir;
+	};
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t interval = 1024; //moves between keyframes
+	std::vector< Move > moves;
+	std::vector< Keyframe > keyframes; //in order of 'move'; keyframes[0].move is 0
+
+	//should a keyframe be recorded now (before any more moves are added)?
+	bool keyframe_due() const {
+		return keyframes.empty() || moves.size() - keyframes.back().move >= interval;
+	}
+
+	//index of the last keyframe at or before 'move' (there must be at least one keyframe):
+	uint32_t keyframe_before(uint64_t move) const;
+
+	//both throw on failure:
+	void load(std::string const &path);
+	void save(std::string const &path) const;
+};
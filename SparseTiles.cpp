@@ -0,0 +1,417 @@
+#include "SparseTiles.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+constexpr uint32_t SparseTiles::ChunkSize;
+
+//chunks go dense past half full, and back to sparse under a quarter full (the gap keeps edits near one threshold from flipping a chunk back and forth):
+static constexpr uint32_t DenseAbove = SparseTiles::ChunkSize * SparseTiles::ChunkSize / 2;
+static constexpr uint32_t SparseBelow = SparseTiles::ChunkSize * SparseTiles::ChunkSize / 4;
+
+void SparseTiles::reset(uint32_t width_, uint32_t height_, std::vector< Tile > const &tiles) {
+	if (tiles.size() != size_t(width_) * size_t(height_)) {
+		throw std::runtime_error("SparseTiles tiles don't match grid size.");
+	}
+	clear(width_, height_);
+
+	std::vector< uint32_t > no_slots(width, -1U);
+	for (uint32_t y = 0; y < height; ++y) {
+		write_row(y, tiles.data() + size_t(y) * width, no_slots.data());
+	}
+}
+
+void SparseTiles::clear(uint32_t width_, uint32_t height_) {
+	width = width_;
+	height = height_;
+	features = 0;
+	chunks_x = (width + ChunkSize - 1) / ChunkSize;
+	chunk_at.assign(size_t(chunks_x) * ((height + ChunkSize - 1) / ChunkSize), -1U);
+	chunks.clear();
+	free_chunks.clear();
+}
+
+void SparseTiles::set(uint32_t x, uint32_t y, Tile t, uint32_t slot) {
+	assert(x < width && y < height);
+	uint32_t position = (y / ChunkSize) * chunks_x + x / ChunkSize;
+	uint32_t cx = x % ChunkSize, cy = y % ChunkSize;
+	uint32_t i = (chunk_at[position] == -1U ? -1U : chunks[chunk_at[position]].find(cx, cy));
+	bool was = (i != -1U);
+	bool now = (t != TileFloor);
+	if (!was && !now) return;
+
+	Chunk &c = (chunk_at[position] == -1U ? allocate(position) : chunks[chunk_at[position]]);
+	if (was && now) {
+		c.types[i] = t;
+		c.slots[i] = slot;
+		return;
+	}
+
+	if (c.dense) {
+		i = cy * ChunkSize + cx;
+		c.types[i] = t;
+		c.slots[i] = (now ? slot : -1U);
+	} else if (now) {
+		uint32_t r = c.row_rank(cy);
+		if (!((c.occupied >> cy) & 1)) {
+			//first feature in this row:
+			uint16_t begin = c.row_begin[r];
+			c.rows.insert(c.rows.begin() + r, 0);
+			c.row_begin.insert(c.row_begin.begin() + r, begin);
+			c.occupied |= uint64_t(1) << cy;
+		}
+		i = c.row_begin[r] + popcount(c.rows[r] & below(cx));
+		c.types.insert(c.types.begin() + i, t);
+		c.slots.insert(c.slots.begin() + i, slot);
+		c.rows[r] |= uint64_t(1) << cx;
+		for (uint32_t j = r + 1; j < c.row_begin.size(); ++j) c.row_begin[j] += 1;
+	} else {
+		uint32_t r = c.row_rank(cy);
+		c.types.erase(c.types.begin() + i);
+		c.slots.erase(c.slots.begin() + i);
+		c.rows[r] &= ~(uint64_t(1) << cx);
+		for (uint32_t j = r + 1; j < c.row_begin.size(); ++j) c.row_begin[j] -= 1;
+		if (c.rows[r] == 0) {
+			//last feature in this row:
+			c.rows.erase(c.rows.begin() + r);
+			c.row_begin.erase(c.row_begin.begin() + r);
+			c.occupied &= ~(uint64_t(1) << cy);
+		}
+	}
+
+	if (now) {
+		c.count += 1;
+		features += 1;
+	} else {
+		c.count -= 1;
+		features -= 1;
+	}
+	update_density(position);
+}
+
+void SparseTiles::set_slot(uint32_t x, uint32_t y, uint32_t slot) {
+	Chunk &c = chunks[chunk_at[(y / ChunkSize) * chunks_x + x / ChunkSize]];
+	uint32_t i = c.find(x % ChunkSize, y % ChunkSize);
+	assert(i != -1U);
+	c.slots[i] = slot;
+}
+
+void SparseTiles::read_row(uint32_t x, uint32_t y, uint32_t count, Tile *tiles, uint32_t *slots) const {
+	assert(x + count <= width && y < height);
+	uint32_t cy = y % ChunkSize;
+	uint32_t end = x + count;
+	while (x < end) {
+		//the part of the row in one chunk:
+		uint32_t cx = x % ChunkSize;
+		uint32_t n = std::min(ChunkSize - cx, end - x);
+		Chunk const *c = chunk(x, y);
+		if (!c) {
+			std::fill(tiles, tiles + n, TileFloor);
+			if (slots) std::fill(slots, slots + n, -1U);
+		} else if (c->dense) {
+			uint32_t i = cy * ChunkSize + cx;
+			std::copy(c->types.begin() + i, c->types.begin() + i + n, tiles);
+			if (slots) std::copy(c->slots.begin() + i, c->slots.begin() + i + n, slots);
+		} else {
+			uint64_t bits = 0;
+			uint32_t i = 0;
+			if ((c->occupied >> cy) & 1) {
+				uint32_t r = c->row_rank(cy);
+				bits = c->rows[r];
+				i = c->row_begin[r] + popcount(bits & below(cx));
+			}
+			for (uint32_t k = 0; k < n; ++k) {
+				if ((bits >> (cx + k)) & 1) {
+					tiles[k] = c->types[i];
+					if (slots) slots[k] = c->slots[i];
+					++i;
+				} else {
+					tiles[k] = TileFloor;
+					if (slots) slots[k] = -1U;
+				}
+			}
+		}
+		x += n;
+		tiles += n;
+		if (slots) slots += n;
+	}
+}
+
+void SparseTiles::write_row(uint32_t y, Tile const *tiles, uint32_t const *slots) {
+	assert(y < height);
+	uint32_t cy = y % ChunkSize;
+	Tile types[ChunkSize];
+	uint32_t feature_slots[ChunkSize];
+	for (uint32_t chunk_x = 0; chunk_x < chunks_x; ++chunk_x) {
+		uint32_t x0 = chunk_x * ChunkSize;
+		uint32_t n = std::min(ChunkSize, width - x0);
+		uint64_t bits = 0;
+		uint32_t count = 0;
+		for (uint32_t k = 0; k < n; ++k) {
+			if (tiles[x0 + k] == TileFloor) continue;
+			bits |= uint64_t(1) << k;
+			types[count] = tiles[x0 + k];
+			feature_slots[count] = slots[x0 + k];
+			++count;
+		}
+		write_chunk_row((y / ChunkSize) * chunks_x + chunk_x, cy, n, bits, types, feature_slots);
+	}
+}
+
+void SparseTiles::row_features(uint32_t y, std::vector< Feature > *features_) const {
+	assert(y < height);
+	std::vector< Feature > &out = *features_;
+	out.clear();
+	uint32_t cy = y % ChunkSize;
+	for (uint32_t chunk_x = 0; chunk_x < chunks_x; ++chunk_x) {
+		uint32_t c = chunk_at[(y / ChunkSize) * chunks_x + chunk_x];
+		if (c == -1U) continue;
+		Chunk const &chunk = chunks[c];
+		uint32_t x0 = chunk_x * ChunkSize;
+		if (chunk.dense) {
+			uint32_t n = std::min(ChunkSize, width - x0);
+			for (uint32_t k = 0; k < n; ++k) {
+				uint32_t i = cy * ChunkSize + k;
+				if (chunk.types[i] != TileFloor) out.emplace_back(Feature{x0 + k, chunk.types[i], chunk.slots[i]});
+			}
+		} else if ((chunk.occupied >> cy) & 1) {
+			uint32_t r = chunk.row_rank(cy);
+			uint32_t i = chunk.row_begin[r];
+			for (uint64_t bits = chunk.rows[r]; bits; bits &= bits - 1, ++i) {
+				out.emplace_back(Feature{x0 + lowest_bit(bits), chunk.types[i], chunk.slots[i]});
+			}
+		}
+	}
+}
+
+void SparseTiles::column_features(uint32_t x, std::vector< Feature > *features_) const {
+	assert(x < width);
+	std::vector< Feature > &out = *features_;
+	out.clear();
+	uint32_t cx = x % ChunkSize;
+	uint32_t chunks_y = uint32_t(chunk_at.size() / chunks_x);
+	for (uint32_t chunk_y = 0; chunk_y < chunks_y; ++chunk_y) {
+		uint32_t c = chunk_at[chunk_y * chunks_x + x / ChunkSize];
+		if (c == -1U) continue;
+		Chunk const &chunk = chunks[c];
+		uint32_t y0 = chunk_y * ChunkSize;
+		if (chunk.dense) {
+			uint32_t n = std::min(ChunkSize, height - y0);
+			for (uint32_t cy = 0; cy < n; ++cy) {
+				uint32_t i = cy * ChunkSize + cx;
+				if (chunk.types[i] != TileFloor) out.emplace_back(Feature{y0 + cy, chunk.types[i], chunk.slots[i]});
+			}
+		} else {
+			//(one step per occupied row of the chunk, not per cell)
+			uint32_t r = 0;
+			for (uint64_t occupied = chunk.occupied; occupied; occupied &= occupied - 1, ++r) {
+				uint64_t bits = chunk.rows[r];
+				if (!((bits >> cx) & 1)) continue;
+				uint32_t i = chunk.row_begin[r] + popcount(bits & below(cx));
+				out.emplace_back(Feature{y0 + lowest_bit(occupied), chunk.types[i], chunk.slots[i]});
+			}
+		}
+	}
+}
+
+void SparseTiles::write_row_features(uint32_t y, std::vector< Feature > const &features) {
+	assert(y < height);
+	uint32_t cy = y % ChunkSize;
+	Tile types[ChunkSize];
+	uint32_t slots[ChunkSize];
+	size_t f = 0;
+	for (uint32_t chunk_x = 0; chunk_x < chunks_x; ++chunk_x) {
+		uint32_t x0 = chunk_x * ChunkSize;
+		uint32_t n = std::min(ChunkSize, width - x0);
+		uint64_t bits = 0;
+		uint32_t count = 0;
+		for (; f < features.size() && features[f].at < x0 + n; ++f) {
+			assert(features[f].at >= x0 && features[f].type != TileFloor);
+			bits |= uint64_t(1) << (features[f].at - x0);
+			types[count] = features[f].type;
+			slots[count] = features[f].slot;
+			++count;
+		}
+		write_chunk_row((y / ChunkSize) * chunks_x + chunk_x, cy, n, bits, types, slots);
+	}
+	assert(f == features.size());
+}
+
+void SparseTiles::write_chunk_row(uint32_t position, uint32_t cy, uint32_t n, uint64_t bits, Tile const *types, uint32_t const *slots) {
+	if (chunk_at[position] == -1U && bits == 0) return;
+
+	Chunk &c = (chunk_at[position] == -1U ? allocate(position) : chunks[chunk_at[position]]);
+	uint32_t old_count = 0;
+	uint32_t new_count = popcount(bits);
+	if (c.dense) {
+		uint32_t i = 0;
+		for (uint32_t k = 0; k < n; ++k) {
+			Tile &t = c.types[cy * ChunkSize + k];
+			if (t != TileFloor) ++old_count;
+			if ((bits >> k) & 1) {
+				t = types[i];
+				c.slots[cy * ChunkSize + k] = slots[i];
+				++i;
+			} else {
+				t = TileFloor;
+				c.slots[cy * ChunkSize + k] = -1U;
+			}
+		}
+	} else {
+		uint32_t r = c.row_rank(cy);
+		bool occupied = (c.occupied >> cy) & 1;
+		if (!occupied && bits == 0) return;
+		old_count = (occupied ? popcount(c.rows[r]) : 0);
+
+		//resize the row's run of entries, then fill it in:
+		uint32_t begin = c.row_begin[r];
+		if (new_count > old_count) {
+			c.types.insert(c.types.begin() + begin + old_count, new_count - old_count, TileFloor);
+			c.slots.insert(c.slots.begin() + begin + old_count, new_count - old_count, -1U);
+		} else if (new_count < old_count) {
+			c.types.erase(c.types.begin() + begin + new_count, c.types.begin() + begin + old_count);
+			c.slots.erase(c.slots.begin() + begin + new_count, c.slots.begin() + begin + old_count);
+		}
+		std::copy(types, types + new_count, c.types.begin() + begin);
+		std::copy(slots, slots + new_count, c.slots.begin() + begin);
+
+		if (occupied && bits) {
+			c.rows[r] = bits;
+		} else if (occupied) {
+			c.rows.erase(c.rows.begin() + r);
+			c.row_begin.erase(c.row_begin.begin() + r);
+			c.occupied &= ~(uint64_t(1) << cy);
+		} else {
+			c.rows.insert(c.rows.begin() + r, bits);
+			c.row_begin.insert(c.row_begin.begin() + r, uint16_t(begin));
+			c.occupied |= uint64_t(1) << cy;
+		}
+		//rows after this one start later (or earlier):
+		for (uint32_t j = r + (bits ? 1 : 0); j < c.row_begin.size(); ++j) {
+			c.row_begin[j] = uint16_t(c.row_begin[j] + new_count - old_count);
+		}
+	}
+	c.count = c.count + new_count - old_count;
+	features = features + new_count - old_count;
+	if (new_count != old_count) update_density(position);
+}
+
+uint64_t SparseTiles::chunk_row_mask(uint32_t x, uint32_t y, Tile t) const {
+	assert(t != TileFloor);
+	Chunk const *c = chunk(x, y);
+	if (!c) return 0;
+	uint32_t cy = y % ChunkSize;
+	uint64_t mask = 0;
+	if (c->dense) {
+		for (uint32_t k = 0; k < ChunkSize; ++k) {
+			if (c->types[cy * ChunkSize + k] == t) mask |= uint64_t(1) << k;
+		}
+	} else if ((c->occupied >> cy) & 1) {
+		uint32_t r = c->row_rank(cy);
+		uint32_t i = c->row_begin[r];
+		for (uint64_t bits = c->rows[r]; bits; bits &= bits - 1, ++i) {
+			if (c->types[i] == t) mask |= uint64_t(1) << lowest_bit(bits);
+		}
+	}
+	return mask;
+}
+
+uint64_t SparseTiles::memory_bytes() const {
+	uint64_t bytes = chunk_at.capacity() * sizeof(uint32_t) + chunks.capacity() * sizeof(Chunk) + free_chunks.capacity() * sizeof(uint32_t);
+	for (Chunk const &c : chunks) {
+		bytes += c.rows.capacity() * sizeof(uint64_t) + c.row_begin.capacity() * sizeof(uint16_t);
+		bytes += c.types.capacity() * sizeof(Tile) + c.slots.capacity() * sizeof(uint32_t);
+	}
+	return bytes;
+}
+
+SparseTiles::Chunk &SparseTiles::allocate(uint32_t position) {
+	assert(chunk_at[position] == -1U);
+	if (free_chunks.empty()) {
+		free_chunks.emplace_back(uint32_t(chunks.size()));
+		chunks.emplace_back();
+	}
+	chunk_at[position] = free_chunks.back();
+	free_chunks.pop_back();
+
+	Chunk &c = chunks[chunk_at[position]];
+	c.count = 0;
+	c.dense = false;
+	c.occupied = 0;
+	c.rows.clear();
+	c.row_begin.assign(1, 0);
+	c.types.clear();
+	c.slots.clear();
+	return c;
+}
+
+void SparseTiles::release(uint32_t position) {
+	assert(chunk_at[position] != -1U);
+	Chunk &c = chunks[chunk_at[position]];
+	std::vector< uint64_t >().swap(c.rows);
+	std::vector< uint16_t >().swap(c.row_begin);
+	std::vector< Tile >().swap(c.types);
+	std::vector< uint32_t >().swap(c.slots);
+	free_chunks.emplace_back(chunk_at[position]);
+	chunk_at[position] = -1U;
+}
+
+void SparseTiles::update_density(uint32_t position) {
+	Chunk &c = chunks[chunk_at[position]];
+	if (c.count == 0) release(position);
+	else if (!c.dense && c.count > DenseAbove) make_dense(c);
+	else if (c.dense && c.count < SparseBelow) make_sparse(c);
+}
+
+void SparseTiles::make_dense(Chunk &c) {
+	std::vector< Tile > types(ChunkSize * ChunkSize, TileFloor);
+	std::vector< uint32_t > slots(ChunkSize * ChunkSize, -1U);
+	uint32_t i = 0, r = 0;
+	for (uint32_t cy = 0; cy < ChunkSize; ++cy) {
+		if (!((c.occupied >> cy) & 1)) continue;
+		uint64_t bits = c.rows[r++];
+		for (uint32_t cx = 0; cx < ChunkSize; ++cx) {
+			if (!((bits >> cx) & 1)) continue;
+			types[cy * ChunkSize + cx] = c.types[i];
+			slots[cy * ChunkSize + cx] = c.slots[i];
+			++i;
+		}
+	}
+	assert(i == c.count);
+	c.types = std::move(types);
+	c.slots = std::move(slots);
+	c.occupied = 0;
+	std::vector< uint64_t >().swap(c.rows);
+	std::vector< uint16_t >().swap(c.row_begin);
+	c.dense = true;
+}
+
+void SparseTiles::make_sparse(Chunk &c) {
+	std::vector< Tile > types;
+	std::vector< uint32_t > slots;
+	types.reserve(c.count);
+	slots.reserve(c.count);
+	c.occupied = 0;
+	c.rows.clear();
+	c.row_begin.clear();
+	for (uint32_t cy = 0; cy < ChunkSize; ++cy) {
+		uint64_t bits = 0;
+		uint16_t begin = uint16_t(types.size());
+		for (uint32_t cx = 0; cx < ChunkSize; ++cx) {
+			Tile t = c.types[cy * ChunkSize + cx];
+			if (t == TileFloor) continue;
+			bits |= uint64_t(1) << cx;
+			types.emplace_back(t);
+			slots.emplace_back(c.slots[cy * ChunkSize + cx]);
+		}
+		if (bits == 0) continue;
+		c.occupied |= uint64_t(1) << cy;
+		c.rows.emplace_back(bits);
+		c.row_begin.emplace_back(begin);
+	}
+	c.row_begin.emplace_back(uint16_t(types.size()));
+	c.types = std::move(types);
+	c.slots = std::move(slots);
+	c.dense = false;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "tiles.hpp"
+
+#include <vector>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 'SparseTiles' is a tile grid that takes memory in proportion to the number of cells that aren't floor
+// ("features"), not to its area. Each feature also carries a 32-bit slot (Board keeps its instance slot there).
+// The grid is cut into 64x64-cell chunks, and chunks that are all floor take no storage. The rest are either:
+//  - sparse: the features in row-major order (CSR style), and for each chunk row that has any, a bitmap word
+//    (bit x set: cell x of that row isn't floor) and the index of the row's first feature. Rows that have
+//    features are themselves marked in one 'occupied' word, so a cell's feature is found with two popcount
+//    ranks (which occupied row, then which feature in that row): still O(1); or
+//  - dense: a tile and slot for every cell. Chunks switch to dense when more than half full (by then the
+//    sparse form saves little, and every edit shifts thousands of entries) and back when under a quarter full.
+
+struct SparseTiles {
+	static constexpr uint32_t ChunkSize = 64; //chunk width and height (a chunk row is one bitmap word)
+
+	//replace the whole grid (tiles is width * height, row-major); every slot starts as -1U:
+	void reset(uint32_t width, uint32_t height, std::vector< Tile > const &tiles);
+	//...or with an all-floor grid (which takes no chunk storage):
+	void clear(uint32_t width, uint32_t height);
+
+	Tile get(uint32_t x, uint32_t y) const {
+		Chunk const *c = chunk(x, y);
+		uint32_t i = (c ? c->find(x % ChunkSize, y % ChunkSize) : -1U);
+		return (i == -1U ? TileFloor : c->types[i]);
+	}
+
+	//slot stored with the feature at (x,y), or -1U if that cell is floor:
+	uint32_t slot(uint32_t x, uint32_t y) const {
+		Chunk const *c = chunk(x, y);
+		uint32_t i = (c ? c->find(x % ChunkSize, y % ChunkSize) : -1U);
+		return (i == -1U ? -1U : c->slots[i]);
+	}
+
+	//change one cell (floor cells don't keep a slot):
+	void set(uint32_t x, uint32_t y, Tile t, uint32_t slot = -1U);
+	//change the slot of a feature (the cell must not be floor):
+	void set_slot(uint32_t x, uint32_t y, uint32_t slot);
+
+	//copy 'count' cells of row y, starting at x, into 'tiles' (and, if not null, their slots into 'slots'):
+	void read_row(uint32_t x, uint32_t y, uint32_t count, Tile *tiles, uint32_t *slots = nullptr) const;
+	//replace all of row y (tiles and slots are 'width' long); much cheaper than setting the cells one at a time:
+	void write_row(uint32_t y, Tile const *tiles, uint32_t const *slots);
+
+	//a cell that isn't floor, on a line of cells (a row or a column); 'at' is its x (on a row) or y (on a column):
+	struct Feature {
+		uint32_t at;
+		Tile type;
+		uint32_t slot;
+	};
+	//replace 'features' with those of row y (in order of x) or column x (in order of y).
+	// These cost a step per chunk (rows) or per occupied chunk row (columns), plus one per feature, rather than one per cell:
+	void row_features(uint32_t y, std::vector< Feature > *features) const;
+	void column_features(uint32_t x, std::vector< Feature > *features) const;
+	//replace all of row y with 'features' (in order of x; the rest of the row becomes floor):
+	void write_row_features(uint32_t y, std::vector< Feature > const &features);
+
+	//bit k set if cell (x - x % ChunkSize + k, y), on x's chunk row, holds a 't' tile ('t' must not be floor):
+	uint64_t chunk_row_mask(uint32_t x, uint32_t y, Tile t) const;
+
+	//------- state -------
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t features = 0; //cells that aren't floor
+
+	//bytes of chunk storage in use (to see how well the board compresses):
+	uint64_t memory_bytes() const;
+
+private:
+	struct Chunk {
+		uint32_t count = 0; //features in the chunk
+		bool dense = false;
+		//sparse chunks only:
+		uint64_t occupied = 0; //bit y: row y of the chunk has features
+		std::vector< uint64_t > rows; //for each occupied row, in order: bit x set if cell x of the row isn't floor
+		std::vector< uint16_t > row_begin; //for each occupied row, the index of its first feature (plus 'count' at the end)
+		//sparse: one entry per feature, in row-major order; dense: one entry per cell:
+		std::vector< Tile > types;
+		std::vector< uint32_t > slots;
+
+		//(sparse chunks) position of row cy in 'rows' (or where it would go, if it isn't occupied):
+		uint32_t row_rank(uint32_t cy) const {
+			return popcount(occupied & below(cy));
+		}
+		//entry for cell (cx,cy), or -1U if that cell is floor:
+		uint32_t find(uint32_t cx, uint32_t cy) const {
+			if (dense) return (types[cy * ChunkSize + cx] != TileFloor ? cy * ChunkSize + cx : -1U);
+			if (!((occupied >> cy) & 1)) return -1U;
+			uint32_t r = row_rank(cy);
+			if (!((rows[r] >> cx) & 1)) return -1U;
+			return row_begin[r] + popcount(rows[r] & below(cx));
+		}
+	};
+
+	static uint64_t below(uint32_t bit) { //mask of bits [0, bit)
+		return (uint64_t(1) << bit) - 1;
+	}
+	static uint32_t popcount(uint64_t bits) {
+	#ifdef _MSC_VER
+		return uint32_t(__popcnt64(bits));
+	#else
+		return uint32_t(__builtin_popcountll(bits));
+	#endif
+	}
+	static uint32_t lowest_bit(uint64_t bits) { //(bits must not be zero)
+	#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return uint32_t(index);
+	#else
+		return uint32_t(__builtin_ctzll(bits));
+	#endif
+	}
+
+	uint32_t chunks_x = 0; //chunks per row of chunks
+	std::vector< uint32_t > chunk_at; //index into 'chunks' for each chunk position (row-major), -1U if all floor
+	std::vector< Chunk > chunks;
+	std::vector< uint32_t > free_chunks; //entries of 'chunks' not in use
+
+	Chunk const *chunk(uint32_t x, uint32_t y) const {
+		uint32_t c = chunk_at[(y / ChunkSize) * chunks_x + x / ChunkSize];
+		return (c == -1U ? nullptr : &chunks[c]);
+	}
+	Chunk &allocate(uint32_t position); //(position is an index into chunk_at)
+	void release(uint32_t position);
+	void update_density(uint32_t position); //switch between sparse and dense (or release) after edits
+	//replace the first 'n' cells of chunk row 'cy' in the chunk at 'position' (allocating it if need be):
+	// 'bits' marks the cells that aren't floor, and 'types' and 'slots' hold one entry per set bit, in order:
+	void write_chunk_row(uint32_t position, uint32_t cy, uint32_t n, uint64_t bits, Tile const *types, uint32_t const *slots);
+
+	static void make_dense(Chunk &c);
+	static void make_sparse(Chunk &c);
+};
@@ -0,0 +1,35 @@
+#!/bin/sh
+#Builds every variant (see Jamfile), runs its bench, and reports each benchmark's speedup over the debug build.
+#Run from the directory containing the Jamfile. Extra arguments are passed to bench (e.g. --quick).
+
+set -e
+
+jam -sVARIANT=debug
+jam -sVARIANT=release
+jam -sVARIANT=lto
+./pgo.sh
+
+mkdir -p objs/bench
+for v in "" -release -lto -pgo; do
+	echo "running dist/bench$v ..."
+	./dist/bench$v "$@" > "objs/bench/bench$v.txt"
+done
+
+#table of best times (ms) and speedup relative to debug:
+awk '
+	FNR == 1 { file += 1; name[file] = FILENAME; sub(/.*\//, "", name[file]); sub(/\.txt$/, "", name[file]); }
+	file == 1 { order[++rows] = $1; base[$1] = $2; checksum[$1] = $3; }
+	{ ms[file, $1] = $2; if ($3 != checksum[$1]) mismatch[$1] = 1; }
+	END {
+		printf("%-16s", "benchmark");
+		for (f = 1; f <= file; ++f) printf(" %21s", name[f]);
+		printf("\n");
+		for (r = 1; r <= rows; ++r) {
+			b = order[r];
+			printf("%-16s", b);
+			for (f = 1; f <= file; ++f) printf(" %10.2fms (%5.2fx)", ms[f, b], base[b] / ms[f, b]);
+			if (b in mismatch) printf("  (checksums differ!)");
+			printf("\n");
+		}
+	}
+' objs/bench/bench.txt objs/bench/bench-release.txt objs/bench/bench-lto.txt objs/bench/bench-pgo.txt
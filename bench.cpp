@@ -0,0 +1,357 @@
+//bench runs the game's CPU-side systems headless (no window, no GL) on fixed inputs and reports timings.
+// It doubles as the training workload for profile-guided builds (see pgo.sh) and
+// is what bench-variants.sh runs to compare build variants.
+//
+//Usage: bench [--quick] [--counters]
+// prints one "<name> <best ms> <checksum>" line per benchmark; the checksum
+// should match across builds (it also keeps the compiler from removing the work).
+// --counters appends hardware counter results for the best run (see perf_counters.hpp):
+// instructions per cycle, then cycles and L1D / LLC / branch misses per unit of work (cell, move, draw, ...).
+
+#include "generate_board.hpp"
+#include "Board.hpp"
+#include "philox.hpp"
+#include "Agents.hpp"
+#include "crc32c.hpp"
+#include "transforms.hpp"
+#include "Ghosts.hpp"
+#include "Entities.hpp"
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <list>
+#include <memory>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace {
+
+struct Benchmark {
+	char const *name;
+	std::function< uint64_t() > run; //returns a checksum of its results
+	char const *unit; //what one unit of work is (for --counters' per-unit results)
+	uint64_t units; //units of work per run
+};
+
+//scale of the inputs (--quick shrinks them for a fast smoke test):
+uint32_t Scale = 4;
+
+//storage for benchmark names that aren't string literals:
+std::list< std::string > names;
+
+std::vector< Benchmark > make_benchmarks() {
+	std::vector< Benchmark > benchmarks;
+
+	benchmarks.push_back({"generate_board", [](){
+		BoardParams params;
+		params.width = params.height = 256 * Scale;
+		params.seed = 1234;
+		params.goal_x = params.width / 2;
+		params.goal_y = params.height / 2;
+		std::vector< Tile > tiles = generate_board(params);
+		uint64_t sum = 0;
+		for (Tile t : tiles) sum = sum * 31 + t;
+		return sum;
+	}, "cell", uint64_t(256 * Scale) * uint64_t(256 * Scale)});
+
+	{ //(input board is generated up front, so only the edits are timed)
+		BoardParams params;
+		params.width = params.height = 128 * Scale;
+		params.seed = 99;
+		params.goal_x = params.width / 2;
+		params.goal_y = params.height / 2;
+		std::vector< Tile > tiles = generate_board(params);
+		benchmarks.push_back({"board_edits", [params, tiles](){
+			Board board;
+			board.reset(params.width, params.height, tiles);
+			std::mt19937 mt(0x5eed);
+			uint64_t sum = 0;
+			for (uint32_t i = 0; i < 2000 * Scale; ++i) {
+				uint32_t x = mt() % board.width;
+				uint32_t y = mt() % board.height;
+				if (board.get(x, y) == TileGoal) continue;
+				board.set(x, y, (board.get(x, y) == TileWall ? TileFloor : TileWall));
+				sum = sum * 31 + board.distance_to_goal(params.start_x, params.start_y);
+			}
+			return sum;
+		}, "edit", 2000 * Scale});
+	}
+
+	{ //a board half full of stars, collected in random order (each one a swap-remove from the star instances):
+		uint32_t size = 256 * Scale;
+		std::vector< Tile > tiles(size * size, TileFloor);
+		std::vector< uint32_t > stars;
+		std::mt19937 mt(0x57a5);
+		for (uint32_t i = 0; i < tiles.size(); ++i) {
+			if (mt() % 2) {
+				tiles[i] = TileStar;
+				stars.emplace_back(i);
+			}
+		}
+		std::shuffle(stars.begin(), stars.end(), mt);
+		stars.resize(stars.size() / 2);
+		benchmarks.push_back({"stars_collect", [size, tiles, stars](){
+			Board board;
+			board.reset(size, size, tiles);
+			for (uint32_t cell : stars) {
+				board.set(cell % size, cell / size, TileFloor);
+			}
+			uint64_t sum = board.instances[TileStar].size();
+			for (size_t i = 0; i < board.instances[TileStar].size(); i += 97) sum = sum * 31 + board.instances[TileStar][i];
+			return sum * 31 + board.changed_slots.size();
+		}, "star", stars.size()});
+	}
+
+	{ //wide board (rows span many chunks), so rolls are dominated by rewriting sparse chunk rows, patching the chunked distance field, and instance updates:
+		BoardParams params;
+		params.width = 1024 * Scale;
+		params.height = 64;
+		params.seed = 7;
+		params.goal_x = params.width / 2;
+		params.goal_y = params.height / 2;
+		std::vector< Tile > tiles = generate_board(params);
+		benchmarks.push_back({"board_rolls", [params, tiles](){
+			Board board;
+			board.reset(params.width, params.height, tiles);
+			std::mt19937 mt(0x7011);
+			uint64_t sum = 0;
+			for (uint32_t i = 0; i < 500 * Scale; ++i) {
+				int32_t shift = int32_t(mt() % 7) - 3;
+				if (mt() % 2) board.roll_row(mt() % board.height, shift);
+				else board.roll_column(mt() % board.width, shift);
+				sum = sum * 31 + board.goal;
+			}
+			for (Tile t : board.dense_tiles()) sum = sum * 31 + t;
+			return sum;
+		}, "move", 500 * Scale});
+	}
+
+	benchmarks.push_back({"agents_step", [](){
+		uint32_t size = 256 * Scale;
+		Agents agents;
+		agents.resize(size, size);
+		std::mt19937 mt(0xbead1234);
+		for (uint32_t i = 0; i < size * size / 8; ++i) {
+			agents.set_blocked(mt() % size, mt() % size, true);
+		}
+		for (uint32_t i = 0; i < size * size / 4; ++i) {
+			agents.add(mt() % size, mt() % size, uint8_t(mt() % 4));
+		}
+		for (uint32_t s = 0; s < 50; ++s) {
+			agents.step(0, 0);
+		}
+		uint64_t sum = 0;
+		for (size_t i = 0; i < agents.size(); ++i) sum = sum * 31 + agents.y[i] * size + agents.x[i];
+		return sum;
+	}, "cell", uint64_t(256 * Scale) * uint64_t(256 * Scale) * 50}); //(cells of the board, per step)
+
+	{ //hundreds of ghosts racing for a minute at 60fps: steps decoded as they come due, and instance offsets every frame:
+		GhostJournal journal;
+		std::mt19937 mt(0x6057);
+		for (uint32_t r = 0; r < 250 * Scale; ++r) {
+			journal.runs.emplace_back();
+			GhostJournal::Run &run = journal.runs.back();
+			run.start_x = int32_t(mt() % 64);
+			run.start_y = int32_t(mt() % 64);
+			for (uint32_t s = 0; s < 1000; ++s) {
+				GhostJournal::Step step;
+				step.ticks = (mt() % 32 == 0 ? 20 + mt() % 60 : 1 + mt() % 6); //(mostly quick moves, some pauses)
+				int32_t d = (mt() % 2 ? 1 : -1) * (mt() % 64 == 0 ? 2 : 1); //(riflectors move two cells)
+				if (mt() % 2) step.dx = d;
+				else step.dy = d;
+				run.step(step);
+			}
+		}
+		uint32_t frames = 60 * 60;
+		benchmarks.push_back({"ghosts_race", [journal, frames](){
+			Ghosts ghosts;
+			ghosts.reset(journal);
+			std::vector< glm::vec4 > instances;
+			uint64_t sum = 0;
+			for (uint32_t f = 0; f < frames; ++f) {
+				ghosts.advance(f / 60.0f);
+				ghosts.instances(&instances);
+				glm::vec4 const &i = instances[f % instances.size()];
+				sum = sum * 31 + uint64_t(int64_t(std::round(i.x * 64.0f))) + uint64_t(int64_t(std::round(i.y * 64.0f)));
+			}
+			for (size_t g = 0; g < ghosts.size(); ++g) sum = sum * 31 + uint64_t(ghosts.x[g]) * 977 + uint64_t(ghosts.y[g]);
+			return sum;
+		}, "ghost-frame", uint64_t(250 * Scale) * frames});
+	}
+
+	benchmarks.push_back({"entities_frame", [](){
+		//a steady stream of short-lived particles (a few thousand alive at once) for ten seconds at 60fps:
+		// spawned, moved, aged (and destroyed), and extracted for drawing every frame:
+		Entities entities;
+		std::mt19937 mt(0xe7717e5);
+		std::vector< std::vector< glm::vec4 > > instances(4);
+		uint64_t sum = 0;
+		for (uint32_t f = 0; f < 600; ++f) {
+			for (uint32_t n = 0; n < 64 * Scale; ++n) {
+				uint32_t components = Entities::Position | Entities::Velocity | Entities::Lifetime | Entities::Render;
+				Entities::Handle h = entities.create(components);
+				entities.position(h) = glm::vec3(float(mt() % 64), float(mt() % 64), 0.0f);
+				entities.velocity(h) = glm::vec3(float(mt() % 9) - 4.0f, float(mt() % 9) - 4.0f, 2.0f);
+				entities.lifetime(h) = 0.25f + float(mt() % 64) / 64.0f;
+				entities.group(h) = mt() % 4;
+			}
+			entities.integrate(1.0f / 60.0f);
+			entities.age(1.0f / 60.0f);
+			for (auto &list : instances) list.clear();
+			entities.extract(&instances);
+			for (auto const &list : instances) {
+				if (!list.empty()) sum = sum * 31 + uint64_t(int64_t(std::round(list[f % list.size()].x * 64.0f)));
+			}
+		}
+		return sum * 31 + entities.size();
+	}, "frame", 600});
+
+	benchmarks.push_back({"philox_fill", [](){
+		std::vector< uint32_t > values(size_t(4) << 20);
+		Philox random(1234, 5, StreamTiles);
+		uint64_t sum = 0;
+		for (uint32_t pass = 0; pass < Scale; ++pass) {
+			random.fill(uint64_t(pass) * values.size() + 1, values.data(), values.size()); //(+1: start mid-block)
+			for (uint32_t v : values) sum += v;
+		}
+		return sum;
+	}, "value", (uint64_t(4) << 20) * Scale});
+
+	{
+		std::vector< uint8_t > data(size_t(16) << 20);
+		std::mt19937 mt(42);
+		for (auto &b : data) b = uint8_t(mt());
+		benchmarks.push_back({"crc32c", [data](){
+			uint64_t sum = 0;
+			for (uint32_t i = 0; i < Scale; ++i) {
+				sum = sum * 31 + crc32c(data.data(), data.size());
+			}
+			return sum;
+		}, "byte", (uint64_t(16) << 20) * Scale});
+	}
+
+	//per-draw matrices, one glm call at a time vs. the batched kernel, for draw lists of several sizes:
+	for (uint32_t draws : {10000u, 100000u, 1000000u}) {
+		if (Scale == 1 && draws > 10000) break;
+		std::shared_ptr< DrawTransforms > transforms = std::make_shared< DrawTransforms >();
+		std::mt19937 mt(draws);
+		std::uniform_real_distribution< float > angle(0.0f, 6.2831853f);
+		for (uint32_t i = 0; i < draws; ++i) {
+			float c = std::cos(angle(mt)), s = std::sin(angle(mt));
+			transforms->push(glm::mat4(
+				c, s, 0.0f, 0.0f,
+				-s, c, 0.0f, 0.0f,
+				0.0f, 0.0f, 1.0f, 0.0f,
+				float(i % 1000) + 0.5f, float(i / 1000) + 0.5f, 0.0f, 1.0f
+			));
+		}
+		glm::mat4 world_to_clip(
+			0.01f, 0.0f, 0.0f, 0.0f,
+			0.0f, 0.02f, 0.0f, 0.0f,
+			0.0f, 0.0f,-1.0f, 0.0f,
+			-1.0f, -1.0f, 0.0f, 1.0f
+		);
+		//(checksum rounds results, since the two paths may differ in the last bit)
+		auto checksum = [transforms]() {
+			uint64_t sum = 0;
+			for (size_t i = 0; i < transforms->size(); i += 97) {
+				sum = sum * 31 + uint64_t(int64_t(std::round(transforms->object_to_clip[i][3][0] * 1000.0f)));
+				sum = sum * 31 + uint64_t(int64_t(std::round(transforms->normal_to_light[i][0][1] * 1000.0f)));
+			}
+			return sum;
+		};
+		std::string suffix = (draws >= 1000000 ? "_" + std::to_string(draws / 1000000) + "M" : "_" + std::to_string(draws / 1000) + "k");
+		names.emplace_back("xform_glm" + suffix);
+		benchmarks.push_back({names.back().c_str(), [=](){
+			transforms->compute_reference(world_to_clip);
+			return checksum();
+		}, "draw", draws});
+		names.emplace_back("xform_simd" + suffix);
+		benchmarks.push_back({names.back().c_str(), [=](){
+			transforms->compute(world_to_clip);
+			return checksum();
+		}, "draw", draws});
+	}
+
+	return benchmarks;
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+	uint32_t repeats = 5;
+	bool counters = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--quick") {
+			Scale = 1;
+			repeats = 1;
+		} else if (arg == "--counters") {
+			counters = true;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--quick] [--counters]" << std::endl;
+			return 1;
+		}
+	}
+
+	try {
+		//(opened once, so every benchmark is counted the same way; unavailable counters print as '-')
+		std::unique_ptr< PerfCounters > perf;
+		if (counters) {
+			perf.reset(new PerfCounters());
+			if (!perf->error.empty()) {
+				std::cerr << "NOTE: " << perf->error << "; " << (perf->any_available() ? "some" : "all") << " hardware counters unavailable." << std::endl;
+			}
+		}
+
+		for (Benchmark const &b : make_benchmarks()) {
+			double best = 0.0;
+			uint64_t checksum = 0;
+			uint64_t best_values[PerfCounters::CounterCount] = { 0 };
+			for (uint32_t r = 0; r < repeats; ++r) {
+				if (perf) perf->start();
+				auto before = std::chrono::high_resolution_clock::now();
+				checksum = b.run();
+				auto after = std::chrono::high_resolution_clock::now();
+				if (perf) perf->stop();
+				double ms = std::chrono::duration< double, std::milli >(after - before).count();
+				if (r == 0 || ms < best) {
+					best = ms;
+					if (perf) std::copy(perf->values, perf->values + PerfCounters::CounterCount, best_values);
+				}
+			}
+			std::cout << std::left << std::setw(16) << b.name << " "
+				<< std::right << std::fixed << std::setprecision(2) << std::setw(10) << best << " "
+				<< std::hex << checksum << std::dec;
+			if (perf) {
+				//(after the checksum, so bench-variants.sh's columns don't move)
+				auto column = [&](std::string const &label, bool available, double value) {
+					std::cout << "  " << label << " ";
+					if (available) std::cout << std::setprecision(value < 10.0 ? 3 : 1) << value;
+					else std::cout << "-";
+				};
+				double units = double(std::max< uint64_t >(1, b.units));
+				bool have_cycles = perf->available(PerfCounters::Cycles) && best_values[PerfCounters::Cycles] != 0;
+				column("ipc", have_cycles && perf->available(PerfCounters::Instructions),
+					double(best_values[PerfCounters::Instructions]) / double(std::max< uint64_t >(1, best_values[PerfCounters::Cycles])));
+				column(std::string("cycles/") + b.unit, have_cycles, best_values[PerfCounters::Cycles] / units);
+				column(std::string("l1d-miss/") + b.unit, perf->available(PerfCounters::L1DMisses), best_values[PerfCounters::L1DMisses] / units);
+				column(std::string("llc-miss/") + b.unit, perf->available(PerfCounters::LLCMisses), best_values[PerfCounters::LLCMisses] / units);
+				column(std::string("br-miss/") + b.unit, perf->available(PerfCounters::BranchMisses), best_values[PerfCounters::BranchMisses] / units);
+			}
+			std::cout << std::endl;
+		}
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include "crc32c.hpp"
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+constexpr uint32_t Polynomial = 0x82f63b78; //(reflected)
+
+//table[k][b] is the crc of byte b followed by k zero bytes:
+struct Tables {
+	uint32_t table[8][256];
+	Tables() {
+		for (uint32_t b = 0; b < 256; ++b) {
+			uint32_t c = b;
+			for (uint32_t i = 0; i < 8; ++i) {
+				c = (c >> 1) ^ (Polynomial & (0u - (c & 1)));
+			}
+			table[0][b] = c;
+		}
+		for (uint32_t b = 0; b < 256; ++b) {
+			for (uint32_t k = 1; k < 8; ++k) {
+				table[k][b] = (table[k-1][b] >> 8) ^ table[0][table[k-1][b] & 0xff];
+			}
+		}
+	}
+};
+
+uint32_t crc32c_slicing(uint8_t const *at, size_t size, uint32_t crc) {
+	static Tables const tables;
+	auto const &t = tables.table;
+	while (size >= 8) {
+		uint32_t lo, hi;
+		std::memcpy(&lo, at, 4);
+		std::memcpy(&hi, at + 4, 4);
+		lo ^= crc; //(assumes a little-endian host, as does the rest of the blob format)
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+		    ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+		at += 8;
+		size -= 8;
+	}
+	while (size > 0) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *at) & 0xff];
+		++at;
+		--size;
+	}
+	return crc;
+}
+
+#ifdef CRC32C_X86
+#ifndef _MSC_VER
+__attribute__((target("sse4.2")))
+#endif
+uint32_t crc32c_sse42(uint8_t const *at, size_t size, uint32_t crc) {
+	uint64_t crc64 = crc;
+	while (size >= 8) {
+		uint64_t word;
+		std::memcpy(&word, at, 8);
+		crc64 = _mm_crc32_u64(crc64, word);
+		at += 8;
+		size -= 8;
+	}
+	crc = uint32_t(crc64);
+	while (size > 0) {
+		crc = _mm_crc32_u8(crc, *at);
+		++at;
+		--size;
+	}
+	return crc;
+}
+
+bool have_sse42() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#endif //CRC32C_X86
+
+//multiply a 32x32 GF(2) matrix by a vector / by another matrix (as in zlib's crc32_combine):
+uint32_t gf2_times(uint32_t const *mat, uint32_t vec) {
+	uint32_t sum = 0;
+	for (; vec; vec >>= 1, ++mat) {
+		if (vec & 1) sum ^= *mat;
+	}
+	return sum;
+}
+
+void gf2_square(uint32_t *square, uint32_t const *mat) {
+	for (uint32_t i = 0; i < 32; ++i) {
+		square[i] = gf2_times(mat, mat[i]);
+	}
+}
+
+} //namespace
+
+uint32_t crc32c(void const *data, size_t size, uint32_t crc) {
+	uint8_t const *at = reinterpret_cast< uint8_t const * >(data);
+	crc = ~crc;
+#ifdef CRC32C_X86
+	static bool const use_sse42 = have_sse42();
+	if (use_sse42) return ~crc32c_sse42(at, size, crc);
+#endif
+	return ~crc32c_slicing(at, size, crc);
+}
+
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t size_b) {
+	if (size_b == 0) return crc_a;
+
+	uint32_t even[32]; //operator for 2^n zero bits
+	uint32_t odd[32]; //operator for 2^(n+1) zero bits
+
+	//operator for one zero bit:
+	odd[0] = Polynomial;
+	for (uint32_t i = 1, row = 1; i < 32; ++i, row <<= 1) {
+		odd[i] = row;
+	}
+	gf2_square(even, odd); //two zero bits
+	gf2_square(odd, even); //four zero bits
+
+	//apply size_b zero bytes to crc_a (first square gives one zero byte):
+	do {
+		gf2_square(even, odd);
+		if (size_b & 1) crc_a = gf2_times(even, crc_a);
+		size_b >>= 1;
+		if (size_b == 0) break;
+		gf2_square(odd, even);
+		if (size_b & 1) crc_a = gf2_times(odd, crc_a);
+		size_b >>= 1;
+	} while (size_b != 0);
+
+	return crc_a ^ crc_b;
+}
+
+uint32_t crc32c_parallel(void const *data, size_t size) {
+	//below this size a stripe isn't worth a thread:
+	constexpr size_t StripeSize = size_t(1) << 20;
+
+	size_t stripes = std::min< size_t >((size + StripeSize - 1) / StripeSize, std::max(1u, std::thread::hardware_concurrency()));
+	if (stripes <= 1) return crc32c(data, size);
+
+	uint8_t const *bytes = reinterpret_cast< uint8_t const * >(data);
+	size_t stripe_size = (size + stripes - 1) / stripes;
+	std::vector< uint32_t > crcs(stripes, 0);
+	auto work = [&](size_t s) {
+		size_t begin = s * stripe_size;
+		size_t end = std::min(size, begin + stripe_size);
+		crcs[s] = crc32c(bytes + begin, end - begin);
+	};
+
+	std::vector< std::thread > workers;
+	for (size_t s = 1; s < stripes; ++s) {
+		workers.emplace_back(work, s);
+	}
+	work(0);
+	for (auto &w : workers) {
+		w.join();
+	}
+
+	uint32_t crc = crcs[0];
+	for (size_t s = 1; s < stripes; ++s) {
+		size_t begin = s * stripe_size;
+		size_t end = std::min(size, begin + stripe_size);
+		crc = crc32c_combine(crc, crcs[s], end - begin);
+	}
+	return crc;
+}
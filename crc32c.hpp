@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+//CRC32C (Castagnoli polynomial, as used by iSCSI/ext4/etc.) of a block of bytes.
+// Uses the SSE4.2 crc32 instruction when the CPU has it, and a slicing-by-8 table otherwise.
+// Pass a previous result as 'crc' to continue a checksum across several blocks.
+uint32_t crc32c(void const *data, size_t size, uint32_t crc = 0);
+
+//same result as crc32c(data, size), but large blocks are split into stripes
+// that are checksummed on separate threads and then combined:
+uint32_t crc32c_parallel(void const *data, size_t size);
+
+//given crc_a = crc32c(A) and crc_b = crc32c(B), returns crc32c(A followed by B):
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t size_b);
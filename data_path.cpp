@@ -3,6 +3,8 @@
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <stdexcept>
+#include <cstdlib>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -12,6 +14,7 @@
 #include <io.h>
 #elif defined(__APPLE__)
 #include <mach-o/dyld.h>
+#include <sys/stat.h>
 #elif defined(__linux__)
 #include <unistd.h>
 #include <sys/stat.h>
@@ -71,3 +74,49 @@ std::string data_path(std::string const &suffix) {
 	static std::string path = get_data_path();
 	return path + "/" + suffix;
 }
+
+//get_user_path() gets (and creates, if needed) a per-user directory for saved data:
+static std::string get_user_path() {
+	#if defined(_WIN32)
+	PWSTR folder = NULL;
+	if (SHGetKnownFolderPath(FOLDERID_SavedGames, KF_FLAG_CREATE, NULL, &folder) != S_OK) {
+		CoTaskMemFree(folder);
+		throw std::runtime_error("Failed to find the Saved Games folder.");
+	}
+	int length = WideCharToMultiByte(CP_UTF8, 0, folder, -1, NULL, 0, NULL, NULL);
+	std::vector< char > buffer(length > 0 ? length : 1, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, folder, -1, &buffer[0], int(buffer.size()), NULL, NULL);
+	CoTaskMemFree(folder);
+	std::string ret = std::string(&buffer[0]) + "\\slide2heart";
+	_mkdir(ret.c_str());
+	return ret;
+
+	#elif defined(__linux__) || defined(__APPLE__)
+	std::string base;
+	#if defined(__linux__)
+	if (char const *xdg = getenv("XDG_DATA_HOME")) base = xdg;
+	if (base.empty()) {
+		char const *home = getenv("HOME");
+		base = std::string(home ? home : ".") + "/.local/share";
+	}
+	#else
+	char const *home = getenv("HOME");
+	base = std::string(home ? home : ".") + "/Library/Application Support";
+	#endif
+	//create each directory along the way (mkdir fails harmlessly on ones that exist):
+	std::string ret = base + "/slide2heart";
+	for (size_t slash = ret.find('/', 1); slash != std::string::npos; slash = ret.find('/', slash + 1)) {
+		mkdir(ret.substr(0, slash).c_str(), 0755);
+	}
+	mkdir(ret.c_str(), 0755);
+	return ret;
+
+	#else
+	#error "No idea what the OS is."
+	#endif
+}
+
+std::string user_path(std::string const &suffix) {
+	static std::string path = get_user_path();
+	return path + "/" + suffix;
+}
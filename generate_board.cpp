@@ -0,0 +1,321 @@
+#include "generate_board.hpp"
+#include "philox.hpp"
+#include "parallel_for.hpp"
+
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define GENERATE_BOARD_SSE2 1
+#endif
+
+namespace {
+
+const TileMask AllTiles = TileMask((1u << TileCount) - 1);
+
+//relative frequency of each tile type (goal is only ever placed explicitly):
+const uint32_t Weights[TileCount] = {
+	60, //TileFloor
+	18, //TileWall
+	 6, //TileStar
+	 4, //TileRiflector
+	 5, //TileHole
+	 0, //TileGoal
+	 1, //TileGummy
+};
+
+//rows per band; fixed so that output never depends on the thread count:
+const uint32_t BandHeight = 64;
+
+struct Rules {
+	Rules() {
+		for (uint32_t t = 0; t < TileCount; ++t) {
+			allowed[t] = AllTiles;
+		}
+		auto forbid = [this](Tile a, Tile b) {
+			allowed[a] &= ~tile_bit(b);
+			allowed[b] &= ~tile_bit(a);
+		};
+		forbid(TileStar, TileStar); //spread stars out
+		forbid(TileStar, TileHole); //no stars guarded by holes
+		forbid(TileHole, TileHole); //no pits
+		forbid(TileRiflector, TileRiflector);
+		forbid(TileRiflector, TileWall); //riflectors need room to throw the player
+		forbid(TileGummy, TileGummy);
+		for (uint32_t t = 0; t < TileCount; ++t) {
+			if (t != TileFloor && t != TileStar) forbid(TileGoal, Tile(t)); //goal is always approachable
+		}
+
+		//support[m] is the union of allowed[t] over all t in m:
+		for (uint32_t m = 0; m < 256; ++m) {
+			support[m] = 0;
+			for (uint32_t t = 0; t < TileCount; ++t) {
+				if (m & (1u << t)) support[m] |= allowed[t];
+			}
+		}
+	}
+	TileMask allowed[TileCount];
+	TileMask support[256];
+};
+
+Rules const &rules() {
+	static Rules r;
+	return r;
+}
+
+//row[i] &= support(neighbor[i]) for i in [0,n), i.e., remove everything not compatible with
+// any of the types still possible in the neighboring row:
+void narrow_row(TileMask *row, TileMask const *neighbor, uint32_t n) {
+	Rules const &r = rules();
+	uint32_t i = 0;
+	#ifdef GENERATE_BOARD_SSE2
+	//sixteen cells at a time: for every type, select allowed[t] wherever the neighbor has bit t set
+	__m128i allowed[TileCount];
+	__m128i bits[TileCount];
+	for (uint32_t t = 0; t < TileCount; ++t) {
+		allowed[t] = _mm_set1_epi8(char(r.allowed[t]));
+		bits[t] = _mm_set1_epi8(char(1u << t));
+	}
+	for (; i + 16 <= n; i += 16) {
+		__m128i nbr = _mm_loadu_si128(reinterpret_cast< __m128i const * >(neighbor + i));
+		__m128i sup = _mm_setzero_si128();
+		for (uint32_t t = 0; t < TileCount; ++t) {
+			__m128i has = _mm_cmpeq_epi8(_mm_and_si128(nbr, bits[t]), bits[t]);
+			sup = _mm_or_si128(sup, _mm_and_si128(has, allowed[t]));
+		}
+		__m128i dom = _mm_loadu_si128(reinterpret_cast< __m128i const * >(row + i));
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(row + i), _mm_and_si128(dom, sup));
+	}
+	#endif
+	for (; i < n; ++i) {
+		row[i] &= r.support[neighbor[i]];
+	}
+}
+
+//pick a tile type from 'dom' according to Weights, using random value 'r':
+Tile pick(TileMask dom, uint32_t r) {
+	assert(dom != 0);
+	uint32_t total = 0;
+	for (uint32_t t = 0; t < TileCount; ++t) {
+		if (dom & (1u << t)) total += Weights[t];
+	}
+	if (total == 0) {
+		//only fixed types left; take the first:
+		for (uint32_t t = 0; t < TileCount; ++t) {
+			if (dom & (1u << t)) return Tile(t);
+		}
+	}
+	r %= total;
+	for (uint32_t t = 0; t < TileCount; ++t) {
+		if (!(dom & (1u << t))) continue;
+		if (r < Weights[t]) return Tile(t);
+		r -= Weights[t];
+	}
+	assert(0 && "weights didn't add up");
+	return TileFloor;
+}
+
+struct Generator {
+	Generator(BoardParams const &params_) : params(params_), tiles(params_.width * params_.height, TileFloor) { }
+
+	BoardParams const &params;
+	std::vector< Tile > tiles;
+
+	//domains before any neighbors are collapsed (all types, except for the fixed cells):
+	void init_row(uint32_t y, TileMask *row) const {
+		std::fill(row, row + params.width, AllTiles);
+		if (y == params.start_y) row[params.start_x] = tile_bit(TileFloor);
+		if (y == params.goal_y) row[params.goal_x] = tile_bit(TileGoal);
+	}
+
+	void collapsed_row(uint32_t y, TileMask *row) const {
+		Tile const *src = &tiles[y * params.width];
+		for (uint32_t x = 0; x < params.width; ++x) {
+			row[x] = tile_bit(src[x]);
+		}
+	}
+
+	//collapse row 'y' given the (possibly collapsed) domains of the rows above and below:
+	void generate_row(uint32_t y, TileMask const *above, TileMask const *below, std::vector< TileMask > &scratch) {
+		uint32_t w = params.width;
+		scratch.resize(w);
+		TileMask *row = scratch.data();
+		init_row(y, row);
+		if (above) narrow_row(row, above, w);
+		if (below) narrow_row(row, below, w);
+
+		//one random value per cell:
+		std::vector< uint32_t > random(w);
+		Philox(params.seed, params.level, StreamTiles).fill(uint64_t(y) * w, random.data(), w);
+
+		Rules const &r = rules();
+		Tile *out = &tiles[y * w];
+		for (uint32_t x = 0; x < w; ++x) {
+			TileMask dom = row[x];
+			if (x > 0) dom &= r.allowed[out[x-1]];
+			if (x + 1 < w) dom &= r.support[row[x+1]];
+			if (dom == 0) {
+				throw std::runtime_error("Board constraints are contradictory near (" + std::to_string(x) + ", " + std::to_string(y) + ").");
+			}
+			out[x] = pick(dom, random[x]);
+		}
+	}
+
+	//first row of band 'b' (b > 0), constrained only by the initial domains around it:
+	void generate_seam(uint32_t b) {
+		uint32_t y = b * BandHeight;
+		std::vector< TileMask > above(params.width), below(params.width), scratch;
+		init_row(y - 1, above.data());
+		if (y + 1 < params.height) init_row(y + 1, below.data());
+		generate_row(y, above.data(), (y + 1 < params.height ? below.data() : nullptr), scratch);
+	}
+
+	//remaining rows of band 'b', top to bottom:
+	void generate_band(uint32_t b) {
+		uint32_t y0 = b * BandHeight;
+		uint32_t y1 = std::min(params.height, y0 + BandHeight);
+		std::vector< TileMask > above(params.width), below(params.width), scratch;
+		uint32_t y = y0;
+		if (b > 0) {
+			collapsed_row(y0, above.data());
+			y += 1;
+		}
+		for (; y < y1; ++y) {
+			TileMask const *below_ptr = nullptr;
+			if (y + 1 < params.height) {
+				if (y + 1 == y1) collapsed_row(y + 1, below.data()); //next band's seam
+				else init_row(y + 1, below.data());
+				below_ptr = below.data();
+			}
+			generate_row(y, (y == 0 ? nullptr : above.data()), below_ptr, scratch);
+			collapsed_row(y, above.data());
+		}
+	}
+
+	//carve the cheapest (fewest walls) path from start to goal, if the goal isn't already reachable:
+	void connect_goal() {
+		uint32_t w = params.width, h = params.height;
+		uint32_t start = params.start_y * w + params.start_x;
+		uint32_t goal = params.goal_y * w + params.goal_x;
+
+		//0-1 BFS: stepping onto a wall costs one carve, anything else is free:
+		std::vector< uint32_t > cost(w * h, -1U);
+		std::vector< uint32_t > from(w * h, -1U);
+		std::deque< uint32_t > todo;
+		cost[start] = 0;
+		todo.emplace_back(start);
+		while (!todo.empty()) {
+			uint32_t at = todo.front();
+			todo.pop_front();
+			if (at == goal) break;
+			uint32_t ax = at % w, ay = at / w;
+			uint32_t nbrs[4];
+			uint32_t count = 0;
+			if (ax > 0) nbrs[count++] = at - 1;
+			if (ax + 1 < w) nbrs[count++] = at + 1;
+			if (ay > 0) nbrs[count++] = at - w;
+			if (ay + 1 < h) nbrs[count++] = at + w;
+			for (uint32_t n = 0; n < count; ++n) {
+				uint32_t next = nbrs[n];
+				uint32_t step = (tiles[next] == TileWall ? 1 : 0);
+				if (cost[at] + step < cost[next]) {
+					cost[next] = cost[at] + step;
+					from[next] = at;
+					if (step) todo.emplace_back(next);
+					else todo.emplace_front(next);
+				}
+			}
+		}
+		assert(cost[goal] != -1U);
+		//floor is allowed next to everything, so carving never breaks the adjacency rules:
+		for (uint32_t at = goal; at != start; at = from[at]) {
+			if (tiles[at] == TileWall) tiles[at] = TileFloor;
+		}
+	}
+
+	//add stars to reachable floor cells until there are at least min_stars reachable (or the candidates run out):
+	void place_stars() {
+		uint32_t w = params.width, h = params.height;
+		uint32_t start = params.start_y * w + params.start_x;
+		uint32_t goal = params.goal_y * w + params.goal_x;
+
+		std::vector< uint8_t > reached(w * h, 0);
+		std::vector< uint32_t > todo;
+		reached[start] = 1;
+		todo.emplace_back(start);
+		uint32_t stars = 0;
+		std::vector< uint32_t > candidates;
+		while (!todo.empty()) {
+			uint32_t at = todo.back();
+			todo.pop_back();
+			if (tiles[at] == TileStar) ++stars;
+			if (tiles[at] == TileFloor && at != start && at != goal) candidates.emplace_back(at);
+			uint32_t ax = at % w, ay = at / w;
+			auto visit = [&](uint32_t next) {
+				if (!reached[next] && tiles[next] != TileWall) {
+					reached[next] = 1;
+					todo.emplace_back(next);
+				}
+			};
+			if (ax > 0) visit(at - 1);
+			if (ax + 1 < w) visit(at + 1);
+			if (ay > 0) visit(at - w);
+			if (ay + 1 < h) visit(at + w);
+		}
+
+		Rules const &r = rules();
+		Philox random(params.seed, params.level, StreamStars);
+		for (uint32_t i = 0; i < candidates.size() && stars < params.min_stars; ++i) {
+			std::swap(candidates[i], candidates[i + random[i] % (candidates.size() - i)]);
+			uint32_t at = candidates[i];
+			uint32_t ax = at % w, ay = at / w;
+			bool ok = true;
+			if (ax > 0) ok = ok && (r.allowed[TileStar] & tile_bit(tiles[at - 1]));
+			if (ax + 1 < w) ok = ok && (r.allowed[TileStar] & tile_bit(tiles[at + 1]));
+			if (ay > 0) ok = ok && (r.allowed[TileStar] & tile_bit(tiles[at - w]));
+			if (ay + 1 < h) ok = ok && (r.allowed[TileStar] & tile_bit(tiles[at + w]));
+			if (ok) {
+				tiles[at] = TileStar;
+				++stars;
+			}
+		}
+	}
+};
+
+} //namespace
+
+TileMask allowed_neighbors(Tile t) {
+	assert(t < TileCount);
+	return rules().allowed[t];
+}
+
+std::vector< Tile > generate_board(BoardParams const &params) {
+	if (params.width == 0 || params.height == 0) {
+		throw std::runtime_error("Board must have at least one cell.");
+	}
+	if (params.start_x >= params.width || params.start_y >= params.height
+	 || params.goal_x >= params.width || params.goal_y >= params.height) {
+		throw std::runtime_error("Start and goal must be on the board.");
+	}
+	if (params.start_x == params.goal_x && params.start_y == params.goal_y) {
+		throw std::runtime_error("Start and goal must be different cells.");
+	}
+
+	Generator gen(params);
+
+	uint32_t bands = (params.height + BandHeight - 1) / BandHeight;
+	//(1) first row of every band but the first:
+	parallel_for(bands - 1, [&gen](uint32_t b){ gen.generate_seam(b + 1); });
+	//(2) with seams fixed, bands are independent:
+	parallel_for(bands, [&gen](uint32_t b){ gen.generate_band(b); });
+
+	//(3) global constraints:
+	gen.connect_goal();
+	gen.place_stars();
+
+	return std::move(gen.tiles);
+}
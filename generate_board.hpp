@@ -0,0 +1,37 @@
+#pragma once
+
+#include "tiles.hpp"
+
+#include <vector>
+#include <cstdint>
+
+//generate_board builds a board by constraint propagation ("wave function collapse"):
+// every cell starts with a domain of allowed tile types, domains are narrowed by the
+// adjacency rules below, and cells are collapsed one at a time to a weighted-random
+// choice from what remains. Afterward, walls are carved so that the goal is reachable
+// from the start and stars are added until at least min_stars are reachable (or until no reachable
+// floor cell can take one; callers should count the stars they got rather than assume min_stars).
+//
+//Rows are generated in fixed-height bands; the first row of each band is collapsed
+// up front, after which bands are independent and are generated in parallel.
+// Results depend only on the parameters (never on the number of threads):
+// random values come from a counter-based generator keyed by (seed, level) and indexed by cell (see philox.hpp).
+
+struct BoardParams {
+	uint32_t width = 8;
+	uint32_t height = 8;
+	uint32_t seed = 0;
+	uint32_t level = 0; //level id; part of the random key, so levels sharing a seed still differ
+
+	uint32_t start_x = 0, start_y = 0; //always floor
+	uint32_t goal_x = 7, goal_y = 4; //always goal
+
+	uint32_t min_stars = 5; //stars reachable from start
+};
+
+//returns a width * height, row-major grid of tiles; throws on impossible parameters:
+std::vector< Tile > generate_board(BoardParams const &params);
+
+//adjacency rules: allowed_neighbors(t) is the set of types that may sit next to a 't' tile.
+// (rules are symmetric and floor is allowed next to everything, so generation can't get stuck)
+TileMask allowed_neighbors(Tile t);
@@ -6,63 +6,6 @@
 #include "glcorearb.h"
 
 void init_gl_shims(); //will throw on failure.
-//Prototypes for 1.0,1.1 functionality, pretty sure that already exists:
-
-extern "C" {
-
-
-// GL_VERSION_1_0 prototypes:
-GLAPI void APIENTRY glCullFace (GLenum mode);
-GLAPI void APIENTRY glFrontFace (GLenum mode);
-GLAPI void APIENTRY glHint (GLenum target, GLenum mode);
-GLAPI void APIENTRY glLineWidth (GLfloat width);
-GLAPI void APIENTRY glPointSize (GLfloat size);
-GLAPI void APIENTRY glPolygonMode (GLenum face, GLenum mode);
-GLAPI void APIENTRY glScissor (GLint x, GLint y, GLsizei width, GLsizei height);
-GLAPI void APIENTRY glTexParameterf (GLenum target, GLenum pname, GLfloat param);
-GLAPI void APIENTRY glTexParameterfv (GLenum target, GLenum pname, const GLfloat *params);
-GLAPI void APIENTRY glTexParameteri (GLenum target, GLenum pname, GLint param);
-GLAPI void APIENTRY glTexParameteriv (GLenum target, GLenum pname, const GLint *params);
-GLAPI void APIENTRY glTexImage1D (GLenum target, GLint level, GLint internalformat, GLsizei width, GLint border, GLenum format, GLenum type, const void *pixels);
-GLAPI void APIENTRY glTexImage2D (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels);
-GLAPI void APIENTRY glDrawBuffer (GLenum buf);
-GLAPI void APIENTRY glClear (GLbitfield mask);
-GLAPI void APIENTRY glClearColor (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
-GLAPI void APIENTRY glClearStencil (GLint s);
-GLAPI void APIENTRY glClearDepth (GLdouble depth);
-GLAPI void APIENTRY glStencilMask (GLuint mask);
-GLAPI void APIENTRY glColorMask (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
-GLAPI void APIENTRY glDepthMask (GLboolean flag);
-GLAPI void APIENTRY glDisable (GLenum cap);
-GLAPI void APIENTRY glEnable (GLenum cap);
-GLAPI void APIENTRY glFinish (void);
-GLAPI void APIENTRY glFlush (void);
-GLAPI void APIENTRY glBlendFunc (GLenum sfactor, GLenum dfactor);
-GLAPI void APIENTRY glLogicOp (GLenum opcode);
-GLAPI void APIENTRY glStencilFunc (GLenum func, GLint ref, GLuint mask);
-GLAPI void APIENTRY glStencilOp (GLenum fail, GLenum zfail, GLenum zpass);
-GLAPI void APIENTRY glDepthFunc (GLenum func);
-GLAPI void APIENTRY glPixelStoref (GLenum pname, GLfloat param);
-GLAPI void APIENTRY glPixelStorei (GLenum pname, GLint param);
-GLAPI void APIENTRY glReadBuffer (GLenum src);
-GLAPI void APIENTRY glReadPixels (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels);
-GLAPI void APIENTRY glGetBooleanv (GLenum pname, GLboolean *data);
-GLAPI void APIENTRY glGetDoublev (GLenum pname, GLdouble *data);
-GLAPI GLenum APIENTRY glGetError (void);
-GLAPI void APIENTRY glGetFloatv (GLenum pname, GLfloat *data);
-GLAPI void APIENTRY glGetIntegerv (GLenum pname, GLint *data);
-GLAPI const GLubyte *APIENTRY glGetString (GLenum name);
-GLAPI void APIENTRY glGetTexImage (GLenum target, GLint level, GLenum format, GLenum type, void *pixels);
-GLAPI void APIENTRY glGetTexParameterfv (GLenum target, GLenum pname, GLfloat *params);
-GLAPI void APIENTRY glGetTexParameteriv (GLenum target, GLenum pname, GLint *params);
-GLAPI void APIENTRY glGetTexLevelParameterfv (GLenum target, GLint level, GLenum pname, GLfloat *params);
-GLAPI void APIENTRY glGetTexLevelParameteriv (GLenum target, GLint level, GLenum pname, GLint *params);
-GLAPI GLboolean APIENTRY glIsEnabled (GLenum cap);
-GLAPI void APIENTRY glDepthRange (GLdouble near, GLdouble far);
-GLAPI void APIENTRY glViewport (GLint x, GLint y, GLsizei width, GLsizei height);
-
-
-}
 
 #endif //PROTOTYPES
 
@@ -74,7 +17,57 @@ GLAPI void APIENTRY glViewport (GLint x, GLint y, GLsizei width, GLsizei height)
 
 
 
-// GL_VERSION_1_1 extensions:
+// GL_VERSION_1_0 functions:
+DO(CULLFACE, CullFace)
+DO(FRONTFACE, FrontFace)
+DO(HINT, Hint)
+DO(LINEWIDTH, LineWidth)
+DO(POINTSIZE, PointSize)
+DO(POLYGONMODE, PolygonMode)
+DO(SCISSOR, Scissor)
+DO(TEXPARAMETERF, TexParameterf)
+DO(TEXPARAMETERFV, TexParameterfv)
+DO(TEXPARAMETERI, TexParameteri)
+DO(TEXPARAMETERIV, TexParameteriv)
+DO(TEXIMAGE1D, TexImage1D)
+DO(TEXIMAGE2D, TexImage2D)
+DO(DRAWBUFFER, DrawBuffer)
+DO(CLEAR, Clear)
+DO(CLEARCOLOR, ClearColor)
+DO(CLEARSTENCIL, ClearStencil)
+DO(CLEARDEPTH, ClearDepth)
+DO(STENCILMASK, StencilMask)
+DO(COLORMASK, ColorMask)
+DO(DEPTHMASK, DepthMask)
+DO(DISABLE, Disable)
+DO(ENABLE, Enable)
+DO(FINISH, Finish)
+DO(FLUSH, Flush)
+DO(BLENDFUNC, BlendFunc)
+DO(LOGICOP, LogicOp)
+DO(STENCILFUNC, StencilFunc)
+DO(STENCILOP, StencilOp)
+DO(DEPTHFUNC, DepthFunc)
+DO(PIXELSTOREF, PixelStoref)
+DO(PIXELSTOREI, PixelStorei)
+DO(READBUFFER, ReadBuffer)
+DO(READPIXELS, ReadPixels)
+DO(GETBOOLEANV, GetBooleanv)
+DO(GETDOUBLEV, GetDoublev)
+DO(GETERROR, GetError)
+DO(GETFLOATV, GetFloatv)
+DO(GETINTEGERV, GetIntegerv)
+DO(GETSTRING, GetString)
+DO(GETTEXIMAGE, GetTexImage)
+DO(GETTEXPARAMETERFV, GetTexParameterfv)
+DO(GETTEXPARAMETERIV, GetTexParameteriv)
+DO(GETTEXLEVELPARAMETERFV, GetTexLevelParameterfv)
+DO(GETTEXLEVELPARAMETERIV, GetTexLevelParameteriv)
+DO(ISENABLED, IsEnabled)
+DO(DEPTHRANGE, DepthRange)
+DO(VIEWPORT, Viewport)
+
+// GL_VERSION_1_1 functions:
 DO(DRAWARRAYS, DrawArrays)
 DO(DRAWELEMENTS, DrawElements)
 DO(GETPOINTERV, GetPointerv)
@@ -90,13 +83,13 @@ DO(DELETETEXTURES, DeleteTextures)
 DO(GENTEXTURES, GenTextures)
 DO(ISTEXTURE, IsTexture)
 
-// GL_VERSION_1_2 extensions:
+// GL_VERSION_1_2 functions:
 DO(DRAWRANGEELEMENTS, DrawRangeElements)
 DO(TEXIMAGE3D, TexImage3D)
 DO(TEXSUBIMAGE3D, TexSubImage3D)
 DO(COPYTEXSUBIMAGE3D, CopyTexSubImage3D)
 
-// GL_VERSION_1_3 extensions:
+// GL_VERSION_1_3 functions:
 DO(ACTIVETEXTURE, ActiveTexture)
 DO(SAMPLECOVERAGE, SampleCoverage)
 DO(COMPRESSEDTEXIMAGE3D, CompressedTexImage3D)
@@ -107,7 +100,7 @@ DO(COMPRESSEDTEXSUBIMAGE2D, CompressedTexSubImage2D)
 DO(COMPRESSEDTEXSUBIMAGE1D, CompressedTexSubImage1D)
 DO(GETCOMPRESSEDTEXIMAGE, GetCompressedTexImage)
 
-// GL_VERSION_1_4 extensions:
+// GL_VERSION_1_4 functions:
 DO(BLENDFUNCSEPARATE, BlendFuncSeparate)
 DO(MULTIDRAWARRAYS, MultiDrawArrays)
 DO(MULTIDRAWELEMENTS, MultiDrawElements)
@@ -118,7 +111,7 @@ DO(POINTPARAMETERIV, PointParameteriv)
 DO(BLENDCOLOR, BlendColor)
 DO(BLENDEQUATION, BlendEquation)
 
-// GL_VERSION_1_5 extensions:
+// GL_VERSION_1_5 functions:
 DO(GENQUERIES, GenQueries)
 DO(DELETEQUERIES, DeleteQueries)
 DO(ISQUERY, IsQuery)
@@ -134,11 +127,12 @@ DO(ISBUFFER, IsBuffer)
 DO(BUFFERDATA, BufferData)
 DO(BUFFERSUBDATA, BufferSubData)
 DO(GETBUFFERSUBDATA, GetBufferSubData)
+DO(MAPBUFFER, MapBuffer)
 DO(UNMAPBUFFER, UnmapBuffer)
 DO(GETBUFFERPARAMETERIV, GetBufferParameteriv)
 DO(GETBUFFERPOINTERV, GetBufferPointerv)
 
-// GL_VERSION_2_0 extensions:
+// GL_VERSION_2_0 functions:
 DO(BLENDEQUATIONSEPARATE, BlendEquationSeparate)
 DO(DRAWBUFFERS, DrawBuffers)
 DO(STENCILOPSEPARATE, StencilOpSeparate)
@@ -233,7 +227,7 @@ DO(VERTEXATTRIB4UIV, VertexAttrib4uiv)
 DO(VERTEXATTRIB4USV, VertexAttrib4usv)
 DO(VERTEXATTRIBPOINTER, VertexAttribPointer)
 
-// GL_VERSION_2_1 extensions:
+// GL_VERSION_2_1 functions:
 DO(UNIFORMMATRIX2X3FV, UniformMatrix2x3fv)
 DO(UNIFORMMATRIX3X2FV, UniformMatrix3x2fv)
 DO(UNIFORMMATRIX2X4FV, UniformMatrix2x4fv)
@@ -241,7 +235,7 @@ DO(UNIFORMMATRIX4X2FV, UniformMatrix4x2fv)
 DO(UNIFORMMATRIX3X4FV, UniformMatrix3x4fv)
 DO(UNIFORMMATRIX4X3FV, UniformMatrix4x3fv)
 
-// GL_VERSION_3_0 extensions:
+// GL_VERSION_3_0 functions:
 DO(COLORMASKI, ColorMaski)
 DO(GETBOOLEANI_V, GetBooleani_v)
 DO(GETINTEGERI_V, GetIntegeri_v)
@@ -299,6 +293,7 @@ DO(CLEARBUFFERIV, ClearBufferiv)
 DO(CLEARBUFFERUIV, ClearBufferuiv)
 DO(CLEARBUFFERFV, ClearBufferfv)
 DO(CLEARBUFFERFI, ClearBufferfi)
+DO(GETSTRINGI, GetStringi)
 DO(ISRENDERBUFFER, IsRenderbuffer)
 DO(BINDRENDERBUFFER, BindRenderbuffer)
 DO(DELETERENDERBUFFERS, DeleteRenderbuffers)
@@ -319,13 +314,14 @@ DO(GENERATEMIPMAP, GenerateMipmap)
 DO(BLITFRAMEBUFFER, BlitFramebuffer)
 DO(RENDERBUFFERSTORAGEMULTISAMPLE, RenderbufferStorageMultisample)
 DO(FRAMEBUFFERTEXTURELAYER, FramebufferTextureLayer)
+DO(MAPBUFFERRANGE, MapBufferRange)
 DO(FLUSHMAPPEDBUFFERRANGE, FlushMappedBufferRange)
 DO(BINDVERTEXARRAY, BindVertexArray)
 DO(DELETEVERTEXARRAYS, DeleteVertexArrays)
 DO(GENVERTEXARRAYS, GenVertexArrays)
 DO(ISVERTEXARRAY, IsVertexArray)
 
-// GL_VERSION_3_1 extensions:
+// GL_VERSION_3_1 functions:
 DO(DRAWARRAYSINSTANCED, DrawArraysInstanced)
 DO(DRAWELEMENTSINSTANCED, DrawElementsInstanced)
 DO(TEXBUFFER, TexBuffer)
@@ -339,7 +335,7 @@ DO(GETACTIVEUNIFORMBLOCKIV, GetActiveUniformBlockiv)
 DO(GETACTIVEUNIFORMBLOCKNAME, GetActiveUniformBlockName)
 DO(UNIFORMBLOCKBINDING, UniformBlockBinding)
 
-// GL_VERSION_3_2 extensions:
+// GL_VERSION_3_2 functions:
 DO(DRAWELEMENTSBASEVERTEX, DrawElementsBaseVertex)
 DO(DRAWRANGEELEMENTSBASEVERTEX, DrawRangeElementsBaseVertex)
 DO(DRAWELEMENTSINSTANCEDBASEVERTEX, DrawElementsInstancedBaseVertex)
@@ -360,4 +356,34 @@ DO(TEXIMAGE3DMULTISAMPLE, TexImage3DMultisample)
 DO(GETMULTISAMPLEFV, GetMultisamplefv)
 DO(SAMPLEMASKI, SampleMaski)
 
+// GL_VERSION_3_3 functions:
+DO(BINDFRAGDATALOCATIONINDEXED, BindFragDataLocationIndexed)
+DO(GETFRAGDATAINDEX, GetFragDataIndex)
+DO(GENSAMPLERS, GenSamplers)
+DO(DELETESAMPLERS, DeleteSamplers)
+DO(ISSAMPLER, IsSampler)
+DO(BINDSAMPLER, BindSampler)
+DO(SAMPLERPARAMETERI, SamplerParameteri)
+DO(SAMPLERPARAMETERIV, SamplerParameteriv)
+DO(SAMPLERPARAMETERF, SamplerParameterf)
+DO(SAMPLERPARAMETERFV, SamplerParameterfv)
+DO(SAMPLERPARAMETERIIV, SamplerParameterIiv)
+DO(SAMPLERPARAMETERIUIV, SamplerParameterIuiv)
+DO(GETSAMPLERPARAMETERIV, GetSamplerParameteriv)
+DO(GETSAMPLERPARAMETERIIV, GetSamplerParameterIiv)
+DO(GETSAMPLERPARAMETERFV, GetSamplerParameterfv)
+DO(GETSAMPLERPARAMETERIUIV, GetSamplerParameterIuiv)
+DO(QUERYCOUNTER, QueryCounter)
+DO(GETQUERYOBJECTI64V, GetQueryObjecti64v)
+DO(GETQUERYOBJECTUI64V, GetQueryObjectui64v)
+DO(VERTEXATTRIBDIVISOR, VertexAttribDivisor)
+DO(VERTEXATTRIBP1UI, VertexAttribP1ui)
+DO(VERTEXATTRIBP1UIV, VertexAttribP1uiv)
+DO(VERTEXATTRIBP2UI, VertexAttribP2ui)
+DO(VERTEXATTRIBP2UIV, VertexAttribP2uiv)
+DO(VERTEXATTRIBP3UI, VertexAttribP3ui)
+DO(VERTEXATTRIBP3UIV, VertexAttribP3uiv)
+DO(VERTEXATTRIBP4UI, VertexAttribP4ui)
+DO(VERTEXATTRIBP4UIV, VertexAttribP4uiv)
+
 #endif //GL_SHIMS_HPP
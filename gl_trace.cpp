@@ -0,0 +1,291 @@
+#include "gl_trace.hpp"
+
+#include "GL.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+namespace {
+
+//one index per entry point in the gl_shims table:
+enum Call : uint32_t {
+	#undef DO
+	#define DO(TYPE, NAME) Call_ ## NAME,
+	#undef GL_SHIMS_HPP
+	#include "gl_shims.hpp"
+	#undef DO
+	CallCount
+};
+
+char const *names[CallCount] = {
+	#undef DO
+	#define DO(TYPE, NAME) "gl" #NAME,
+	#undef GL_SHIMS_HPP
+	#include "gl_shims.hpp"
+	#undef DO
+};
+
+typedef void (APIENTRY *AnyProc)();
+AnyProc real[CallCount]; //the driver's entry points
+
+struct Stats {
+	uint64_t calls = 0;
+	uint64_t redundant = 0;
+	bool timed = false;
+	std::chrono::steady_clock::duration time = std::chrono::steady_clock::duration::zero();
+};
+Stats stats[CallCount]; //since last summary
+
+//------- redundant state detection -------
+//Each tracked setter stores the value it last set; setting the same value again is redundant.
+// (This is a heuristic: it doesn't know about state changed indirectly, e.g. by deleting a bound object.)
+
+struct {
+	std::unordered_map< uint64_t, std::vector< uint8_t > > values; //state key -> last value
+	std::unordered_map< GLuint, std::unordered_map< GLint, std::vector< uint8_t > > > uniforms; //program -> location -> value
+	GLuint program = 0;
+	GLenum active_texture = GL_TEXTURE0;
+} state;
+
+//kinds of state (high bits of the state key):
+enum Kind : uint64_t { KindCall = 1, KindCap, KindTexture, KindBuffer, KindFramebuffer };
+
+//store 'size' bytes as the value of 'slot'; returns true if that is what it already held:
+bool set_value(std::vector< uint8_t > &slot, void const *data, size_t size) {
+	if (slot.size() == size && std::memcmp(slot.data(), data, size) == 0) return true;
+	slot.assign(reinterpret_cast< uint8_t const * >(data), reinterpret_cast< uint8_t const * >(data) + size);
+	return false;
+}
+
+template< typename... A >
+bool set_args(uint64_t key, A... args) {
+	uint8_t bytes[64];
+	size_t size = 0;
+	for (auto const &arg : { std::make_pair(static_cast< void const * >(&args), sizeof(args))... }) {
+		std::memcpy(bytes + size, arg.first, arg.second);
+		size += arg.second;
+	}
+	return set_value(state.values[key], bytes, size);
+}
+
+uint64_t key(Kind kind, uint64_t selector) {
+	return (uint64_t(kind) << 56) | selector;
+}
+
+bool set_uniform(GLint location, void const *data, size_t size) {
+	if (location < 0) return false; //(not a real uniform; GL ignores the call)
+	return set_value(state.uniforms[state.program][location], data, size);
+}
+
+//by default, a call doesn't set tracked state:
+template< uint32_t I, typename... A >
+bool track_state(std::integral_constant< uint32_t, I >, A...) { return false; }
+
+template< uint32_t I >
+using Is = std::integral_constant< uint32_t, I >;
+
+//bindings:
+bool track_state(Is< Call_UseProgram >, GLuint program) {
+	state.program = program;
+	return set_args(key(KindCall, Call_UseProgram), program);
+}
+bool track_state(Is< Call_BindVertexArray >, GLuint array) {
+	return set_args(key(KindCall, Call_BindVertexArray), array);
+}
+bool track_state(Is< Call_ActiveTexture >, GLenum texture) {
+	state.active_texture = texture;
+	return set_args(key(KindCall, Call_ActiveTexture), texture);
+}
+bool track_state(Is< Call_BindTexture >, GLenum target, GLuint texture) {
+	return set_args(key(KindTexture, (uint64_t(state.active_texture) << 32) | target), texture);
+}
+bool track_state(Is< Call_BindBuffer >, GLenum target, GLuint buffer) {
+	return set_args(key(KindBuffer, target), buffer);
+}
+bool track_state(Is< Call_BindFramebuffer >, GLenum target, GLuint framebuffer) {
+	return set_args(key(KindFramebuffer, target), framebuffer);
+}
+
+//capabilities:
+bool track_state(Is< Call_Enable >, GLenum cap) {
+	return set_args(key(KindCap, cap), true);
+}
+bool track_state(Is< Call_Disable >, GLenum cap) {
+	return set_args(key(KindCap, cap), false);
+}
+
+//fixed-function state set all at once:
+#define TRACK_ARGS(NAME, PARAMS, ARGS) \
+	bool track_state(Is< Call_ ## NAME >, PARAMS) { \
+		return set_args(key(KindCall, Call_ ## NAME), ARGS); \
+	}
+#define P(...) __VA_ARGS__
+TRACK_ARGS(DepthFunc, GLenum func, func)
+TRACK_ARGS(DepthMask, GLboolean flag, flag)
+TRACK_ARGS(CullFace, GLenum mode, mode)
+TRACK_ARGS(BlendFunc, P(GLenum sfactor, GLenum dfactor), P(sfactor, dfactor))
+TRACK_ARGS(ColorMask, P(GLboolean r, GLboolean g, GLboolean b, GLboolean a), P(r, g, b, a))
+TRACK_ARGS(PolygonOffset, P(GLfloat factor, GLfloat units), P(factor, units))
+TRACK_ARGS(Viewport, P(GLint x, GLint y, GLsizei width, GLsizei height), P(x, y, width, height))
+TRACK_ARGS(ClearColor, P(GLfloat r, GLfloat g, GLfloat b, GLfloat a), P(r, g, b, a))
+#undef P
+#undef TRACK_ARGS
+
+//uniforms (per program):
+bool track_state(Is< Call_Uniform1i >, GLint location, GLint v0) {
+	return set_uniform(location, &v0, sizeof(v0));
+}
+bool track_state(Is< Call_Uniform1f >, GLint location, GLfloat v0) {
+	return set_uniform(location, &v0, sizeof(v0));
+}
+bool track_state(Is< Call_Uniform2f >, GLint location, GLfloat v0, GLfloat v1) {
+	GLfloat v[2] = { v0, v1 };
+	return set_uniform(location, v, sizeof(v));
+}
+bool track_state(Is< Call_Uniform3f >, GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+	GLfloat v[3] = { v0, v1, v2 };
+	return set_uniform(location, v, sizeof(v));
+}
+bool track_state(Is< Call_Uniform4f >, GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+	GLfloat v[4] = { v0, v1, v2, v3 };
+	return set_uniform(location, v, sizeof(v));
+}
+bool track_state(Is< Call_Uniform3fv >, GLint location, GLsizei count, GLfloat const *value) {
+	return set_uniform(location, value, sizeof(GLfloat) * 3 * count);
+}
+bool track_state(Is< Call_Uniform4fv >, GLint location, GLsizei count, GLfloat const *value) {
+	return set_uniform(location, value, sizeof(GLfloat) * 4 * count);
+}
+bool track_state(Is< Call_UniformMatrix3fv >, GLint location, GLsizei count, GLboolean, GLfloat const *value) {
+	return set_uniform(location, value, sizeof(GLfloat) * 9 * count);
+}
+bool track_state(Is< Call_UniformMatrix4x3fv >, GLint location, GLsizei count, GLboolean, GLfloat const *value) {
+	return set_uniform(location, value, sizeof(GLfloat) * 12 * count);
+}
+bool track_state(Is< Call_UniformMatrix4fv >, GLint location, GLsizei count, GLboolean, GLfloat const *value) {
+	return set_uniform(location, value, sizeof(GLfloat) * 16 * count);
+}
+
+//linking or deleting a program resets its uniforms:
+bool track_state(Is< Call_LinkProgram >, GLuint program) {
+	state.uniforms.erase(program);
+	return false;
+}
+bool track_state(Is< Call_DeleteProgram >, GLuint program) {
+	state.uniforms.erase(program);
+	return false;
+}
+
+//------- the wrappers -------
+//Tracer< I, PFN... >::call has exactly the signature of the entry point it replaces:
+
+template< uint32_t I, typename F >
+struct Tracer;
+
+template< uint32_t I, typename R, typename... A >
+struct Tracer< I, R (APIENTRY *)(A...) > {
+	static R APIENTRY call(A... args) {
+		Stats &s = stats[I];
+		s.calls += 1;
+		if (track_state(Is< I >(), args...)) s.redundant += 1;
+		R (APIENTRY *fn)(A...) = reinterpret_cast< R (APIENTRY *)(A...) >(real[I]);
+		if (!s.timed) return fn(args...);
+		struct Timer {
+			Timer(Stats &s_) : s(s_), before(std::chrono::steady_clock::now()) { }
+			~Timer() { s.time += std::chrono::steady_clock::now() - before; }
+			Stats &s;
+			std::chrono::steady_clock::time_point before;
+		} timer(s);
+		return fn(args...);
+	}
+};
+
+bool enabled = false;
+uint32_t frames = 0;
+std::chrono::steady_clock::time_point since;
+
+} //namespace
+
+void gl_trace_enable(std::vector< std::string > const &timed) {
+	for (auto const &name : timed) {
+		auto f = std::find_if(names, names + CallCount, [&](char const *n){ return name == n; });
+		if (f == names + CallCount) {
+			throw std::runtime_error("Can't time '" + name + "': not a GL entry point.");
+		}
+		stats[f - names].timed = true;
+	}
+
+	if (enabled) return;
+	enabled = true;
+	#undef DO
+	#define DO(TYPE, NAME) \
+		real[Call_ ## NAME] = reinterpret_cast< AnyProc >(gl ## NAME); \
+		gl ## NAME = &Tracer< Call_ ## NAME, PFNGL ## TYPE ## PROC >::call;
+	#undef GL_SHIMS_HPP
+	#include "gl_shims.hpp"
+	#undef DO
+
+	since = std::chrono::steady_clock::now();
+}
+
+void gl_trace_frame() {
+	if (!enabled) return;
+	frames += 1;
+	auto now = std::chrono::steady_clock::now();
+	if (now - since < std::chrono::seconds(1)) return;
+
+	uint64_t calls = 0, redundant = 0;
+	std::vector< uint32_t > order;
+	for (uint32_t i = 0; i < CallCount; ++i) {
+		calls += stats[i].calls;
+		redundant += stats[i].redundant;
+		if (stats[i].calls) order.emplace_back(i);
+	}
+
+	double per_frame = 1.0 / frames;
+	std::cout << std::fixed << std::setprecision(1)
+		<< "[gl_trace] " << frames << " frames: " << calls * per_frame << " calls/frame, "
+		<< redundant * per_frame << " redundant/frame\n";
+
+	std::sort(order.begin(), order.end(), [](uint32_t a, uint32_t b){ return stats[a].calls > stats[b].calls; });
+	std::cout << "  most called:";
+	for (uint32_t j = 0; j < order.size() && j < 5; ++j) {
+		std::cout << " " << names[order[j]] << " " << stats[order[j]].calls * per_frame << ";";
+	}
+	std::cout << "\n";
+
+	std::sort(order.begin(), order.end(), [](uint32_t a, uint32_t b){ return stats[a].redundant > stats[b].redundant; });
+	if (!order.empty() && stats[order[0]].redundant) {
+		std::cout << "  most redundant:";
+		for (uint32_t j = 0; j < order.size() && j < 5 && stats[order[j]].redundant; ++j) {
+			Stats const &s = stats[order[j]];
+			std::cout << " " << names[order[j]] << " " << s.redundant * per_frame
+				<< " (" << int(100 * s.redundant / s.calls) << "%);";
+		}
+		std::cout << "\n";
+	}
+
+	for (uint32_t i = 0; i < CallCount; ++i) {
+		if (!stats[i].timed || !stats[i].calls) continue;
+		double us = std::chrono::duration< double, std::micro >(stats[i].time).count();
+		std::cout << "  timed: " << names[i] << " " << us * per_frame << "us/frame ("
+			<< std::setprecision(2) << us / stats[i].calls << std::setprecision(1) << "us/call)\n";
+	}
+	std::cout.flush();
+	std::cout.unsetf(std::ios::floatfield);
+
+	for (uint32_t i = 0; i < CallCount; ++i) {
+		bool timed = stats[i].timed;
+		stats[i] = Stats();
+		stats[i].timed = timed;
+	}
+	frames = 0;
+	since = now;
+}
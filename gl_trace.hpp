@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//gl_trace interposes on every entry point in the gl_shims table (so it is only available when GL_SHIMS is defined; see GL.hpp).
+// Once enabled, every GL call is counted, the entry points named in 'timed' are also timed (CPU time spent in the call),
+// and calls that set state to the value it already has (e.g. glUseProgram of the current program,
+// glUniform* of the value a uniform already holds) are flagged as redundant.
+//While disabled (the default) the table points straight at the driver, so tracing costs nothing.
+
+//install the tracing wrappers (call after init_gl_shims()); throws if a name in 'timed' isn't a GL entry point:
+void gl_trace_enable(std::vector< std::string > const &timed);
+
+//call once per frame; about once a second, prints per-frame averages and the worst offenders:
+void gl_trace_frame();
@@ -1,9 +1,20 @@
 //Game.hpp declares the "game" object, which handles game-specific stuff:
 #include "Game.hpp"
 
+//FramePacer.hpp declares the helper that decides when each frame starts:
+#include "FramePacer.hpp"
+
+//Capture.hpp declares the (optional) video recorder:
+#include "Capture.hpp"
+
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
+//gl_trace.hpp declares the (optional) GL call counting layer:
+#ifdef GL_SHIMS
+#include "gl_trace.hpp"
+#endif
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -19,6 +30,10 @@
 #include <fstream>
 #include <memory>
 #include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
 
 int main(int argc, char **argv) {
 	struct {
@@ -26,8 +41,127 @@ int main(int argc, char **argv) {
 		std::string title = "Slide2heart";
 		// 640 *480 Resolution
 		glm::uvec2 size = glm::uvec2(640, 400);
+		//board setup, see Game::Options:
+		Game::Options game;
+		//when frames start (see FramePacer.hpp):
+		FramePacer::Mode pacing = FramePacer::VSync;
+		//count GL calls (see gl_trace.hpp), additionally timing these entry points:
+		bool gl_trace = false;
+		std::vector< std::string > gl_time;
+		//record video here (see Capture.hpp):
+		std::string capture;
 	} config;
 
+	//------------  command line ------------
+	//  --board WxH   board size in cells
+	//  --seed N      board layout seed
+	//  --agents N    number of rival agents
+	//  --level FILE[:N]   load level N (default 0) of a level pack made with the editor
+	//  --pacing vsync|latency   start frames right after the last swap (default), or as late as possible
+	//  --render-scale S   draw the scene at S (0.1 to 1) times the window resolution, then scale it up
+	//  --gl-trace [NAME,...]   print GL call counts (and time the named entry points) about once a second
+	//  --capture FILE   record what's drawn to a .y4m (or gzip'd .y4m.gz) video
+	//  --record FILE   record a replay of the session (see Replay.hpp)
+	//  --keyframe-interval N   moves between keyframes in recorded replays
+	//  --replay FILE   view a recorded replay
+	//  --ghosts FILE   race the runs recorded in a ghost journal (see GhostJournal.hpp)
+	//  --record-ghost FILE   add this session's run to a ghost journal
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		auto next_arg = [&]() -> std::string {
+			if (argi + 1 >= argc) {
+				std::cerr << "Expected a value after '" << arg << "'." << std::endl;
+				exit(1);
+			}
+			return argv[++argi];
+		};
+		//numeric values must be a whole number (no trailing junk) in range:
+		auto next_uint = [&]() -> uint32_t {
+			std::string val = next_arg();
+			try {
+				size_t used = 0;
+				unsigned long value = std::stoul(val, &used);
+				if (used == val.size() && val[0] != '-' && value <= 0xffffffffUL) return uint32_t(value);
+			} catch (std::logic_error &) {
+			}
+			std::cerr << "Expected a whole number after '" << arg << "', got '" << val << "'." << std::endl;
+			exit(1);
+		};
+		auto next_float = [&]() -> float {
+			std::string val = next_arg();
+			try {
+				size_t used = 0;
+				float value = std::stof(val, &used);
+				if (used == val.size()) return value;
+			} catch (std::logic_error &) {
+			}
+			std::cerr << "Expected a number after '" << arg << "', got '" << val << "'." << std::endl;
+			exit(1);
+		};
+		if (arg == "--board") {
+			std::string val = next_arg();
+			unsigned int w = 0, h = 0;
+			if (sscanf(val.c_str(), "%ux%u", &w, &h) != 2 || w < 2 || h < 2) {
+				std::cerr << "Expected board size like '8x8', got '" << val << "'." << std::endl;
+				return 1;
+			}
+			config.game.board_size = glm::uvec2(w, h);
+		} else if (arg == "--seed") {
+			config.game.seed = next_uint();
+		} else if (arg == "--agents") {
+			config.game.agent_count = next_uint();
+		} else if (arg == "--level") {
+			std::string val = next_arg();
+			size_t colon = val.rfind(':');
+			if (colon != std::string::npos && colon + 1 < val.size() && val.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+				//(all digits, but possibly too many of them)
+				if (val.size() - (colon + 1) > 9) {
+					std::cerr << "Expected a level number after ':' in '" << val << "'." << std::endl;
+					return 1;
+				}
+				config.game.level = uint32_t(std::stoul(val.substr(colon + 1)));
+				val = val.substr(0, colon);
+			}
+			config.game.level_pack = val;
+		} else if (arg == "--pacing") {
+			std::string val = next_arg();
+			if (val == "vsync") config.pacing = FramePacer::VSync;
+			else if (val == "latency") config.pacing = FramePacer::Latency;
+			else {
+				std::cerr << "Expected pacing mode 'vsync' or 'latency', got '" << val << "'." << std::endl;
+				return 1;
+			}
+		} else if (arg == "--render-scale") {
+			config.game.render_scale = next_float();
+		} else if (arg == "--record") {
+			config.game.record = next_arg();
+		} else if (arg == "--keyframe-interval") {
+			config.game.keyframe_interval = next_uint();
+		} else if (arg == "--replay") {
+			config.game.replay = next_arg();
+		} else if (arg == "--ghosts") {
+			config.game.ghosts = next_arg();
+		} else if (arg == "--record-ghost") {
+			config.game.record_ghost = next_arg();
+		} else if (arg == "--capture") {
+			config.capture = next_arg();
+		} else if (arg == "--gl-trace") {
+			config.gl_trace = true;
+			//optional comma-separated list of entry points to time:
+			if (argi + 1 < argc && argv[argi + 1][0] != '-') {
+				std::string val = argv[++argi];
+				for (size_t begin = 0; begin <= val.size(); ) {
+					size_t end = std::min(val.find(',', begin), val.size());
+					if (end > begin) config.gl_time.emplace_back(val.substr(begin, end - begin));
+					begin = end + 1;
+				}
+			}
+		} else {
+			std::cerr << "Unrecognized argument '" << arg << "'." << std::endl;
+			return 1;
+		}
+	}
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -72,9 +206,12 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 
-	#ifdef _WIN32
-	//On windows, load OpenGL extensions:
+	#ifdef GL_SHIMS
+	//On windows and linux, load OpenGL entry points:
 	init_gl_shims();
+	if (config.gl_trace) gl_trace_enable(config.gl_time);
+	#else
+	if (config.gl_trace) std::cerr << "NOTE: --gl-trace needs GL calls to go through gl_shims (not available on this platform)." << std::endl;
 	#endif
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
@@ -85,6 +222,16 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	//Frame pacing starts from the display's nominal refresh rate (and refines it from measured frame times):
+	float refresh_rate = 60.0f;
+	{
+		SDL_DisplayMode mode;
+		if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) == 0 && mode.refresh_rate > 0) {
+			refresh_rate = float(mode.refresh_rate);
+		}
+	}
+	FramePacer pacer(config.pacing, refresh_rate);
+
 	//Hide mouse cursor (note: showing can be useful for debugging):
 	//SDL_ShowCursor(SDL_DISABLE);
 
@@ -92,7 +239,7 @@ int main(int argc, char **argv) {
 	//------------ create game object (loads assets) --------------
 
 	
-	std::shared_ptr< Game > game = std::make_shared< Game >();
+	std::shared_ptr< Game > game = std::make_shared< Game >(config.game);
 
 	//------------ main loop ------------
 
@@ -112,11 +259,21 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	//video capture runs at the window's size when it starts (frames drawn at other sizes are skipped):
+	std::unique_ptr< Capture > capture;
+	if (config.capture != "") {
+		capture.reset(new Capture(config.capture, drawable_size, uint32_t(refresh_rate + 0.5f)));
+	}
+
 	//This will loop until the game object is set to null:
 	while (game) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		//(in latency pacing mode, first sleep until just before the frame needs to start)
+		pacer.wait();
+		pacer.sample_input();
+
 		{ //(1) process any events that are pending
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
@@ -150,9 +307,7 @@ int main(int argc, char **argv) {
 		}
 
 		{ //(3) call the game's "draw" function to produce output:
-			//clear the depth+color buffers and set some default state:
-			glClearColor(0.5, 0.5, 0.5, 0.0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			//set some default state (passes clear what they draw to; see RenderGraph.hpp):
 			glEnable(GL_DEPTH_TEST);
 			glEnable(GL_BLEND);
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -160,13 +315,29 @@ int main(int argc, char **argv) {
 			game->draw(drawable_size);
 		}
 
+		//(starts reading back this frame; earlier frames' readbacks are handed off once the GPU is done with them)
+		if (capture) capture->frame(drawable_size);
+
+		//in latency mode, rendering must be complete (not just queued) for render times to be measured:
+		if (pacer.mode == FramePacer::Latency) glFinish();
+		pacer.rendered();
+
 		//Finally, wait until the recently-drawn frame is shown before doing it all again:
 		SDL_GL_SwapWindow(window);
+		//(...and in latency mode, block until the swap has really happened, so the present time is known)
+		if (pacer.mode == FramePacer::Latency) glFinish();
+		pacer.presented();
+
+		#ifdef GL_SHIMS
+		gl_trace_frame();
+		#endif
 	}
 
 
 	//------------  teardown ------------
 
+	capture.reset(); //(needs the context to finish reading back frames)
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -1,10 +1,11 @@
 #!/usr/bin/env python3
 
 #create gl_shims.hpp by parsing everything from glcorearb.h (why not the regsistry xml, hmmmm?) and selecting only things that are core through version 3_3.
+#every function (even 1.0 functionality) goes through the table, so that gl_trace.cpp can interpose on all of them.
+#usage: python3 make-gl-shims.py > gl_shims.hpp
 
 import re
 
-protos = []
 extensions = []
 
 with open('glcorearb.h', 'r') as f:
@@ -16,26 +17,15 @@ with open('glcorearb.h', 'r') as f:
 			in_version = m.group(1)
 			major = int(m.group(2))
 			minor = int(m.group(3))
-			if (major,minor) < (1,1):
-				protos.append("\n// " + in_version + " prototypes:\n")
-				do_proto = True
-				do_extension = False
-			elif (major,minor) < (3,3):
-				extensions.append("\n// " + in_version + " extensions:\n")
-				do_proto = False
+			if (major,minor) <= (3,3):
+				extensions.append("\n// " + in_version + " functions:\n")
 				do_extension = True
 			else:
-				do_proto = False
 				do_extension = False
 		if in_version:
-			if do_proto:
-				m = re.match(r"^GLAPI ", line)
-				if m != None:
-					protos.append(line)
-				pass
 			if do_extension:
 			#	m = re.match(r".* PFNGL([^)]+)PROC\)", line)
-				m = re.match(r"GLAPI .* APIENTRY gl([^ ]+) \(", line)
+				m = re.match(r"GLAPI .*[ *]APIENTRY gl([^ ]+) \(", line)
 				if m != None:
 					lc = m.group(1)
 					uc = lc.upper()
@@ -53,15 +43,6 @@ print("""#ifndef GL_SHIMS_HPP
 #include "glcorearb.h"
 
 void init_gl_shims(); //will throw on failure.
-//Prototypes for 1.0,1.1 functionality, pretty sure that already exists:
-
-extern "C" {
-""")
-
-print("".join(protos))
-
-print("""
-}
 
 #endif //PROTOTYPES
 
@@ -23,6 +23,7 @@ outfile = args[1]
 
 import bpy, mathutils
 import struct
+import hashlib
 
 import argparse
 
@@ -47,7 +48,16 @@ strings = b''
 #index gives offsets into the data (and names) for each mesh:
 index = b''
 
+#bounds gives an axis-aligned box and a bounding sphere for each mesh (same order as index):
+bounds = b''
+
+#meshes are stored by content: identical vertex data (after triangulation and normal computation)
+# is written to 'data' once, and every object using it gets an index entry pointing at the same range.
+#stored maps sha256(vertex data) -> (vertex_begin, vertex_end, offset of the data in 'data'):
+stored = dict()
+
 vertex_count = 0
+shared_count = 0
 for name in to_write:
 	print("Writing '" + name + "'...")
 	bpy.ops.object.mode_set(mode='OBJECT') #get out of edit mode (just in case)
@@ -81,9 +91,6 @@ for name in to_write:
 	index += struct.pack('I', name_begin)
 	index += struct.pack('I', name_end)
 
-	index += struct.pack('I', vertex_count)
-	index += struct.pack('I', vertex_count + len(mesh.polygons) * 3)
-
 	uvs = None
 	if do_texcoord:
 		if len(obj.data.uv_layers) == 0:
@@ -99,6 +106,14 @@ for name in to_write:
 		else:
 			cols = obj.data.vertex_colors.active.data
 
+	#track extents while writing the mesh:
+	bbox_min = [float('inf')] * 3
+	bbox_max = [float('-inf')] * 3
+	positions = []
+
+	#vertex data for this mesh (appended to 'data' below, unless identical data is already there):
+	mesh_data = b''
+
 	#write the mesh:
 	for poly in mesh.polygons:
 		assert(len(poly.loop_indices) == 3)  # Is it triangle that's why?
@@ -107,9 +122,14 @@ for name in to_write:
 			loop = mesh.loops[poly.loop_indices[i]]
 			vertex = mesh.vertices[loop.vertex_index]
 			for x in mesh.vertices[loop.vertex_index].co:
-				data += struct.pack('f', x)
+				mesh_data += struct.pack('f', x)
+			co = tuple(struct.unpack('fff', struct.pack('fff', *vertex.co))) #(rounded to float, as written)
+			positions.append(co)
+			for c in range(0,3):
+				bbox_min[c] = min(bbox_min[c], co[c])
+				bbox_max[c] = max(bbox_max[c], co[c])
 			for x in loop.normal:
-				data += struct.pack('f', x)
+				mesh_data += struct.pack('f', x)
 
 			#TODO: set 'col' based on object's active vertex colors array.
 			#pdb.set_trace()
@@ -117,9 +137,9 @@ for name in to_write:
 				if cols!=None:
 					col=mesh.vertex_colors['Col'].data[poly.vertices[i]].color # http://blenderscripting.blogspot.com/2013/03/vertex-color-map.html
 					# data += struct.pack('BBBB', int(col[0] * 255), int(col[1] * 255), int(col[2] * 255), 255)
-					data += struct.pack('BBBB', int(col.r * 255), int(col.g * 255), int(col.b * 255), 255)
+					mesh_data += struct.pack('BBBB', int(col.r * 255), int(col.g * 255), int(col.b * 255), 255)
 				else:
-					data +=struct.pack('BBBB',0,0,0,0)
+					mesh_data += struct.pack('BBBB',0,0,0,0)
 
 
 			# you should be able to use code much like the texcoord code below.
@@ -130,29 +150,70 @@ for name in to_write:
 			if do_texcoord:
 				if uvs != None:
 					uv = uvs[poly.loop_indices[i]].uv
-					data += struct.pack('ff', uv.x, uv.y)
+					mesh_data += struct.pack('ff', uv.x, uv.y)
 				else:
-					data += struct.pack('ff', 0, 0)
-	vertex_count += len(mesh.polygons) * 3
+					mesh_data += struct.pack('ff', 0, 0)
+	#record the vertex range in the index, sharing the range of any identical mesh already written:
+	key = hashlib.sha256(mesh_data).digest()
+	if key in stored and data[stored[key][2] : stored[key][2] + len(mesh_data)] == mesh_data:
+		print("  (same data as an earlier mesh; sharing its vertices)")
+		shared_count += 1
+	else:
+		stored[key] = (vertex_count, vertex_count + len(mesh.polygons) * 3, len(data))
+		data += mesh_data
+		vertex_count += len(mesh.polygons) * 3
+	index += struct.pack('I', stored[key][0])
+	index += struct.pack('I', stored[key][1])
+
+	#bounds: box min, box max, sphere center (box center), sphere radius:
+	if len(positions) == 0:
+		bbox_min = [0.0] * 3
+		bbox_max = [0.0] * 3
+	center = [0.5 * (bbox_min[c] + bbox_max[c]) for c in range(0,3)]
+	radius = 0.0
+	for co in positions:
+		radius = max(radius, sum((co[c] - center[c]) ** 2 for c in range(0,3)) ** 0.5)
+	bounds += struct.pack('fff', *bbox_min)
+	bounds += struct.pack('fff', *bbox_max)
+	bounds += struct.pack('fff', *center)
+	bounds += struct.pack('f', radius)
 
 #check that we wrote as much data as anticipated:
 assert(vertex_count * (4*3+4*3+4*1) == len(data))
 
+#CRC32C (Castagnoli) of a bytes object, matching crc32c() in crc32c.cpp:
+crc32c_table = []
+for b in range(0, 256):
+	c = b
+	for i in range(0, 8):
+		c = (c >> 1) ^ (0x82f63b78 if (c & 1) else 0)
+	crc32c_table.append(c)
+
+def crc32c(data):
+	crc = 0xffffffff
+	for b in data:
+		crc = (crc >> 8) ^ crc32c_table[(crc ^ b) & 0xff]
+	return crc ^ 0xffffffff
+
+#each chunk is: magic, length, CRC32C of contents, contents:
+def write_chunk(blob, magic, contents):
+	blob.write(struct.pack('4s', magic)) #type
+	blob.write(struct.pack('I', len(contents))) #length
+	blob.write(struct.pack('I', crc32c(contents))) #checksum
+	blob.write(contents)
+
 #write the data chunk and index chunk to an output blob:
 blob = open(outfile, 'wb')
 #first chunk: the data
-blob.write(struct.pack('4s',b'dat0')) #type
-blob.write(struct.pack('I', len(data))) #length
-blob.write(data)
+write_chunk(blob, b'dat0', data)
 #second chunk: the strings
-blob.write(struct.pack('4s',b'str0')) #type
-blob.write(struct.pack('I', len(strings))) #length
-blob.write(strings)
+write_chunk(blob, b'str0', strings)
 #third chunk: the index
-blob.write(struct.pack('4s',b'idx0')) #type
-blob.write(struct.pack('I', len(index))) #length
-blob.write(index)
+write_chunk(blob, b'idx0', index)
+#fourth chunk: the bounds
+write_chunk(blob, b'bnd0', bounds)
 
-print("Wrote " + str(blob.tell()) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Wrote " + str(len(to_write)) + " meshes (" + str(shared_count) + " sharing vertex data with another mesh).")
+print("Wrote " + str(blob.tell()) + " bytes [== " + str(len(data)+12) + " bytes of data + " + str(len(strings)+12) + " bytes of strings + " + str(len(index)+12) + " bytes of index + " + str(len(bounds)+12) + " bytes of bounds] to '" + outfile + "'")
 
 blob.close()
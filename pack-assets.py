@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+
+#Builds an asset pack (see AssetPack.hpp) from files in a data directory:
+#python3 pack-assets.py <data dir> <outfile.pack> <asset> [<asset> ...]
+# where each <asset> is a path relative to <data dir> (and is the path the game asks for).
+
+import sys
+import struct
+
+if len(sys.argv) < 4:
+	print("\n\nUsage:\npython3 pack-assets.py <data dir> <outfile.pack> <asset> [<asset> ...]\nPacks the named assets (paths relative to the data dir) into a single file.\n")
+	exit(1)
+
+data_dir = sys.argv[1]
+outfile = sys.argv[2]
+assets = sys.argv[3:]
+
+#FNV-1a of the path, matching asset_hash() in AssetPack.hpp:
+def asset_hash(path):
+	h = 0xcbf29ce484222325
+	for b in path.encode('utf8'):
+		h = ((h ^ b) * 0x100000001b3) & 0xffffffffffffffff
+	return h
+
+#CRC32C (Castagnoli), matching crc32c() in crc32c.cpp:
+crc32c_table = []
+for b in range(0, 256):
+	c = b
+	for i in range(0, 8):
+		c = (c >> 1) ^ (0x82f63b78 if (c & 1) else 0)
+	crc32c_table.append(c)
+
+def crc32c(data):
+	crc = 0xffffffff
+	for b in data:
+		crc = (crc >> 8) ^ crc32c_table[(crc ^ b) & 0xff]
+	return crc ^ 0xffffffff
+
+#each chunk is: magic, length, CRC32C of contents, contents:
+def write_chunk(blob, magic, contents):
+	blob.write(struct.pack('4s', magic)) #type
+	blob.write(struct.pack('I', len(contents))) #length
+	blob.write(struct.pack('I', crc32c(contents))) #checksum
+	blob.write(contents)
+
+#fil0's contents will start after both chunk headers and the directory:
+files_offset = 12 + len(assets) * 24 + 12
+
+entries = [] #(hash, begin, end, crc, path)
+files = b''
+for path in assets:
+	with open(data_dir + '/' + path, 'rb') as f:
+		contents = f.read()
+	files += b'\0' * (-(files_offset + len(files)) % 16) #align each asset to 16 bytes (within the file, so also in memory)
+	entries.append((asset_hash(path), len(files), len(files) + len(contents), crc32c(contents), path))
+	files += contents
+
+entries.sort()
+for i in range(1, len(entries)):
+	if entries[i-1][0] == entries[i][0]:
+		print("Paths '" + entries[i-1][4] + "' and '" + entries[i][4] + "' have the same hash (or are duplicates).")
+		exit(1)
+
+directory = b''
+for (h, begin, end, crc, path) in entries:
+	directory += struct.pack('QIIII', h, begin, end, crc, 0)
+assert(len(directory) + 24 == files_offset)
+
+blob = open(outfile, 'wb')
+#first chunk: the directory (must come first; the runtime finds fil0 right after it)
+write_chunk(blob, b'dir0', directory)
+#second chunk: the file contents
+write_chunk(blob, b'fil0', files)
+
+print("Wrote " + str(blob.tell()) + " bytes [== " + str(len(directory)+12) + " bytes of directory + " + str(len(files)+12) + " bytes of files] for " + str(len(entries)) + " assets to '" + outfile + "'")
+
+blob.close()
@@ -0,0 +1,41 @@
+#include "parallel_for.hpp"
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <system_error>
+#include <vector>
+#include <algorithm>
+
+void parallel_for(uint32_t count, std::function< void(uint32_t) > const &fn) {
+	uint32_t threads = std::max(1u, std::min(count, std::thread::hardware_concurrency()));
+	std::atomic< uint32_t > next(0);
+	std::exception_ptr error; //first exception thrown by any worker
+	std::mutex error_mutex;
+	auto work = [&]() {
+		try {
+			for (uint32_t i = next++; i < count; i = next++) {
+				fn(i);
+			}
+		} catch (...) {
+			std::lock_guard< std::mutex > lock(error_mutex);
+			if (!error) error = std::current_exception();
+			next = count; //stop handing out work
+		}
+	};
+	std::vector< std::thread > workers;
+	workers.reserve(threads - 1);
+	for (uint32_t t = 1; t < threads; ++t) {
+		try {
+			workers.emplace_back(work);
+		} catch (std::system_error &) {
+			break; //(out of threads; the rest of the work goes to the threads already running)
+		}
+	}
+	work();
+	for (auto &w : workers) {
+		w.join();
+	}
+	if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+//parallel_for runs fn(0) .. fn(count-1), spread over at most std::thread::hardware_concurrency() threads
+// (counting the calling thread, which takes a share of the work). Indices are handed out one at a time,
+// so each is typically a batch of work rather than a single item:
+//   parallel_for(batches, [&](uint32_t b){ process(b * BatchSize, std::min(count, (b + 1) * BatchSize)); });
+// If some threads can't be started, the ones that did (at least the calling thread) do all the work.
+// The first exception thrown by fn is rethrown once every thread has stopped.
+void parallel_for(uint32_t count, std::function< void(uint32_t) > const &fn);
@@ -0,0 +1,107 @@
+#include "perf_counters.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+char const *PerfCounters::name(Counter counter) {
+	switch (counter) {
+		case Cycles: return "cycles";
+		case Instructions: return "instructions";
+		case L1DMisses: return "l1d-misses";
+		case LLCMisses: return "llc-misses";
+		case BranchMisses: return "branch-misses";
+		default: return "?";
+	}
+}
+
+bool PerfCounters::any_available() const {
+	for (uint32_t c = 0; c < CounterCount; ++c) {
+		if (available(Counter(c))) return true;
+	}
+	return false;
+}
+
+#ifdef __linux__
+
+PerfCounters::PerfCounters() {
+	for (uint32_t c = 0; c < CounterCount; ++c) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		if (c == Cycles) attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		else if (c == Instructions) attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		else if (c == LLCMisses) attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		else if (c == BranchMisses) attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		else if (c == L1DMisses) {
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		}
+		attr.disabled = 1;
+		attr.inherit = 1; //(also count threads started while counting, e.g. Agents::step's workers)
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		//(this thread, any cpu, no group)
+		fds[c] = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+		if (fds[c] < 0 && error.empty()) {
+			int err = errno;
+			error = std::string("perf_event_open(") + name(Counter(c)) + "): " + std::strerror(err);
+			if (err == EACCES || err == EPERM) error += " (see /proc/sys/kernel/perf_event_paranoid)";
+		}
+	}
+}
+
+PerfCounters::~PerfCounters() {
+	for (uint32_t c = 0; c < CounterCount; ++c) {
+		if (fds[c] >= 0) close(fds[c]);
+	}
+}
+
+void PerfCounters::start() {
+	for (uint32_t c = 0; c < CounterCount; ++c) {
+		if (fds[c] < 0) continue;
+		ioctl(fds[c], PERF_EVENT_IOC_RESET, 0);
+		ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void PerfCounters::stop() {
+	for (uint32_t c = 0; c < CounterCount; ++c) {
+		if (fds[c] >= 0) ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+	}
+	for (uint32_t c = 0; c < CounterCount; ++c) {
+		values[c] = 0;
+		if (fds[c] < 0) continue;
+		uint64_t data[3] = { 0, 0, 0 }; //value, time enabled, time running
+		if (read(fds[c], data, sizeof(data)) != ssize_t(sizeof(data)) || data[2] == 0) continue;
+		//(scale up if the counter was only scheduled for part of the time)
+		values[c] = (data[2] < data[1] ? uint64_t(double(data[0]) * double(data[1]) / double(data[2])) : data[0]);
+	}
+}
+
+#else //(no perf_event_open: every counter is unavailable)
+
+PerfCounters::PerfCounters() {
+	for (uint32_t c = 0; c < CounterCount; ++c) fds[c] = -1;
+	error = "hardware counters are only read on Linux";
+}
+
+PerfCounters::~PerfCounters() {
+}
+
+void PerfCounters::start() {
+}
+
+void PerfCounters::stop() {
+	for (uint32_t c = 0; c < CounterCount; ++c) values[c] = 0;
+}
+
+#endif
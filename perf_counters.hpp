@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// 'PerfCounters' reads the CPU's hardware performance counters (via perf_event_open on Linux)
+// for the calling thread and any threads it starts while counting, e.g.:
+//   PerfCounters counters;
+//   counters.start(); work(); counters.stop();
+//   if (counters.available(PerfCounters::Cycles)) ... counters.values[PerfCounters::Cycles] ...
+// Counters the kernel won't open (no PMU, perf_event_paranoid, other platforms) are just unavailable;
+// 'error' says why. When there are more counters than the hardware can count at once, the kernel
+// time-slices them, and values are scaled up to estimate the whole interval.
+
+struct PerfCounters {
+	enum Counter {
+		Cycles = 0,
+		Instructions,
+		L1DMisses, //level 1 data cache read misses
+		LLCMisses, //last level cache misses
+		BranchMisses,
+		CounterCount //(not a counter; number of counters)
+	};
+	static char const *name(Counter counter);
+
+	PerfCounters();
+	~PerfCounters();
+	PerfCounters(PerfCounters const &) = delete;
+	PerfCounters &operator=(PerfCounters const &) = delete;
+
+	bool available(Counter counter) const { return fds[counter] >= 0; }
+	bool any_available() const;
+
+	//zero and start every available counter:
+	void start();
+	//stop counting and read the counts into 'values' (0 for unavailable counters):
+	void stop();
+
+	uint64_t values[CounterCount] = { 0 };
+	std::string error; //(if any counter is unavailable) why the first one failed to open
+
+private:
+	int fds[CounterCount];
+};
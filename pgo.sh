@@ -0,0 +1,28 @@
+#!/bin/sh
+#Builds the profile-guided variant (dist/main-pgo, dist/bench-pgo):
+# 1. build instrumented binaries (VARIANT=pgo-gen),
+# 2. run the headless benchmarks as a training workload, recording a profile,
+# 3. rebuild the same objects using the profile (VARIANT=pgo-use).
+#Run from the directory containing the Jamfile. Extra arguments are passed to jam (e.g. -j8).
+
+set -e
+
+PGO_DIR=objs/pgo-profile
+
+#start from a clean profile and clean objects (jam doesn't know the objects depend on the profile):
+rm -rf "$PGO_DIR" objs/pgo
+mkdir -p "$PGO_DIR"
+
+jam -sVARIANT=pgo-gen "$@"
+
+#training run (must be run from here, since the profile directory is relative):
+./dist/bench-pgo-gen
+
+if [ "$(uname)" = "Darwin" ]; then
+	xcrun llvm-profdata merge -output="$PGO_DIR/merged.profdata" "$PGO_DIR"/*.profraw
+fi
+
+rm -rf objs/pgo
+jam -sVARIANT=pgo-use "$@"
+
+echo "Built dist/main-pgo and dist/bench-pgo."
@@ -0,0 +1,122 @@
+#include "philox.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PHILOX_SSE2 1
+#endif
+
+//Value i of a stream is lane (i % 4) of the block with counter (i / 4, stream):
+// counter = { block index (low 32 bits), block index (high 32 bits), stream, 0 }
+
+namespace {
+
+constexpr uint32_t M0 = 0xD2511F53;
+constexpr uint32_t M1 = 0xCD9E8D57;
+constexpr uint32_t W0 = 0x9E3779B9; //golden ratio
+constexpr uint32_t W1 = 0xBB67AE85; //sqrt(3) - 1
+constexpr uint32_t Rounds = 10;
+
+inline void mulhilo(uint32_t a, uint32_t b, uint32_t *hi, uint32_t *lo) {
+	uint64_t p = uint64_t(a) * uint64_t(b);
+	*hi = uint32_t(p >> 32);
+	*lo = uint32_t(p);
+}
+
+#ifdef PHILOX_SSE2
+//high and low halves of the 32x32-bit products of all four lanes of 'a' with 'm':
+inline void mulhilo4(__m128i a, __m128i m, __m128i *hi, __m128i *lo) {
+	__m128i even = _mm_mul_epu32(a, m); //lanes 0, 2 (as 64-bit products)
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m); //lanes 1, 3
+	*lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+	*hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,3,1)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,3,1)));
+}
+
+//four consecutive blocks (starting at block index 'first_block'), written as sixteen consecutive values:
+void block4(uint64_t first_block, uint32_t stream, uint32_t const key[2], uint32_t *out) {
+	//structure-of-arrays: c[k] holds counter word k of all four blocks
+	__m128i c0 = _mm_add_epi32(_mm_set1_epi32(int(uint32_t(first_block))), _mm_set_epi32(3, 2, 1, 0));
+	//(the high word carries if the low word wrapped within these four blocks)
+	__m128i carry = _mm_and_si128(
+		_mm_cmplt_epi32(_mm_xor_si128(c0, _mm_set1_epi32(int(0x80000000))), _mm_set1_epi32(int(uint32_t(first_block) ^ 0x80000000u))),
+		_mm_set1_epi32(1));
+	__m128i c1 = _mm_add_epi32(_mm_set1_epi32(int(uint32_t(first_block >> 32))), carry);
+	__m128i c2 = _mm_set1_epi32(int(stream));
+	__m128i c3 = _mm_setzero_si128();
+	__m128i m0 = _mm_set1_epi32(int(M0));
+	__m128i m1 = _mm_set1_epi32(int(M1));
+	uint32_t k0 = key[0], k1 = key[1];
+	for (uint32_t r = 0; r < Rounds; ++r) {
+		__m128i hi0, lo0, hi1, lo1;
+		mulhilo4(c0, m0, &hi0, &lo0);
+		mulhilo4(c2, m1, &hi1, &lo1);
+		c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32(int(k0)));
+		c1 = lo1;
+		c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32(int(k1)));
+		c3 = lo0;
+		k0 += W0;
+		k1 += W1;
+	}
+	//transpose back to one block (four values) per register:
+	__m128i t0 = _mm_unpacklo_epi32(c0, c1); //b0.0 b0.1 b1.0 b1.1
+	__m128i t1 = _mm_unpacklo_epi32(c2, c3); //b0.2 b0.3 b1.2 b1.3
+	__m128i t2 = _mm_unpackhi_epi32(c0, c1); //b2.0 b2.1 b3.0 b3.1
+	__m128i t3 = _mm_unpackhi_epi32(c2, c3); //b2.2 b2.3 b3.2 b3.3
+	_mm_storeu_si128(reinterpret_cast< __m128i * >(out + 0), _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast< __m128i * >(out + 4), _mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast< __m128i * >(out + 8), _mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128(reinterpret_cast< __m128i * >(out + 12), _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+} //namespace
+
+void Philox::block(uint32_t const counter[4], uint32_t const key_[2], uint32_t out[4]) {
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32_t k0 = key_[0], k1 = key_[1];
+	for (uint32_t r = 0; r < Rounds; ++r) {
+		uint32_t hi0, lo0, hi1, lo1;
+		mulhilo(M0, c0, &hi0, &lo0);
+		mulhilo(M1, c2, &hi1, &lo1);
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += W0;
+		k1 += W1;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+uint32_t Philox::operator[](uint64_t index) const {
+	uint64_t b = index / 4;
+	uint32_t counter[4] = { uint32_t(b), uint32_t(b >> 32), stream, 0 };
+	uint32_t out[4];
+	block(counter, key, out);
+	return out[index % 4];
+}
+
+void Philox::fill(uint64_t first, uint32_t *out, size_t count) const {
+	uint64_t at = first;
+	uint64_t end = first + count;
+	//partial block at the start:
+	while (at < end && (at % 4) != 0) {
+		*(out++) = (*this)[at++];
+	}
+	#ifdef PHILOX_SSE2
+	for (; at + 16 <= end; at += 16, out += 16) {
+		block4(at / 4, stream, key, out);
+	}
+	#endif
+	for (; at + 4 <= end; at += 4, out += 4) {
+		uint64_t b = at / 4;
+		uint32_t counter[4] = { uint32_t(b), uint32_t(b >> 32), stream, 0 };
+		block(counter, key, out);
+	}
+	//partial block at the end:
+	while (at < end) {
+		*(out++) = (*this)[at++];
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+//'Philox' is a counter-based random number generator (Philox4x32-10, Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+// Value i of a stream is a fixed function of (key, stream, i) -- there is no state to advance --
+// so any value can be computed independently, in any order, on any thread, with the same result every time.
+//
+//Keys are (seed, level id); 'stream' separates the independent uses of one key
+// (e.g. tile picks vs. star placement), and the index usually names a cell.
+
+//streams in use (one per independent use of a key, so no two uses ever see the same values):
+enum PhiloxStream : uint32_t {
+	StreamTiles = 0, //generate_board: tile picks, indexed by cell
+	StreamStars, //generate_board: star placement order
+	StreamAgents, //Game: agent spawn cells and directions
+};
+
+struct Philox {
+	Philox(uint32_t seed, uint32_t level, uint32_t stream_ = 0) : key{seed, level}, stream(stream_) { }
+
+	//value 'index' of the stream:
+	uint32_t operator[](uint64_t index) const;
+
+	//values [first, first + count) of the stream (four blocks at a time with SSE2):
+	void fill(uint64_t first, uint32_t *out, size_t count) const;
+
+	//one Philox4x32-10 block: four values from a 128-bit counter:
+	static void block(uint32_t const counter[4], uint32_t const key[2], uint32_t out[4]);
+
+	uint32_t key[2];
+	uint32_t stream;
+};
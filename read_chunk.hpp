@@ -5,6 +5,10 @@
 #include <stdexcept>
 #include <cassert>
 
+#include "crc32c.hpp"
+
+//read_chunk reads a vector of structures prefixed by a magic number, size, and CRC32C of the data;
+// throws if the magic doesn't match, the size doesn't fit, or the checksum doesn't match:
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *_to) {
 	assert(_to);
@@ -14,8 +18,9 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 	struct ChunkHeader {
 		char magic[4] = {'\0', '\0', '\0', '\0'};
 		uint32_t size = 0;
+		uint32_t crc = 0; //CRC32C of the data
 	};
-	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+	static_assert(sizeof(ChunkHeader) == 12, "header is packed");
 
 	ChunkHeader header;
 	if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
@@ -30,7 +35,11 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 	}
 
 	to.resize(header.size / sizeof(T));
-	if (!from.read(reinterpret_cast< char * >(&to[0]), to.size() * sizeof(T))) {
+	if (!from.read(reinterpret_cast< char * >(to.data()), to.size() * sizeof(T))) {
 		throw std::runtime_error("Failed to read chunk data.");
 	}
+
+	if (crc32c_parallel(to.data(), to.size() * sizeof(T)) != header.crc) {
+		throw std::runtime_error("Checksum mismatch in '" + magic + "' chunk (file is corrupt or truncated).");
+	}
 }
@@ -0,0 +1,42 @@
+#include "save_atomically.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif //WINDOWS
+
+void save_atomically(std::string const &path, std::function< void(std::ostream &) > const &write) {
+	std::string temp = path + ".tmp";
+	std::ofstream file(temp, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open '" + temp + "' for writing.");
+	}
+	try {
+		write(file);
+	} catch (...) {
+		file.close();
+		std::remove(temp.c_str());
+		throw;
+	}
+	//(a flush can still fail here, e.g. when the disk is full)
+	file.close();
+	if (!file) {
+		std::remove(temp.c_str());
+		throw std::runtime_error("Failed to write '" + temp + "'.");
+	}
+
+	#if defined(_WIN32)
+	//(rename won't replace an existing file on windows)
+	bool moved = (MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0);
+	#else
+	//(rename replaces an existing file in one step)
+	bool moved = (std::rename(temp.c_str(), path.c_str()) == 0);
+	#endif
+	if (!moved) {
+		std::remove(temp.c_str());
+		throw std::runtime_error("Failed to move '" + temp + "' to '" + path + "'.");
+	}
+}
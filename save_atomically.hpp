@@ -0,0 +1,11 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <functional>
+
+//save_atomically calls 'write' with a stream to a temporary file next to 'path', then (once that's flushed
+// and closed without errors) renames it over 'path', so a failed save leaves the old file as it was.
+// Throws on failure:
+//   save_atomically(path, [&](std::ostream &file){ write_chunk(file, "lvl0", entries); });
+void save_atomically(std::string const &path, std::function< void(std::ostream &) > const &write);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+//Every board cell holds exactly one tile type:
+enum Tile : uint8_t {
+	TileFloor = 0,
+	TileWall,
+	TileStar,
+	TileRiflector,
+	TileHole,
+	TileGoal,
+	TileGummy,
+	TileCount //(not a tile; number of tile types)
+};
+
+//A set of tile types, one bit per type (bit t == 1 << t):
+typedef uint8_t TileMask;
+static_assert(TileCount <= 8, "TileMask needs a bit per tile type.");
+
+inline TileMask tile_bit(Tile t) {
+	return TileMask(1u << t);
+}
@@ -0,0 +1,136 @@
+#include "transforms.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TRANSFORMS_SSE 1
+#include <xmmintrin.h>
+#endif
+
+void DrawTransforms::clear() {
+	for (auto &w : world) w.clear();
+}
+
+void DrawTransforms::push(glm::mat4 const &object_to_world) {
+	for (uint32_t k = 0; k < 16; ++k) {
+		world[k].emplace_back(object_to_world[k / 4][k % 4]);
+	}
+}
+
+namespace {
+
+//one draw's outputs from the SoA inputs; written to match the SIMD path's order of operations:
+void compute_one(glm::mat4 const &clip, std::vector< float > const (&world)[16], size_t i,
+	glm::mat4 *object_to_clip, glm::mat4x3 *object_to_light, glm::mat3 *normal_to_light) {
+	float w[16];
+	for (uint32_t k = 0; k < 16; ++k) w[k] = world[k][i];
+
+	for (uint32_t c = 0; c < 4; ++c) {
+		for (uint32_t r = 0; r < 4; ++r) {
+			(*object_to_clip)[c][r] = clip[0][r] * w[4*c+0] + clip[1][r] * w[4*c+1] + clip[2][r] * w[4*c+2] + clip[3][r] * w[4*c+3];
+		}
+		for (uint32_t r = 0; r < 3; ++r) {
+			(*object_to_light)[c][r] = w[4*c+r];
+		}
+	}
+
+	//inverse transpose of a 3x3 matrix [a b c] (columns) is [b x c, c x a, a x b] / det:
+	glm::vec3 a(w[0], w[1], w[2]), b(w[4], w[5], w[6]), c(w[8], w[9], w[10]);
+	glm::vec3 bc = glm::cross(b, c), ca = glm::cross(c, a), ab = glm::cross(a, b);
+	float inv_det = 1.0f / glm::dot(a, bc);
+	(*normal_to_light)[0] = bc * inv_det;
+	(*normal_to_light)[1] = ca * inv_det;
+	(*normal_to_light)[2] = ab * inv_det;
+}
+
+} //namespace
+
+void DrawTransforms::compute(glm::mat4 const &clip) {
+	size_t count = size();
+	object_to_clip.resize(count);
+	object_to_light.resize(count);
+	normal_to_light.resize(count);
+
+	size_t i = 0;
+
+	#ifdef TRANSFORMS_SSE
+	//four draws at a time; each register holds one matrix element for four draws:
+	__m128 C[16];
+	for (uint32_t k = 0; k < 16; ++k) C[k] = _mm_set1_ps(clip[k / 4][k % 4]);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 w[16];
+		for (uint32_t k = 0; k < 16; ++k) w[k] = _mm_loadu_ps(&world[k][i]);
+
+		//object_to_clip: column c, row r = sum_k clip[k][r] * world[c][k]
+		for (uint32_t c = 0; c < 4; ++c) {
+			__m128 r0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(C[0], w[4*c+0]), _mm_mul_ps(C[4], w[4*c+1])), _mm_mul_ps(C[8], w[4*c+2])), _mm_mul_ps(C[12], w[4*c+3]));
+			__m128 r1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(C[1], w[4*c+0]), _mm_mul_ps(C[5], w[4*c+1])), _mm_mul_ps(C[9], w[4*c+2])), _mm_mul_ps(C[13], w[4*c+3]));
+			__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(C[2], w[4*c+0]), _mm_mul_ps(C[6], w[4*c+1])), _mm_mul_ps(C[10], w[4*c+2])), _mm_mul_ps(C[14], w[4*c+3]));
+			__m128 r3 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(C[3], w[4*c+0]), _mm_mul_ps(C[7], w[4*c+1])), _mm_mul_ps(C[11], w[4*c+2])), _mm_mul_ps(C[15], w[4*c+3]));
+			//(after transposing, each register is column c of one draw)
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(&object_to_clip[i+0][c][0], r0);
+			_mm_storeu_ps(&object_to_clip[i+1][c][0], r1);
+			_mm_storeu_ps(&object_to_clip[i+2][c][0], r2);
+			_mm_storeu_ps(&object_to_clip[i+3][c][0], r3);
+		}
+
+		//normal_to_light: columns are cross products of object_to_world's columns, divided by the determinant:
+		__m128 const *a = w + 0, *b = w + 4, *c = w + 8;
+		auto cross = [](__m128 const *u, __m128 const *v, __m128 *out) {
+			out[0] = _mm_sub_ps(_mm_mul_ps(u[1], v[2]), _mm_mul_ps(u[2], v[1]));
+			out[1] = _mm_sub_ps(_mm_mul_ps(u[2], v[0]), _mm_mul_ps(u[0], v[2]));
+			out[2] = _mm_sub_ps(_mm_mul_ps(u[0], v[1]), _mm_mul_ps(u[1], v[0]));
+		};
+		__m128 n[3][4]; //[column][row] (row 3 is padding for the transpose)
+		cross(b, c, n[0]);
+		cross(c, a, n[1]);
+		cross(a, b, n[2]);
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], n[0][0]), _mm_mul_ps(a[1], n[0][1])), _mm_mul_ps(a[2], n[0][2]));
+		__m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+		for (uint32_t col = 0; col < 3; ++col) {
+			for (uint32_t r = 0; r < 3; ++r) n[col][r] = _mm_mul_ps(n[col][r], inv_det);
+			n[col][3] = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(n[col][0], n[col][1], n[col][2], n[col][3]);
+			for (uint32_t d = 0; d < 4; ++d) {
+				float tmp[4];
+				_mm_storeu_ps(tmp, n[col][d]);
+				std::memcpy(&normal_to_light[i+d][col][0], tmp, 3 * sizeof(float));
+			}
+		}
+
+		//object_to_light: just a copy of the top three rows:
+		for (uint32_t col = 0; col < 4; ++col) {
+			__m128 r0 = w[4*col+0], r1 = w[4*col+1], r2 = w[4*col+2], r3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			__m128 const *rows[4] = { &r0, &r1, &r2, &r3 };
+			for (uint32_t d = 0; d < 4; ++d) {
+				float tmp[4];
+				_mm_storeu_ps(tmp, *rows[d]);
+				std::memcpy(&object_to_light[i+d][col][0], tmp, 3 * sizeof(float));
+			}
+		}
+	}
+	#endif //TRANSFORMS_SSE
+
+	//leftover draws (or all of them, without SSE):
+	for (; i < count; ++i) {
+		compute_one(clip, world, i, &object_to_clip[i], &object_to_light[i], &normal_to_light[i]);
+	}
+}
+
+void DrawTransforms::compute_reference(glm::mat4 const &world_to_clip) {
+	size_t count = size();
+	object_to_clip.resize(count);
+	object_to_light.resize(count);
+	normal_to_light.resize(count);
+
+	for (size_t i = 0; i < count; ++i) {
+		glm::mat4 object_to_world;
+		for (uint32_t k = 0; k < 16; ++k) object_to_world[k / 4][k % 4] = world[k][i];
+		object_to_clip[i] = world_to_clip * object_to_world;
+		object_to_light[i] = glm::mat4x3(object_to_world);
+		normal_to_light[i] = glm::inverse(glm::transpose(glm::mat3(object_to_world)));
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+
+// 'DrawTransforms' computes every per-draw matrix the shaders need for a whole list of draws in one pass,
+// rather than one draw at a time in between GL calls.
+// Inputs are stored structure-of-arrays so the kernel can work on several draws per SIMD register;
+// outputs are stored one matrix per draw, ready to hand to glUniformMatrix*.
+
+struct DrawTransforms {
+	void clear();
+	size_t size() const { return world[0].size(); }
+
+	//add a draw:
+	void push(glm::mat4 const &object_to_world);
+
+	//fill the outputs (SSE on x86, scalar elsewhere):
+	void compute(glm::mat4 const &world_to_clip);
+	//same outputs, computed one draw at a time with glm (for comparison):
+	void compute_reference(glm::mat4 const &world_to_clip);
+
+	//------- inputs -------
+	//world[k][i] is element k (column-major) of draw i's object_to_world matrix:
+	std::vector< float > world[16];
+
+	//------- outputs -------
+	std::vector< glm::mat4 > object_to_clip; //world_to_clip * object_to_world
+	std::vector< glm::mat4x3 > object_to_light; //object_to_world without its last row (light space == world space)
+	std::vector< glm::mat3 > normal_to_light; //inverse transpose of object_to_world's upper 3x3
+};
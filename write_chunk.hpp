@@ -0,0 +1,40 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <cassert>
+
+#include "crc32c.hpp"
+
+//write_chunk writes a vector of structures prefixed by a magic number, size, and CRC32C,
+// in exactly the format read_chunk expects; throws if the data doesn't fit in a chunk (4GB):
+template< typename T >
+void write_chunk(std::ostream &to, std::string const &magic, std::vector< T > const &from) {
+	assert(magic.length() == 4);
+
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+		uint32_t crc = 0; //CRC32C of the data
+	};
+	static_assert(sizeof(ChunkHeader) == 12, "header is packed");
+
+	ChunkHeader header;
+	for (uint32_t i = 0; i < 4; ++i) {
+		header.magic[i] = magic[i];
+	}
+	//(the header's size is 32 bits)
+	if (uint64_t(from.size()) * sizeof(T) > 0xffffffffu) {
+		throw std::runtime_error("Chunk '" + magic + "' is too large to write (over 4GB).");
+	}
+	header.size = uint32_t(from.size() * sizeof(T));
+	header.crc = crc32c_parallel(from.data(), from.size() * sizeof(T));
+
+	if (!to.write(reinterpret_cast< char const * >(&header), sizeof(header))) {
+		throw std::runtime_error("Failed to write chunk header.");
+	}
+	if (!to.write(reinterpret_cast< char const * >(from.data()), from.size() * sizeof(T))) {
+		throw std::runtime_error("Failed to write chunk data.");
+	}
+}